@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+# Generates the benchmark workloads in bench/*.ki.
+#
+# A chunk holds at most 256 constants and the language has no loops yet, so
+# each workload packs its work into bulk natives, long expression chains and
+# large literals. The first line of every workload tells bench/run.py how to
+# run it:
+#    // bench: repeat=N mode=run|compile|repl
+# where [repeat] is how many times one process runs the script (on the same
+# vm, through --jobs 1) so that process start up doesn't drown the timing.
+# A repl workload is fed to the REPL on stdin instead, a line at a time.
+# The output is deterministic, rerun this script after changing it.
+
+import os
+import random
+
+
+def header(repeat, mode, description):
+   return [
+      "// bench: repeat=%d mode=%s" % (repeat, mode),
+      "// Generated by bench/gen_workloads.py, do not edit by hand.",
+      "// " + description,
+   ]
+
+
+def arithmetic(rng):
+   out = header(5, "run", "integer and double arithmetic over ranges and long chains")
+   # the bulk natives run the loops the language can't express yet
+   for n in (100000, 200000, 300000):
+      out.append("print sum(range(%d)) * 3 - 7;" % n)
+      out.append("print sum(map_add(range(%d), 0.5)) / 2;" % n)
+      out.append("print max(map_add(range(%d), -1)) - min(range(%d));" % (n, n))
+   out.append("print sum(sort(map_add(range(50000), 0.25)));")
+   # chains mixing ints and doubles, every literal is a constant
+   ops = ["+", "-", "*", "+", "-"]
+   for _ in range(8):
+      terms = []
+      for _ in range(20):
+         if rng.random() < 0.3:
+            terms.append("%d.%d" % (rng.randrange(1, 100), rng.randrange(10)))
+         else:
+            terms.append(str(rng.randrange(1, 1000)))
+      expr = terms[0]
+      for term in terms[1:]:
+         expr += " %s %s" % (rng.choice(ops), term)
+      out.append("print %s;" % expr)
+   return out
+
+
+def concatenation(rng):
+   out = header(10, "run", "concatenation of large string literals")
+   # every step copies the whole string built so far
+   pieces = []
+   for i in range(120):
+      pieces.append('"%s"' % random_word(rng, 2048))
+   out.append("print len(%s);" % " + ".join(pieces))
+   return out
+
+
+def interning(rng):
+   out = header(1000, "run", "many short distinct strings through the intern table")
+   # each intermediate result of a chain is a new string to intern
+   for _ in range(2):
+      words = ['"%s"' % random_word(rng, rng.randrange(1, 6)) for _ in range(120)]
+      out.append("print len(%s);" % " + ".join(words))
+   return out
+
+
+def comparisons(rng):
+   out = header(200, "run", "equality and ordering chains")
+   # true, false and nil need no constants, so these chains can be long
+   operands = ["true", "false", "nil", "!true", "!false", "!nil"]
+   for _ in range(400):
+      expr = rng.choice(operands)
+      for _ in range(24):
+         expr += " %s %s" % (rng.choice(["==", "!="]), rng.choice(operands))
+      out.append("print %s;" % expr)
+   for _ in range(12):
+      terms = []
+      for _ in range(6):
+         a, b = rng.randrange(100), rng.randrange(100)
+         terms.append("(%d %s %d)" % (a, rng.choice(["<", "<=", ">", ">="]), b))
+      out.append("print %s;" % " == ".join(terms))
+   for _ in range(10):
+      word = random_word(rng, 64)
+      other = word[:-1] + ("a" if word[-1] != "a" else "b")
+      out.append('print "%s" == "%s";' % (word, other))
+   return out
+
+
+def compile_stress(rng):
+   out = header(50, "compile", "large literals and deep expressions, compiled only")
+   # long string literals exercise the scanner
+   for _ in range(50):
+      out.append('print "%s";' % random_word(rng, 4096))
+   # wide list literals
+   for _ in range(6):
+      items = ", ".join(str(rng.randrange(1 << 40)) for _ in range(25))
+      out.append("print [%s];" % items)
+   # constant free expressions as long and as deep as the compiler allows
+   operands = ["true", "false", "nil", "[]", "[nil, [true]]"]
+   for _ in range(300):
+      expr = " == ".join(rng.choice(operands) for _ in range(40))
+      out.append("print %s;" % expr)
+   for _ in range(100):
+      depth = 60
+      out.append("print %s%s%s;" % ("(!" * depth, "true", ")" * depth))
+   return out
+
+
+def repl(rng):
+   out = header(20, "repl", "fibers spawned from REPL lines, outliving the line's script")
+   # each line is its own script on the same vm, so the fibers it spawns run
+   # after it has returned and the next line has to start on a clean stack
+   for _ in range(40):
+      n = rng.randrange(100, 2000)
+      out.append("spawn { print sum(range(%d)); }" % n)
+      out.append("spawn { yield; print %d; } spawn { print len(range(%d)); } print %d;"
+         % (rng.randrange(1000), n, rng.randrange(1000)))
+      out.append('spawn { send(channel("repl"), %d); } print receive(channel("repl")) + 1;'
+         % rng.randrange(1000))
+   return out
+
+
+def random_word(rng, length):
+   return "".join(rng.choice("abcdefghijklmnopqrstuvwxyz") for _ in range(length))
+
+
+WORKLOADS = [
+   ("arithmetic.ki", arithmetic),
+   ("concatenation.ki", concatenation),
+   ("interning.ki", interning),
+   ("comparisons.ki", comparisons),
+   ("compile_stress.ki", compile_stress),
+   ("repl.ki", repl),
+]
+
+
+def main():
+   directory = os.path.dirname(os.path.abspath(__file__))
+   for name, generate in WORKLOADS:
+      rng = random.Random(name)
+      with open(os.path.join(directory, name), "w") as f:
+         f.write("\n".join(generate(rng)))
+
+
+if __name__ == "__main__":
+   main()
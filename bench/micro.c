@@ -0,0 +1,523 @@
+// Microbenchmarks of the interpreter's hot data structures, driving their
+// entry points directly: the scanner, the string keyed table, string
+// interning and the bytecode loop on hand built chunks.
+//
+// It links against every source but src/main.c and needs the allocator
+// wrapped so allocations can be counted, bench/run.py --micro builds it:
+//    cc -std=gnu11 -O2 -Isrc -o micro bench/micro.c <src/*.c>
+//       -ledit -lm -lpthread -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc
+//
+//    micro [--corpus path] [name filter...]
+//
+// Every benchmark runs a few times and reports its fastest run, in
+// nanoseconds and allocations per operation.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "chunk.h"
+#include "memory.h"
+#include "object.h"
+#include "scanner.h"
+#include "source.h"
+#include "table.h"
+#include "vm.h"
+
+#define RUNS 3
+// the tables are filled up to their load factor without growing past this
+#define TABLE_CAPACITY 65536
+#define LOOKUPS 2000000
+
+typedef struct {
+   struct timespec start;
+   long start_allocations;
+   long ops;
+   double ns;
+   long allocations;
+} Measure;
+
+typedef struct {
+   const char *name;
+   void (*run)(Measure *measure, double param);
+   double param;
+} Benchmark;
+
+typedef struct {
+   int count;
+   ObjString **strings;
+} Keys;
+
+static void begin(Measure *measure);
+static void end(Measure *measure, long ops);
+static void make_keys(Keys *keys, VM *vm, const char *prefix, int count);
+static void fill_table(Table *table, Keys *keys, int count);
+static char* synthetic_corpus(size_t size);
+static void write_group(Chunk *chunk, const uint8_t *code, int length);
+static void run_chunk(Measure *measure, const uint8_t *group, int length,
+   Value a, Value b);
+
+static void scan(Measure *measure, double param);
+static void table_get_hit(Measure *measure, double load);
+static void table_get_miss(Measure *measure, double load);
+static void table_get_tombstones(Measure *measure, double ratio);
+static void table_set_fresh(Measure *measure, double param);
+static void table_set_existing(Measure *measure, double param);
+static void find_string_hit(Measure *measure, double load);
+static void find_string_miss(Measure *measure, double load);
+static void copy_string_hit(Measure *measure, double param);
+static void copy_string_miss(Measure *measure, double param);
+static void take_string_hit(Measure *measure, double param);
+static void take_string_miss(Measure *measure, double param);
+static void run_int_add(Measure *measure, double param);
+static void run_double_multiply(Measure *measure, double param);
+static void run_compare(Measure *measure, double param);
+static void run_logic(Measure *measure, double param);
+
+static long allocations = 0;
+
+static VM vm;
+static const char *corpus = NULL;
+static size_t corpus_length = 0;
+static Keys hit_keys;
+static Keys miss_keys;
+
+static Benchmark benchmarks[] = {
+   { "scan_token", scan, 0 },
+   { "table_get/hit/load=0.25", table_get_hit, 0.25 },
+   { "table_get/hit/load=0.50", table_get_hit, 0.50 },
+   { "table_get/hit/load=0.74", table_get_hit, 0.74 },
+   { "table_get/miss/load=0.25", table_get_miss, 0.25 },
+   { "table_get/miss/load=0.50", table_get_miss, 0.50 },
+   { "table_get/miss/load=0.74", table_get_miss, 0.74 },
+   { "table_get/load=0.50/tombstones=0.25", table_get_tombstones, 0.25 },
+   { "table_get/load=0.50/tombstones=0.50", table_get_tombstones, 0.50 },
+   { "table_get/load=0.50/tombstones=0.90", table_get_tombstones, 0.90 },
+   { "table_set/fresh", table_set_fresh, 0 },
+   { "table_set/existing", table_set_existing, 0 },
+   { "table_find_string/hit/load=0.50", find_string_hit, 0.50 },
+   { "table_find_string/hit/load=0.74", find_string_hit, 0.74 },
+   { "table_find_string/miss/load=0.50", find_string_miss, 0.50 },
+   { "table_find_string/miss/load=0.74", find_string_miss, 0.74 },
+   { "copy_string/hit", copy_string_hit, 0 },
+   { "copy_string/miss", copy_string_miss, 0 },
+   { "take_string/hit", take_string_hit, 0 },
+   { "take_string/miss", take_string_miss, 0 },
+   { "run/int_add", run_int_add, 0 },
+   { "run/double_multiply", run_double_multiply, 0 },
+   { "run/compare", run_compare, 0 },
+   { "run/logic", run_logic, 0 },
+   { NULL, NULL, 0 },
+};
+
+// the allocator, wrapped by the linker
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+   ++allocations;
+   return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+   ++allocations;
+   return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *pointer, size_t size) {
+   if (size > 0) ++allocations;
+   return __real_realloc(pointer, size);
+}
+
+int main(int argc, const char *argv[]) {
+   int arg = 1;
+   if (arg + 1 < argc && strcmp(argv[arg], "--corpus") == 0) {
+      Source source;
+      if (!read_source(argv[arg + 1], &source)) return 74;
+      corpus = source.chars;
+      corpus_length = source.length;
+      arg += 2;
+   }
+
+   init_vm(&vm);
+   make_keys(&hit_keys, &vm, "key", TABLE_CAPACITY);
+   make_keys(&miss_keys, &vm, "miss", TABLE_CAPACITY);
+
+   printf("%-38s %12s %12s %12s\n", "benchmark", "ns/op", "allocs/op", "ops");
+   for (Benchmark *benchmark = benchmarks; benchmark->name != NULL; ++benchmark) {
+      bool selected = arg == argc;
+      for (int i = arg; i < argc; ++i) {
+         if (strstr(benchmark->name, argv[i]) != NULL) selected = true;
+      }
+      if (!selected) continue;
+
+      Measure best = { .ns = -1 };
+      for (int run = 0; run < RUNS; ++run) {
+         Measure measure;
+         benchmark->run(&measure, benchmark->param);
+         if (best.ns < 0 || measure.ns < best.ns) best = measure;
+      }
+      printf("%-38s %12.2f %12.3f %12ld\n", benchmark->name,
+         best.ns / best.ops, (double)best.allocations / best.ops, best.ops);
+   }
+
+   free_vm(&vm);
+   return 0;
+}
+
+static void begin(Measure *measure) {
+   measure->start_allocations = allocations;
+   clock_gettime(CLOCK_MONOTONIC, &measure->start);
+}
+
+static void end(Measure *measure, long ops) {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   measure->ns = (now.tv_sec - measure->start.tv_sec) * 1e9
+      + (now.tv_nsec - measure->start.tv_nsec);
+   measure->allocations = allocations - measure->start_allocations;
+   measure->ops = ops;
+}
+
+// scanner
+
+static void scan(Measure *measure, double param) {
+   static char *synthetic = NULL;
+   if (corpus == NULL) {
+      if (synthetic == NULL) synthetic = synthetic_corpus(8 << 20);
+      corpus = synthetic;
+      corpus_length = strlen(synthetic);
+   }
+
+   Scanner scanner;
+   init_scanner(&scanner, corpus, corpus_length);
+   long tokens = 0;
+
+   begin(measure);
+   for (;;) {
+      Token token = scan_token(&scanner);
+      ++tokens;
+      if (token.type == TOKEN_EOF) break;
+   }
+   end(measure, tokens);
+}
+
+static char* synthetic_corpus(size_t size) {
+   static const char *lines[] = {
+      "print sum(range(1000)) * 3.25 - 7;\n",
+      "print \"a string literal\" + 'another one';\n",
+      "// a comment that the scanner skips over\n",
+      "var answer = (alpha >= beta) and !gamma or nil;\n",
+      "spawn { yield; print [1, 2, 3][0]; }\n",
+      "print {\"key\": true, 42: false}[\"key\"];\n",
+      "    while (index < 10) index = index + 1;\n",
+   };
+   int line_count = sizeof(lines) / sizeof(lines[0]);
+
+   char *text = malloc(size + 1);
+   size_t length = 0;
+   for (int i = 0;; i = (i + 1) % line_count) {
+      size_t line_length = strlen(lines[i]);
+      if (length + line_length > size) break;
+      memcpy(text + length, lines[i], line_length);
+      length += line_length;
+   }
+   text[length] = '\0';
+   return text;
+}
+
+// tables
+
+static void make_keys(Keys *keys, VM *vm, const char *prefix, int count) {
+   keys->count = count;
+   keys->strings = malloc(sizeof(ObjString *) * count);
+   char buffer[32];
+   for (int i = 0; i < count; ++i) {
+      int length = snprintf(buffer, sizeof(buffer), "%s:%d", prefix, i);
+      keys->strings[i] = copy_string(vm, buffer, length);
+   }
+}
+
+static void fill_table(Table *table, Keys *keys, int count) {
+   init_table(table);
+   for (int i = 0; i < count; ++i) {
+      table_set(table, keys->strings[i], INT_VAL(i));
+   }
+}
+
+static void table_get_hit(Measure *measure, double load) {
+   int count = (int)(TABLE_CAPACITY * load);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+   Value value;
+   long found = 0;
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      found += table_get(&table, hit_keys.strings[i % count], &value);
+   }
+   end(measure, LOOKUPS);
+
+   if (found != LOOKUPS) fprintf(stderr, "table_get missed a key\n");
+   free_table(&table);
+}
+
+static void table_get_miss(Measure *measure, double load) {
+   int count = (int)(TABLE_CAPACITY * load);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+   Value value;
+   long found = 0;
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      found += table_get(&table, miss_keys.strings[i % miss_keys.count], &value);
+   }
+   end(measure, LOOKUPS);
+
+   if (found != 0) fprintf(stderr, "table_get found a missing key\n");
+   free_table(&table);
+}
+
+// half full, with [ratio] of the keys deleted again, half the lookups hit
+// the remaining keys and half miss
+static void table_get_tombstones(Measure *measure, double ratio) {
+   int count = TABLE_CAPACITY / 2;
+   int deleted = (int)(count * ratio);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+   for (int i = 0; i < deleted; ++i) {
+      table_delete(&table, hit_keys.strings[i]);
+   }
+   int live = count - deleted;
+   Value value;
+   long found = 0;
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; i += 2) {
+      found += table_get(&table, hit_keys.strings[deleted + i / 2 % live], &value);
+      found += table_get(&table, miss_keys.strings[i / 2 % miss_keys.count], &value);
+   }
+   end(measure, LOOKUPS);
+
+   if (found != LOOKUPS / 2) fprintf(stderr, "table_get got tombstones wrong\n");
+   free_table(&table);
+}
+
+// grows from empty, so the allocations are the resizes
+static void table_set_fresh(Measure *measure, double param) {
+   Table table;
+   init_table(&table);
+   int count = hit_keys.count;
+
+   begin(measure);
+   for (int i = 0; i < count; ++i) {
+      table_set(&table, hit_keys.strings[i], INT_VAL(i));
+   }
+   end(measure, count);
+
+   free_table(&table);
+}
+
+static void table_set_existing(Measure *measure, double param) {
+   int count = (int)(TABLE_CAPACITY * 0.5);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      table_set(&table, hit_keys.strings[i % count], INT_VAL(i));
+   }
+   end(measure, LOOKUPS);
+
+   free_table(&table);
+}
+
+static void find_string_hit(Measure *measure, double load) {
+   int count = (int)(TABLE_CAPACITY * load);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+   long found = 0;
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      ObjString *key = hit_keys.strings[i % count];
+      found += table_find_string(&table, key->chars, key->length, key->hash) != NULL;
+   }
+   end(measure, LOOKUPS);
+
+   if (found != LOOKUPS) fprintf(stderr, "table_find_string missed a key\n");
+   free_table(&table);
+}
+
+static void find_string_miss(Measure *measure, double load) {
+   int count = (int)(TABLE_CAPACITY * load);
+   Table table;
+   fill_table(&table, &hit_keys, count);
+   long found = 0;
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      ObjString *key = miss_keys.strings[i % miss_keys.count];
+      found += table_find_string(&table, key->chars, key->length, key->hash) != NULL;
+   }
+   end(measure, LOOKUPS);
+
+   if (found != 0) fprintf(stderr, "table_find_string found a missing key\n");
+   free_table(&table);
+}
+
+// interning, each on a vm of its own so the misses don't pile up
+
+static void copy_string_hit(Measure *measure, double param) {
+   VM strings;
+   init_vm(&strings);
+   Keys keys;
+   make_keys(&keys, &strings, "key", TABLE_CAPACITY / 2);
+
+   begin(measure);
+   for (long i = 0; i < LOOKUPS; ++i) {
+      ObjString *key = keys.strings[i % keys.count];
+      copy_string(&strings, key->chars, key->length);
+   }
+   end(measure, LOOKUPS);
+
+   free(keys.strings);
+   free_vm(&strings);
+}
+
+static void copy_string_miss(Measure *measure, double param) {
+   int count = TABLE_CAPACITY * 4;
+   // the characters come from outside the vm, formatted up front
+   char *names = malloc((size_t)count * 16);
+   int *lengths = malloc(sizeof(int) * count);
+   for (int i = 0; i < count; ++i) {
+      lengths[i] = snprintf(names + (size_t)i * 16, 16, "fresh:%d", i);
+   }
+   VM strings;
+   init_vm(&strings);
+
+   begin(measure);
+   for (int i = 0; i < count; ++i) {
+      copy_string(&strings, names + (size_t)i * 16, lengths[i]);
+   }
+   end(measure, count);
+
+   free_vm(&strings);
+   free(names);
+   free(lengths);
+}
+
+static void take_string_hit(Measure *measure, double param) {
+   int count = TABLE_CAPACITY * 4;
+   VM strings;
+   init_vm(&strings);
+   Keys keys;
+   make_keys(&keys, &strings, "key", TABLE_CAPACITY / 2);
+   // take_string owns its characters, they're allocated before timing
+   char **chars = malloc(sizeof(char *) * count);
+   for (int i = 0; i < count; ++i) {
+      ObjString *key = keys.strings[i % keys.count];
+      chars[i] = ALLOCATE(char, key->length + 1);
+      memcpy(chars[i], key->chars, key->length + 1);
+   }
+
+   begin(measure);
+   for (int i = 0; i < count; ++i) {
+      take_string(&strings, chars[i], keys.strings[i % keys.count]->length);
+   }
+   end(measure, count);
+
+   free(chars);
+   free(keys.strings);
+   free_vm(&strings);
+}
+
+static void take_string_miss(Measure *measure, double param) {
+   int count = TABLE_CAPACITY * 4;
+   VM strings;
+   init_vm(&strings);
+   char **chars = malloc(sizeof(char *) * count);
+   int *lengths = malloc(sizeof(int) * count);
+   char buffer[16];
+   for (int i = 0; i < count; ++i) {
+      lengths[i] = snprintf(buffer, sizeof(buffer), "fresh:%d", i);
+      chars[i] = ALLOCATE(char, lengths[i] + 1);
+      memcpy(chars[i], buffer, lengths[i] + 1);
+   }
+
+   begin(measure);
+   for (int i = 0; i < count; ++i) {
+      take_string(&strings, chars[i], lengths[i]);
+   }
+   end(measure, count);
+
+   free(chars);
+   free(lengths);
+   free_vm(&strings);
+}
+
+// the bytecode loop, on straight line chunks since there are no jumps
+
+#define GROUPS 40000
+#define CHUNK_RUNS 25
+
+static void write_group(Chunk *chunk, const uint8_t *code, int length) {
+   for (int i = 0; i < length; ++i) {
+      write_chunk(chunk, code[i], 1);
+   }
+}
+
+// [group] is repeated over and over, constant 0 is [a] and 1 is [b]
+static void run_chunk(Measure *measure, const uint8_t *group, int length,
+   Value a, Value b)
+{
+   Chunk chunk;
+   init_chunk(&chunk);
+   add_constant(&chunk, a);
+   add_constant(&chunk, b);
+   long instructions = 1;
+   for (int i = 0; i < GROUPS; ++i) {
+      write_group(&chunk, group, length);
+   }
+   for (int i = 0; i < length; ++i) {
+      // operands aren't instructions
+      if (group[i] == OP_CONSTANT) ++i;
+      ++instructions;
+   }
+   instructions = (instructions - 1) * GROUPS + 1;
+   write_chunk(&chunk, OP_RETURN, 1);
+
+   begin(measure);
+   for (int i = 0; i < CHUNK_RUNS; ++i) {
+      if (interpret_chunk(&vm, &chunk) != INTERPRET_OK) {
+         fprintf(stderr, "chunk failed\n");
+         break;
+      }
+   }
+   end(measure, instructions * CHUNK_RUNS);
+
+   free_chunk(&chunk);
+}
+
+static void run_int_add(Measure *measure, double param) {
+   const uint8_t group[] = { OP_CONSTANT, 0, OP_CONSTANT, 1, OP_ADD, OP_POP };
+   run_chunk(measure, group, sizeof(group), INT_VAL(40), INT_VAL(2));
+}
+
+static void run_double_multiply(Measure *measure, double param) {
+   const uint8_t group[] = { OP_CONSTANT, 0, OP_CONSTANT, 1, OP_MULTIPLY, OP_POP };
+   run_chunk(measure, group, sizeof(group), NUMBER_VAL(1.5), NUMBER_VAL(2.25));
+}
+
+static void run_compare(Measure *measure, double param) {
+   const uint8_t group[] = { OP_CONSTANT, 0, OP_CONSTANT, 1, OP_LESS, OP_NOT, OP_POP };
+   run_chunk(measure, group, sizeof(group), INT_VAL(1), NUMBER_VAL(2.5));
+}
+
+static void run_logic(Measure *measure, double param) {
+   const uint8_t group[] = { OP_TRUE, OP_NOT, OP_FALSE, OP_EQUAL, OP_NIL, OP_EQUAL, OP_POP };
+   run_chunk(measure, group, sizeof(group), NIL_VAL, NIL_VAL);
+}
\ No newline at end of file
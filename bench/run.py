@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+# Builds the interpreter and times the workloads in bench/*.ki.
+#
+#    bench/run.py [options] [workload...]
+#
+# Every sample is one process running a workload [repeat] times (see the
+# header line written by bench/gen_workloads.py), the reported times are per
+# run of the script. With a baseline the medians are compared and anything
+# slower by more than the threshold is flagged, which also makes the exit
+# status 1. So is a peak heap size (from --mem-stats) grown by more than
+# the threshold. The report is written to bench_output.txt as well.
+#
+# --micro builds and runs bench/micro.c instead, the microbenchmarks of the
+# scanner, tables, interning and the bytecode loop; any further arguments
+# filter them by name.
+#
+# --startup times a single run of each workload from its source against the
+# same run from an image saved with --save-image, which skips the scanning,
+# interning and compiling.
+#
+# Only needs python3 and a C compiler, the build follows CC, CFLAGS and
+# LDLIBS from the environment.
+
+import argparse
+import glob
+import json
+import os
+import re
+import shlex
+import statistics
+import subprocess
+import sys
+import time
+
+BENCH = os.path.dirname(os.path.abspath(__file__))
+ROOT = os.path.dirname(BENCH)
+BUILD = os.path.join(ROOT, "_bench_build")
+DEFAULT_BASELINE = os.path.join(BENCH, "baseline.json")
+
+
+def build(micro=False):
+   cc = os.environ.get("CC", "cc")
+   cflags = shlex.split(os.environ.get("CFLAGS", "-std=gnu11 -O2"))
+   ldlibs = shlex.split(os.environ.get("LDLIBS", "-ledit -lm -lpthread"))
+   sources = sorted(glob.glob(os.path.join(ROOT, "src", "*.c")))
+   os.makedirs(BUILD, exist_ok=True)
+   if micro:
+      # micro.c has its own main and counts allocations through the wrappers
+      binary = os.path.join(BUILD, "micro")
+      sources = [os.path.join(BENCH, "micro.c")] + [s for s in sources
+         if os.path.basename(s) != "main.c"]
+      cflags = cflags + ["-I" + os.path.join(ROOT, "src")]
+      ldlibs = ldlibs + ["-Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc"]
+   else:
+      binary = os.path.join(BUILD, "ki")
+   command = [cc] + cflags + ["-o", binary] + sources + ldlibs
+   print("building: %s" % " ".join(shlex.quote(c) for c in command), file=sys.stderr)
+   subprocess.run(command, check=True)
+   return binary
+
+
+def load_workload(path):
+   with open(path) as f:
+      first = f.readline()
+   match = re.match(r"//\s*bench:\s*repeat=(\d+)\s+mode=(run|compile|repl)", first)
+   if match is None:
+      sys.exit("%s: missing the '// bench: repeat=N mode=...' header" % path)
+   return {
+      "name": os.path.splitext(os.path.basename(path))[0],
+      "path": path,
+      "repeat": int(match.group(1)),
+      "mode": match.group(2),
+   }
+
+
+def run_once(binary, workload, options=()):
+   # one vm runs the script [repeat] times in a row
+   command = [binary] + list(options)
+   lines = None
+   if workload["mode"] == "repl":
+      # the REPL runs every line as its own script, still on one vm
+      with open(workload["path"], "rb") as f:
+         lines = b"\n".join([f.read()] * workload["repeat"]) + b"\n"
+   else:
+      if workload["mode"] == "compile":
+         command.append("--compile")
+      command += ["--jobs", "1"] + [workload["path"]] * workload["repeat"]
+
+   start = time.perf_counter()
+   result = subprocess.run(command, input=lines, stdout=subprocess.DEVNULL,
+      stderr=subprocess.PIPE)
+   elapsed = time.perf_counter() - start
+   # the REPL reports a line's error and goes on to the next one
+   failed = lines is not None and b"[line " in result.stderr
+   if result.returncode != 0 or failed:
+      sys.exit("%s failed with status %d:\n%s" % (workload["name"],
+         result.returncode, result.stderr.decode(errors="replace")))
+   return elapsed * 1000.0 / workload["repeat"], result.stderr.decode(errors="replace")
+
+
+def peak_bytes(binary, workload):
+   _, stats = run_once(binary, workload, ["--mem-stats"])
+   match = re.search(r"peak bytes:\s*(\d+)", stats)
+   return int(match.group(1)) if match else None
+
+
+def time_process(command):
+   start = time.perf_counter()
+   result = subprocess.run(command, stdout=subprocess.DEVNULL, stderr=subprocess.PIPE)
+   elapsed = time.perf_counter() - start
+   if result.returncode != 0:
+      sys.exit("%s failed with status %d:\n%s" % (" ".join(command),
+         result.returncode, result.stderr.decode(errors="replace")))
+   return elapsed * 1000.0
+
+
+def measure_startup(binary, workload, samples, warmup):
+   image = os.path.join(BUILD, workload["name"] + ".kimg")
+   time_process([binary, "--save-image", image, workload["path"]])
+   commands = {
+      "source": [binary, workload["path"]],
+      "image": [binary, "--image", image],
+   }
+   results = {}
+   for kind, command in commands.items():
+      for _ in range(warmup):
+         time_process(command)
+      results[kind] = statistics.median(time_process(command) for _ in range(samples))
+   os.remove(image)
+   return results
+
+
+def report_startup(results):
+   lines = ["%-16s %10s %10s  %s" % ("workload", "source ms", "image ms", "change")]
+   for name, stats in results.items():
+      lines.append("%-16s %10.3f %10.3f  %+.1f%%" % (name, stats["source"], stats["image"],
+         percent_change(stats["image"], stats["source"])))
+   return lines
+
+
+def measure(binary, workload, samples, warmup):
+   for _ in range(warmup):
+      run_once(binary, workload)
+   times = [run_once(binary, workload)[0] for _ in range(samples)]
+   peak = peak_bytes(binary, workload)
+   return {
+      "median": statistics.median(times),
+      "min": min(times),
+      "stddev": statistics.stdev(times) if len(times) > 1 else 0.0,
+      "samples": len(times),
+      "peak_kb": peak / 1024.0 if peak is not None else None,
+   }
+
+
+def percent_change(value, base):
+   return (value - base) / base * 100.0
+
+
+def report(results, baseline, threshold):
+   lines = ["%-16s %10s %10s %10s %10s %10s  %s" % ("workload", "median ms", "min ms",
+      "stddev ms", "peak KB", "baseline", "change")]
+   regressions = []
+   for name, stats in results.items():
+      base = baseline.get(name) if baseline else None
+      change = ""
+      base_text = "-"
+      if base is not None:
+         base_text = "%.3f" % base["median"]
+         delta = percent_change(stats["median"], base["median"])
+         change = "%+.1f%%" % delta
+         if delta > threshold:
+            change += "  REGRESSION"
+            regressions.append(name)
+         if base.get("peak_kb") and stats["peak_kb"] is not None:
+            growth = percent_change(stats["peak_kb"], base["peak_kb"])
+            if growth > threshold:
+               change += "  MEMORY %+.1f%%" % growth
+               if name not in regressions: regressions.append(name)
+      peak = "%.1f" % stats["peak_kb"] if stats["peak_kb"] is not None else "-"
+      lines.append("%-16s %10.3f %10.3f %10.3f %10s %10s  %s" % (name, stats["median"],
+         stats["min"], stats["stddev"], peak, base_text, change))
+   if baseline is not None:
+      lines.append("")
+      if regressions:
+         lines.append("%d regression(s) beyond %.1f%%: %s" % (len(regressions),
+            threshold, ", ".join(regressions)))
+      else:
+         lines.append("no regressions beyond %.1f%%" % threshold)
+   return lines, regressions
+
+
+def main():
+   parser = argparse.ArgumentParser(description="Run the ki benchmark workloads.")
+   parser.add_argument("workloads", nargs="*",
+      help="workload names to run, all of bench/*.ki by default")
+   parser.add_argument("--samples", type=int, default=10,
+      help="timed processes per workload (default 10)")
+   parser.add_argument("--warmup", type=int, default=1,
+      help="untimed processes per workload before sampling (default 1)")
+   parser.add_argument("--micro", action="store_true",
+      help="run the C microbenchmarks instead of the workloads")
+   parser.add_argument("--startup", action="store_true",
+      help="compare one run from source with one run from a saved image")
+   parser.add_argument("--ki", help="use this interpreter instead of building one")
+   parser.add_argument("--baseline", default=None,
+      help="baseline to compare against (default bench/baseline.json if present)")
+   parser.add_argument("--save", nargs="?", const=DEFAULT_BASELINE, default=None,
+      help="save the results as a baseline (default bench/baseline.json)")
+   parser.add_argument("--threshold", type=float, default=5.0,
+      help="slowdown of the median, in percent, counted as a regression (default 5)")
+   args = parser.parse_args()
+
+   if args.micro:
+      micro = build(micro=True)
+      sys.exit(subprocess.run([micro] + args.workloads).returncode)
+
+   paths = sorted(glob.glob(os.path.join(BENCH, "*.ki")))
+   workloads = [load_workload(path) for path in paths]
+   if args.workloads:
+      known = {w["name"] for w in workloads}
+      for name in args.workloads:
+         if name not in known:
+            sys.exit("unknown workload '%s', expected one of: %s" % (name,
+               ", ".join(sorted(known))))
+      workloads = [w for w in workloads if w["name"] in args.workloads]
+
+   binary = args.ki if args.ki else build()
+
+   if args.startup:
+      results = {}
+      for workload in workloads:
+         print("starting %s..." % workload["name"], file=sys.stderr)
+         results[workload["name"]] = measure_startup(binary, workload, args.samples,
+            args.warmup)
+      lines = report_startup(results)
+      print("\n".join(lines))
+      with open(os.path.join(ROOT, "bench_output.txt"), "w") as f:
+         f.write("\n".join(lines) + "\n")
+      sys.exit(0)
+
+   baseline_path = args.baseline
+   if baseline_path is None and os.path.exists(DEFAULT_BASELINE):
+      baseline_path = DEFAULT_BASELINE
+   baseline = None
+   if baseline_path is not None:
+      with open(baseline_path) as f:
+         baseline = json.load(f)["workloads"]
+
+   results = {}
+   for workload in workloads:
+      print("running %s..." % workload["name"], file=sys.stderr)
+      results[workload["name"]] = measure(binary, workload, args.samples, args.warmup)
+
+   lines, regressions = report(results, baseline, args.threshold)
+   print("\n".join(lines))
+   with open(os.path.join(ROOT, "bench_output.txt"), "w") as f:
+      f.write("\n".join(lines) + "\n")
+
+   if args.save:
+      with open(args.save, "w") as f:
+         json.dump({
+            "created": time.strftime("%Y-%m-%d %H:%M:%S"),
+            "machine": os.uname().nodename,
+            "workloads": results,
+         }, f, indent=3, sort_keys=True)
+      print("saved baseline to %s" % args.save, file=sys.stderr)
+
+   sys.exit(1 if regressions else 0)
+
+
+if __name__ == "__main__":
+   main()
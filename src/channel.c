@@ -0,0 +1,330 @@
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+#include <time.h>
+
+#include "channel.h"
+#include "memory.h"
+
+static void free_channel(Channel *channel);
+static bool to_message(VM *vm, Value value, Message *message);
+static Value from_message(VM *vm, Message message);
+static void release_message(Message message);
+static bool check_channel(VM *vm, Value value);
+static NativeResult backoff(VM *vm, int *attempts);
+
+// every named channel, holding one reference to each
+static Channel *channels = NULL;
+static pthread_mutex_t channels_lock = PTHREAD_MUTEX_INITIALIZER;
+
+Channel* open_channel(const char *name, int length, size_t capacity) {
+   pthread_mutex_lock(&channels_lock);
+
+   Channel *channel = channels;
+   while (channel != NULL) {
+      if (strncmp(channel->name, name, length) == 0 && channel->name[length] == '\0') {
+         break;
+      }
+      channel = channel->next;
+   }
+
+   if (channel == NULL) {
+      size_t rounded = 1;
+      while (rounded < capacity) rounded *= 2;
+
+      channel = ALLOCATE(Channel, 1);
+      channel->name = ALLOCATE(char, length + 1);
+      memcpy(channel->name, name, length);
+      channel->name[length] = '\0';
+      atomic_init(&channel->refs, 1);
+      channel->capacity = rounded;
+      channel->cells = ALLOCATE(ChannelCell, rounded);
+      for (size_t i = 0; i < rounded; ++i) {
+         atomic_init(&channel->cells[i].sequence, i);
+      }
+      atomic_init(&channel->send_position, 0);
+      atomic_init(&channel->receive_position, 0);
+
+      channel->next = channels;
+      channels = channel;
+   }
+
+   retain_channel(channel);
+   pthread_mutex_unlock(&channels_lock);
+   return channel;
+}
+
+void retain_channel(Channel *channel) {
+   atomic_fetch_add(&channel->refs, 1);
+}
+
+void release_channel(Channel *channel) {
+   if (atomic_fetch_sub(&channel->refs, 1) == 1) free_channel(channel);
+}
+
+bool channel_try_send(Channel *channel, Message message) {
+   size_t mask = channel->capacity - 1;
+   size_t position = atomic_load_explicit(&channel->send_position, memory_order_relaxed);
+   ChannelCell *cell;
+
+   for (;;) {
+      cell = &channel->cells[position & mask];
+      size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+
+      if (difference == 0) {
+         // the cell is free for this lap, claim it
+         if (atomic_compare_exchange_weak_explicit(&channel->send_position,
+            &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+         {
+         break;
+         }
+      } else if (difference < 0) {
+         // the cell still holds the message of the previous lap
+         return false;
+      } else {
+         // another sender claimed it first
+         position = atomic_load_explicit(&channel->send_position, memory_order_relaxed);
+      }
+   }
+
+   cell->message = message;
+   atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+   return true;
+}
+
+bool channel_try_receive(Channel *channel, Message *message) {
+   size_t mask = channel->capacity - 1;
+   size_t position = atomic_load_explicit(&channel->receive_position, memory_order_relaxed);
+   ChannelCell *cell;
+
+   for (;;) {
+      cell = &channel->cells[position & mask];
+      size_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+      intptr_t difference = (intptr_t)sequence - (intptr_t)(position + 1);
+
+      if (difference == 0) {
+         // the cell is filled for this lap, claim it
+         if (atomic_compare_exchange_weak_explicit(&channel->receive_position,
+            &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+         {
+         break;
+         }
+      } else if (difference < 0) {
+         // nothing was sent to the cell yet
+         return false;
+      } else {
+         // another receiver claimed it first
+         position = atomic_load_explicit(&channel->receive_position, memory_order_relaxed);
+      }
+   }
+
+   *message = cell->message;
+   // free the cell for the sender of the next lap
+   atomic_store_explicit(&cell->sequence, position + mask + 1, memory_order_release);
+   return true;
+}
+
+void free_channels() {
+   pthread_mutex_lock(&channels_lock);
+   Channel *channel = channels;
+   channels = NULL;
+   pthread_mutex_unlock(&channels_lock);
+
+   while (channel != NULL) {
+      Channel *next = channel->next;
+      release_channel(channel);
+      channel = next;
+   }
+}
+
+NativeResult channel_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!IS_TEXT(args[0])) {
+      runtime_error(vm, "Channel name must be a string");
+      return NATIVE_ERROR;
+   }
+
+   Channel *channel = open_channel(text_chars(args[0]), text_length(args[0]),
+      CHANNEL_DEFAULT_CAPACITY);
+   *result = OBJ_VAL(new_channel_object(vm, channel));
+   return NATIVE_OK;
+}
+
+NativeResult send_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   Message message;
+   if (!check_channel(vm, args[0]) || !to_message(vm, args[1], &message)) {
+      return NATIVE_ERROR;
+   }
+
+   int attempts = 0;
+   while (!channel_try_send(AS_CHANNEL(args[0])->channel, message)) {
+      NativeResult status = backoff(vm, &attempts);
+      if (status != NATIVE_OK) {
+         release_message(message);
+         return status;
+      }
+   }
+
+   *result = NIL_VAL;
+   return NATIVE_OK;
+}
+
+NativeResult try_send_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   Message message;
+   if (!check_channel(vm, args[0]) || !to_message(vm, args[1], &message)) {
+      return NATIVE_ERROR;
+   }
+
+   bool sent = channel_try_send(AS_CHANNEL(args[0])->channel, message);
+   if (!sent) release_message(message);
+
+   *result = BOOL_VAL(sent);
+   return NATIVE_OK;
+}
+
+NativeResult receive_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_channel(vm, args[0])) return NATIVE_ERROR;
+
+   Message message;
+   int attempts = 0;
+   while (!channel_try_receive(AS_CHANNEL(args[0])->channel, &message)) {
+      NativeResult status = backoff(vm, &attempts);
+      if (status != NATIVE_OK) return status;
+   }
+
+   *result = from_message(vm, message);
+   return NATIVE_OK;
+}
+
+NativeResult try_receive_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_channel(vm, args[0])) return NATIVE_ERROR;
+
+   Message message;
+   if (channel_try_receive(AS_CHANNEL(args[0])->channel, &message)) {
+      *result = from_message(vm, message);
+   } else {
+      *result = NIL_VAL;
+   }
+   return NATIVE_OK;
+}
+
+static void free_channel(Channel *channel) {
+   // release whatever was sent but never received
+   Message message;
+   while (channel_try_receive(channel, &message)) {
+      release_message(message);
+   }
+
+   FREE_ARRAY(channel->cells, ChannelCell, channel->capacity);
+   FREE_ARRAY(channel->name, char, strlen(channel->name) + 1);
+   FREE(Channel, channel);
+}
+
+static bool to_message(VM *vm, Value value, Message *message) {
+   switch (value.type) {
+      case VAL_NIL:
+         message->type = MESSAGE_NIL;
+         return true;
+      case VAL_BOOL:
+         message->type = MESSAGE_BOOL;
+         message->as.boolean = AS_BOOL(value);
+         return true;
+      case VAL_NUMBER:
+         message->type = MESSAGE_NUMBER;
+         message->as.number = AS_NUMBER(value);
+         return true;
+      case VAL_INT:
+         message->type = MESSAGE_INT;
+         message->as.integer = AS_INT(value);
+         return true;
+      case VAL_OBJ:
+         // the receiver gets a string, its parent stays behind
+         if (IS_SLICE(value)) value = OBJ_VAL(text_string(vm, value));
+         if (AS_OBJ(value)->is_frozen && IS_STRING(value)) {
+            message->type = MESSAGE_FROZEN_STRING;
+            message->as.frozen = AS_STRING(value);
+            return true;
+         }
+         if (IS_STRING(value)) {
+            message->type = MESSAGE_STRING;
+            message->as.string = share_string(AS_STRING(value));
+            return true;
+         }
+         if (IS_CHANNEL(value)) {
+            message->type = MESSAGE_CHANNEL;
+            message->as.channel = AS_CHANNEL(value)->channel;
+            retain_channel(message->as.channel);
+            return true;
+         }
+         break;
+   }
+
+   runtime_error(vm, "Only nil, booleans, numbers, strings and channels can be sent");
+   return false;
+}
+
+static Value from_message(VM *vm, Message message) {
+   switch (message.type) {
+      case MESSAGE_NIL: return NIL_VAL;
+      case MESSAGE_BOOL: return BOOL_VAL(message.as.boolean);
+      case MESSAGE_NUMBER: return NUMBER_VAL(message.as.number);
+      case MESSAGE_INT: return INT_VAL(message.as.integer);
+      case MESSAGE_FROZEN_STRING: return OBJ_VAL(message.as.frozen);
+      case MESSAGE_STRING:
+         return OBJ_VAL(string_from_shared(vm, message.as.string));
+      case MESSAGE_CHANNEL:
+         return OBJ_VAL(new_channel_object(vm, message.as.channel));
+   }
+
+   return NIL_VAL; // Unreachable
+}
+
+static void release_message(Message message) {
+   if (message.type == MESSAGE_STRING) release_shared_chars(message.as.string);
+   if (message.type == MESSAGE_CHANNEL) release_channel(message.as.channel);
+}
+
+static bool check_channel(VM *vm, Value value) {
+   if (IS_CHANNEL(value)) return true;
+
+   runtime_error(vm, "Expected a channel");
+   return false;
+}
+
+// spins first, then yields the cpu, then sleeps, so a short wait stays
+// cheap and a long one doesn't burn a core
+// the other end may be another fiber of this vm, or under a scheduler
+// another script on this thread, so the fiber steps aside whenever
+// something else can run and only sleeps when nothing can
+// returns NATIVE_OK to try again, NATIVE_ERROR once the script is out of
+// time and NATIVE_BLOCK to try again on the fiber's next turn
+static NativeResult backoff(VM *vm, int *attempts) {
+   ++*attempts;
+   if (*attempts < 64) return NATIVE_OK;
+   // fibers waiting on a file descriptor are looked at without waiting
+   // at first, after that polling for them is the pause
+   bool waiting = vm->events.waiting > 0;
+   if (vm->sliced || vm->ready_head != NULL
+      || (waiting && poll_fibers(vm, *attempts < 128 ? 0 : 1)))
+   {
+      reschedule_fiber(vm);
+      return NATIVE_BLOCK;
+   }
+   if (*attempts < 128) {
+      sched_yield();
+      return NATIVE_OK;
+   }
+   // a long wait, the output so far shouldn't wait with it
+   if (*attempts == 128) flush_output(&vm->output);
+   if (out_of_time(vm)) return NATIVE_ERROR;
+   if (waiting) return NATIVE_OK;
+
+   struct timespec pause = { 0, 100000 };
+   nanosleep(&pause, NULL);
+   return NATIVE_OK;
+}
\ No newline at end of file
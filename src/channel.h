@@ -0,0 +1,89 @@
+#ifndef KI_CHANNEL_H
+#define KI_CHANNEL_H
+
+#include <stdalign.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "native.h"
+#include "object.h"
+
+#define CHANNEL_DEFAULT_CAPACITY 1024
+
+typedef enum {
+   MESSAGE_NIL,
+   MESSAGE_BOOL,
+   MESSAGE_NUMBER,
+   MESSAGE_INT,
+   // frozen strings are valid in every vm, the pointer itself is sent
+   MESSAGE_FROZEN_STRING,
+   MESSAGE_STRING,
+   MESSAGE_CHANNEL
+} MessageType;
+
+// A value in transit between vms
+// Numbers, booleans and nil are copied, strings travel as a reference to
+// their characters and are interned again by the receiving vm
+typedef struct {
+   MessageType type;
+   union {
+      bool boolean;
+      double number;
+      int64_t integer;
+      ObjString *frozen;
+      SharedChars *string;
+      Channel *channel;
+   } as;
+} Message;
+
+typedef struct {
+   atomic_size_t sequence;
+   Message message;
+} ChannelCell;
+
+// A bounded lock free queue of messages, any number of vms may send and
+// receive at the same time
+// Cells carry a sequence number telling whether they are free for the
+// next sender or filled for the next receiver of their lap around the
+// ring, so senders and receivers only ever contend on their own position
+struct sChannel {
+   char *name;
+   atomic_int refs;
+   // a power of two
+   size_t capacity;
+   ChannelCell *cells;
+
+   // kept on separate cache lines so senders and receivers don't
+   // invalidate each other's
+   alignas(64) atomic_size_t send_position;
+   alignas(64) atomic_size_t receive_position;
+
+   // next channel in the registry
+   struct sChannel *next;
+};
+
+// the channel called [name], created with room for [capacity] messages
+// if it doesn't exist yet
+// returns a new reference
+Channel* open_channel(const char *name, int length, size_t capacity);
+void retain_channel(Channel *channel);
+void release_channel(Channel *channel);
+// non blocking, return false if the channel is full or empty
+// a message that isn't sent still belongs to the caller
+bool channel_try_send(Channel *channel, Message message);
+bool channel_try_receive(Channel *channel, Message *message);
+// drops the registry's references, channels still in use stay alive
+void free_channels();
+
+// channel(name)
+NativeResult channel_native(VM *vm, int arg_count, Value *args, Value *result);
+// send(channel, value), waits while the channel is full
+NativeResult send_native(VM *vm, int arg_count, Value *args, Value *result);
+// try_send(channel, value), returns whether the value was sent
+NativeResult try_send_native(VM *vm, int arg_count, Value *args, Value *result);
+// receive(channel), waits while the channel is empty
+NativeResult receive_native(VM *vm, int arg_count, Value *args, Value *result);
+// try_receive(channel), returns nil if the channel is empty
+NativeResult try_receive_native(VM *vm, int arg_count, Value *args, Value *result);
+
+#endif
\ No newline at end of file
@@ -21,7 +21,20 @@ typedef enum {
    OP_NOT,
    OP_NEGATE,
    OP_POP,
+   // operand: element count
+   OP_BUILD_LIST,
+   // operand: key and value pair count
+   OP_BUILD_MAP,
+   OP_GET_INDEX,
+   OP_SET_INDEX,
+   // operands: native index, argument count
+   OP_CALL_NATIVE,
    OP_PRINT,
+   // operands: stack size of the new fiber, 16 bit offset to the code
+   //    after the fiber's body
+   OP_SPAWN,
+   OP_YIELD,
+   OP_END_FIBER,
    OP_RETURN,
 } OpCode;
 
@@ -5,7 +5,4 @@
 #include <stddef.h>
 #include <stdint.h>
 
-#define DEBUG_PRINT_CODE
-#define DEBUG_TRACE_EXECUTION
-
 #endif
\ No newline at end of file
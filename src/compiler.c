@@ -1,15 +1,14 @@
 #include <stdio.h>
-#include <stdlib.h>
 
 #include "common.h"
 #include "compiler.h"
 #include "scanner.h"
+#include "tokens.h"
 #include "chunk.h"
+#include "native.h"
+#include "number.h"
 #include "object.h"
-
-#ifdef DEBUG_PRINT_CODE
 #include "debug.h"
-#endif
 
 typedef struct {
    // next token to consume
@@ -20,6 +19,16 @@ typedef struct {
    Token previous;
    bool had_error;
    bool panic_mode;
+   // when set, tokens are read from this buffer instead of the scanner
+   TokenBuffer *tokens;
+   int next_token;
+   Scanner scanner;
+   // whether the expression being parsed may be an assignment target,
+   // set before each prefix and infix rule runs
+   bool can_assign;
+   // the vm owning the objects created while compiling
+   VM *vm;
+   Chunk *chunk;
 } Parser;
 
 typedef enum {
@@ -28,7 +37,7 @@ typedef enum {
    PREC_UNARY, PREC_CALL, PREC_PRIMARY
 } Precedence;
 
-typedef void (*ParseFn)();
+typedef void (*ParseFn)(Parser *parser);
 typedef struct {
    ParseFn prefix;
    ParseFn infix;
@@ -36,280 +45,519 @@ typedef struct {
 } ParseRule;
 
 // forward declarations
-static void declaration();
-static void statement();
-static void print_statement();
-static void expression_statement();
-static void expression();
-static void parse_precedence(Precedence precedence);
-static void grouping();
-static void literal();
-static void number();
-static void string();
-static void unary();
+static bool parse(Parser *parser, VM *vm, Chunk *chunk);
+static void declaration(Parser *parser);
+static void statement(Parser *parser);
+static void print_statement(Parser *parser);
+static void spawn_statement(Parser *parser);
+static void yield_statement(Parser *parser);
+static void expression_statement(Parser *parser);
+static void expression(Parser *parser);
+static void parse_precedence(Parser *parser, Precedence precedence);
+static void grouping(Parser *parser);
+static void literal(Parser *parser);
+static void number(Parser *parser);
+static void string(Parser *parser);
+static void unary(Parser *parser);
+static void list(Parser *parser);
+static void map(Parser *parser);
+static void subscript(Parser *parser);
+static void native_call(Parser *parser);
 static ParseRule* get_rule(TokenType type);
-static void advance();
-static bool check(TokenType type);
-static bool match(TokenType type);
-static void consume(TokenType type, const char *message);
-static void end_compiler();
-static void emit_byte(uint8_t byte);
-static void emit_bytes(uint8_t byte1, uint8_t byte2);
-static void emit_constant(Value value);
-static uint8_t make_constant(Value value);
-static void emit_return();
-static void error_at_previous(const char *message);
-static void error_at_current(const char *message);
-static void error_at(Token *error_token, const char *message);
+static Token next_token(Parser *parser);
+static void advance(Parser *parser);
+static bool check(Parser *parser, TokenType type);
+static bool match(Parser *parser, TokenType type);
+static void consume(Parser *parser, TokenType type, const char *message);
+static void end_compiler(Parser *parser);
+static int max_stack_depth(Chunk *chunk, int start, int end);
+static void emit_byte(Parser *parser, uint8_t byte);
+static void emit_bytes(Parser *parser, uint8_t byte1, uint8_t byte2);
+static void emit_constant(Parser *parser, Value value);
+static uint8_t make_constant(Parser *parser, Value value);
+static void emit_return(Parser *parser);
+static void error_at_previous(Parser *parser, const char *message);
+static void error_at_current(Parser *parser, const char *message);
+static void error_at(Parser *parser, Token *error_token, const char *message);
 
 ParseRule rules[];
 
-Parser parser;
+static VM *current_vm(Parser *parser) {
+   return parser->vm;
+}
+
+static Chunk *current_chunk(Parser *parser) {
+   return parser->chunk;
+}
 
-VM *compiling_vm;
-static VM *current_vm() {
-   return compiling_vm;
+bool compile(const char *source, size_t length, VM *vm, Chunk *chunk) {
+   // all compilation state lives here so any number of threads can
+   // compile at once, each with its own vm
+   Parser parser;
+   TokenBuffer tokens;
+   if (vm->batch_lexing) {
+      init_token_buffer(&tokens);
+      tokenize(&tokens, source, length);
+      parser.tokens = &tokens;
+      parser.next_token = 0;
+   } else {
+      init_scanner(&parser.scanner, source, length);
+      parser.tokens = NULL;
+   }
+   return parse(&parser, vm, chunk);
 }
 
-Chunk *compiling_chunk;
-static Chunk *current_chunk() {
-   return compiling_chunk;
+bool compile_stream(SourceReader *reader, VM *vm, Chunk *chunk) {
+   // batch lexing wants the whole source first, which a stream doesn't
+   // have, so it always goes through the scanner
+   Parser parser;
+   init_stream_scanner(&parser.scanner, reader);
+   parser.tokens = NULL;
+   return parse(&parser, vm, chunk);
 }
 
-bool compile(const char *source, VM *vm, Chunk *chunk) {
-   init_scanner(source);
-   compiling_vm = vm;
-   compiling_chunk = chunk;
+static bool parse(Parser *parser, VM *vm, Chunk *chunk) {
+   parser->vm = vm;
+   parser->chunk = chunk;
 
-   parser.had_error = false;
-   parser.panic_mode = false;
+   parser->had_error = false;
+   parser->panic_mode = false;
    // initializes parser field current to first token
-   advance();
+   advance(parser);
    
    // parse
-   while (!match(TOKEN_EOF)) {
-      declaration();
+   while (!match(parser, TOKEN_EOF)) {
+      declaration(parser);
    }
    
-   end_compiler();
-   return !parser.had_error;
+   end_compiler(parser);
+   if (parser->tokens != NULL) {
+      free_token_buffer(parser->tokens);
+   } else {
+      free_scanner(&parser->scanner);
+   }
+   return !parser->had_error;
 }
 
-static void declaration() {
-   statement();
+static void declaration(Parser *parser) {
+   statement(parser);
 }
 
-static void statement() {
-   if (match(TOKEN_PRINT)) {
-      print_statement();
+static void statement(Parser *parser) {
+   if (match(parser, TOKEN_PRINT)) {
+      print_statement(parser);
+   } else if (match(parser, TOKEN_SPAWN)) {
+      spawn_statement(parser);
+   } else if (match(parser, TOKEN_YIELD)) {
+      yield_statement(parser);
    } else {
-      expression_statement();
+      expression_statement(parser);
    }
 }
 
-static void print_statement() {
-   expression();
-   consume(TOKEN_SEMICOLON, "Expected ';' after print value");
-   emit_byte(OP_PRINT);
+static void print_statement(Parser *parser) {
+   expression(parser);
+   consume(parser, TOKEN_SEMICOLON, "Expected ';' after print value");
+   emit_byte(parser, OP_PRINT);
 }
 
-static void expression_statement() {
-   expression();
-   emit_byte(OP_POP);
-   consume(TOKEN_SEMICOLON, "Expected ';' after expression");
+// spawn { body }
+// the body runs later in its own fiber, the spawning code jumps over it
+static void spawn_statement(Parser *parser) {
+   consume(parser, TOKEN_LEFT_BRACE, "Expected '{' after 'spawn'");
+
+   Chunk *chunk = current_chunk(parser);
+   emit_byte(parser, OP_SPAWN);
+   int operands = chunk->count;
+   // stack size and jump offset, patched once the body is compiled
+   emit_byte(parser, 0);
+   emit_bytes(parser, 0xff, 0xff);
+
+   int body = chunk->count;
+   while (!check(parser, TOKEN_RIGHT_BRACE) && !check(parser, TOKEN_EOF)) {
+      declaration(parser);
+   }
+   consume(parser, TOKEN_RIGHT_BRACE, "Expected '}' after fiber body");
+   emit_byte(parser, OP_END_FIBER);
+
+   int jump = chunk->count - body;
+   if (jump > UINT16_MAX) {
+      error_at_previous(parser, "Too much code in fiber body");
+   }
+   int stack_size = max_stack_depth(chunk, body, chunk->count);
+   if (stack_size > UINT8_MAX) {
+      error_at_previous(parser, "Fiber body needs too deep a stack");
+   }
+
+   chunk->code[operands] = (uint8_t)stack_size;
+   chunk->code[operands + 1] = (jump >> 8) & 0xff;
+   chunk->code[operands + 2] = jump & 0xff;
+}
+
+static void yield_statement(Parser *parser) {
+   consume(parser, TOKEN_SEMICOLON, "Expected ';' after 'yield'");
+   emit_byte(parser, OP_YIELD);
 }
 
-static void expression() {
-   parse_precedence(PREC_ASSIGNMENT);
+static void expression_statement(Parser *parser) {
+   expression(parser);
+   emit_byte(parser, OP_POP);
+   consume(parser, TOKEN_SEMICOLON, "Expected ';' after expression");
 }
 
-static void parse_precedence(Precedence precedence) {
-   advance();
-   ParseFn prefix_rule = get_rule(parser.previous.type)->prefix;
+static void expression(Parser *parser) {
+   parse_precedence(parser, PREC_ASSIGNMENT);
+}
+
+static void parse_precedence(Parser *parser, Precedence precedence) {
+   advance(parser);
+   ParseFn prefix_rule = get_rule(parser->previous.type)->prefix;
    if (prefix_rule == NULL) {
-   error_at_previous("Expected expression");
+   error_at_previous(parser, "Expected expression");
    return;
    }
 
-   prefix_rule();
+   bool can_assign = precedence <= PREC_ASSIGNMENT;
+   parser->can_assign = can_assign;
+   prefix_rule(parser);
+
+   while (precedence <= get_rule(parser->current.type)->precedence) {
+   advance(parser);
+   ParseFn infix_rule = get_rule(parser->previous.type)->infix;
+   // some tokens have a precedence reserved before their infix rule exists
+   if (infix_rule == NULL) {
+      error_at_previous(parser, "Unsupported operator");
+      return;
+   }
+   parser->can_assign = can_assign;
+   infix_rule(parser);
+   }
 
-   while (precedence <= get_rule(parser.current.type)->precedence) {
-   advance();
-   ParseFn infix_rule = get_rule(parser.previous.type)->infix;
-   infix_rule();
+   // nothing above took the '=', what's left of it can't be assigned to
+   if (can_assign && match(parser, TOKEN_EQUAL)) {
+   error_at_previous(parser, "Invalid assignment target");
    }
 }
 
-static void binary() {
-   TokenType operator_type = parser.previous.type;
+static void binary(Parser *parser) {
+   TokenType operator_type = parser->previous.type;
 
    // compile operand
    ParseRule *rule = get_rule(operator_type);
-   parse_precedence((Precedence) (rule->precedence + 1));
+   parse_precedence(parser, (Precedence) (rule->precedence + 1));
 
    switch(operator_type) {
-   case TOKEN_EQUAL_EQUAL: emit_byte(OP_EQUAL); break;
+   case TOKEN_EQUAL_EQUAL: emit_byte(parser, OP_EQUAL); break;
    // a != b is equal to !(a == b)
-   case TOKEN_BANG_EQUAL: emit_bytes(OP_EQUAL, OP_NOT); break;
-   case TOKEN_GREATER: emit_byte(OP_GREATER); break;
+   case TOKEN_BANG_EQUAL: emit_bytes(parser, OP_EQUAL, OP_NOT); break;
+   case TOKEN_GREATER: emit_byte(parser, OP_GREATER); break;
    // a >= b is equal to !(a < b)
-   case TOKEN_GREATER_EQUAL: emit_bytes(OP_LESS, OP_NOT); break;
-   case TOKEN_LESS: emit_byte(OP_LESS); break;
+   case TOKEN_GREATER_EQUAL: emit_bytes(parser, OP_LESS, OP_NOT); break;
+   case TOKEN_LESS: emit_byte(parser, OP_LESS); break;
    // a <= b is equal to !(a > b)
-   case TOKEN_LESS_EQUAL: emit_bytes(OP_GREATER, OP_NOT); break;
-   case TOKEN_PLUS: emit_byte(OP_ADD); break;
-   case TOKEN_MINUS: emit_byte(OP_SUBTRACT); break;
-   case TOKEN_STAR: emit_byte(OP_MULTIPLY); break;
-   case TOKEN_SLASH: emit_byte(OP_DIVIDE); break;
+   case TOKEN_LESS_EQUAL: emit_bytes(parser, OP_GREATER, OP_NOT); break;
+   case TOKEN_PLUS: emit_byte(parser, OP_ADD); break;
+   case TOKEN_MINUS: emit_byte(parser, OP_SUBTRACT); break;
+   case TOKEN_STAR: emit_byte(parser, OP_MULTIPLY); break;
+   case TOKEN_SLASH: emit_byte(parser, OP_DIVIDE); break;
    default:
       // Unreachable
       return;
    }
 }
 
-static void grouping() {
-   expression();
-   consume(TOKEN_RIGHT_PAREN, "Expected ')' after expression");
+static void grouping(Parser *parser) {
+   expression(parser);
+   consume(parser, TOKEN_RIGHT_PAREN, "Expected ')' after expression");
 }
 
-static void literal() {
-   switch(parser.previous.type) {
-      case TOKEN_FALSE: emit_byte(OP_FALSE); break;
-      case TOKEN_NIL: emit_byte(OP_NIL); break;
-      case TOKEN_TRUE: emit_byte(OP_TRUE); break;
+static void literal(Parser *parser) {
+   switch(parser->previous.type) {
+      case TOKEN_FALSE: emit_byte(parser, OP_FALSE); break;
+      case TOKEN_NIL: emit_byte(parser, OP_NIL); break;
+      case TOKEN_TRUE: emit_byte(parser, OP_TRUE); break;
       default:
          return; // Unreachable
    }
 }
 
-static void number() {
-   double value = strtod(parser.previous.start, NULL);
-   emit_constant(NUMBER_VAL(value));
+static void number(Parser *parser) {
+   int64_t integer;
+   if (parse_integer(parser->previous.start, parser->previous.length, &integer)) {
+      emit_constant(parser, INT_VAL(integer));
+      return;
+   }
+
+   // fractions, and integers too big for an int
+   double value;
+   if (!parse_number(parser->previous.start, parser->previous.length, &value)) {
+      error_at_previous(parser, "Invalid number");
+      return;
+   }
+   emit_constant(parser, NUMBER_VAL(value));
 }
 
-static void string() {
-   emit_constant(OBJ_VAL(copy_string(current_vm(), parser.previous.start +1,
-      parser.previous.length - 2)));
+static void string(Parser *parser) {
+   emit_constant(parser, OBJ_VAL(copy_string(current_vm(parser), parser->previous.start +1,
+      parser->previous.length - 2)));
 }
 
-static void unary() {
-   TokenType operator_type = parser.previous.type;
+static void unary(Parser *parser) {
+   TokenType operator_type = parser->previous.type;
 
    // Compile operand
-   parse_precedence(PREC_UNARY);
+   parse_precedence(parser, PREC_UNARY);
 
    switch(operator_type) {
-   case TOKEN_BANG: emit_byte(OP_NOT); break;
-   case TOKEN_MINUS: emit_byte(OP_NEGATE); break;
+   case TOKEN_BANG: emit_byte(parser, OP_NOT); break;
+   case TOKEN_MINUS: emit_byte(parser, OP_NEGATE); break;
    default:
       // Unreachable
       return;
    }
 }
 
+// [a, b, c]
+static void list(Parser *parser) {
+   int count = 0;
+   if (!check(parser, TOKEN_RIGHT_BRACKET)) {
+      do {
+         // allows a trailing comma
+         if (check(parser, TOKEN_RIGHT_BRACKET)) break;
+         expression(parser);
+         ++count;
+      } while (match(parser, TOKEN_COMMA));
+   }
+   consume(parser, TOKEN_RIGHT_BRACKET, "Expected ']' after list elements");
+
+   // the elements are all on the stack before the list is built
+   if (count > UINT8_MAX) {
+      error_at_previous(parser, "Too many elements in list literal");
+      return;
+   }
+   emit_bytes(parser, OP_BUILD_LIST, (uint8_t)count);
+}
+
+// {key: value, key: value}
+static void map(Parser *parser) {
+   int count = 0;
+   if (!check(parser, TOKEN_RIGHT_BRACE)) {
+      do {
+         // allows a trailing comma
+         if (check(parser, TOKEN_RIGHT_BRACE)) break;
+         expression(parser);
+         consume(parser, TOKEN_COLON, "Expected ':' after map key");
+         expression(parser);
+         ++count;
+      } while (match(parser, TOKEN_COMMA));
+   }
+   consume(parser, TOKEN_RIGHT_BRACE, "Expected '}' after map entries");
+
+   if (count > UINT8_MAX) {
+      error_at_previous(parser, "Too many entries in map literal");
+      return;
+   }
+   emit_bytes(parser, OP_BUILD_MAP, (uint8_t)count);
+}
+
+// list[index] and list[index] = value, maps too
+static void subscript(Parser *parser) {
+   bool can_assign = parser->can_assign;
+   expression(parser);
+   consume(parser, TOKEN_RIGHT_BRACKET, "Expected ']' after index");
+
+   if (can_assign && match(parser, TOKEN_EQUAL)) {
+      expression(parser);
+      emit_byte(parser, OP_SET_INDEX);
+   } else {
+      emit_byte(parser, OP_GET_INDEX);
+   }
+}
+
+static void native_call(Parser *parser) {
+   Token name = parser->previous;
+   int native = find_native(name.start, name.length);
+   if (native < 0) {
+      error_at_previous(parser, "Undefined name");
+      return;
+   }
+
+   consume(parser, TOKEN_LEFT_PAREN, "Expected '(' after native name");
+   int arg_count = 0;
+   if (!check(parser, TOKEN_RIGHT_PAREN)) {
+      do {
+         expression(parser);
+         ++arg_count;
+      } while (match(parser, TOKEN_COMMA));
+   }
+   consume(parser, TOKEN_RIGHT_PAREN, "Expected ')' after arguments");
+
+   // natives are known while compiling so the arity is checked here
+   // rather than on every call
+   if (natives[native].arity != arg_count) {
+      error_at(parser, &name, "Wrong number of arguments");
+      return;
+   }
+
+   emit_bytes(parser, OP_CALL_NATIVE, (uint8_t)native);
+   emit_byte(parser, (uint8_t)arg_count);
+}
+
 static ParseRule* get_rule(TokenType type) {
    return &rules[type];
 }
 
-static void advance() {
-   parser.previous = parser.current;
+static Token next_token(Parser *parser) {
+   if (parser->tokens == NULL) return scan_token(&parser->scanner);
+
+   // the buffer ends with TOKEN_EOF, which is handed out forever
+   Token token = token_at(parser->tokens, parser->next_token);
+   if (token.type != TOKEN_EOF) ++parser->next_token;
+   return token;
+}
+
+static void advance(Parser *parser) {
+   parser->previous = parser->current;
 
    for (;;) {
-   parser.current = scan_token();
-   if (parser.current.type != TOKEN_ERROR) break;
+   parser->current = next_token(parser);
+   if (parser->current.type != TOKEN_ERROR) break;
    // Error messages from scanner are stored in error tokens
-   error_at_current(parser.current.start);
+   error_at_current(parser, parser->current.start);
    }
 }
 
-static bool check(TokenType type) {
-   return parser.current.type == type;
+static bool check(Parser *parser, TokenType type) {
+   return parser->current.type == type;
 }
 
-static bool match(TokenType type) {
-   if (check(type)) {
-      advance();
+static bool match(Parser *parser, TokenType type) {
+   if (check(parser, type)) {
+      advance(parser);
       return true;
    }
    return false;
 }
 
-static void consume(TokenType type, const char *message) {
-   if (check(type)) {
-   advance();
+static void consume(Parser *parser, TokenType type, const char *message) {
+   if (check(parser, type)) {
+   advance(parser);
    return;
    }
 
-   error_at_current(message);
+   error_at_current(parser, message);
+}
+
+static void end_compiler(Parser *parser) {
+   VM *vm = current_vm(parser);
+   if (vm->disassembly != NULL && !parser->had_error) {
+   disassemble_chunk(vm->disassembly, current_chunk(parser), "code");
+   }
+   emit_return(parser);
+
+   Chunk *chunk = current_chunk(parser);
+   if (max_stack_depth(chunk, 0, chunk->count) > STACK_MAX) {
+      error_at_previous(parser, "Expression needs too deep a stack");
+   }
 }
 
-static void end_compiler() {
-#ifdef DEBUG_PRINT_CODE
-   if (!parser.had_error) {
-   disassemble_chunk(current_chunk(), "code");
+// the most values the code in [start, end) has on the stack at once
+// code is straight line so one walk over it is enough, nested fiber
+// bodies are skipped since they run on their own stacks
+static int max_stack_depth(Chunk *chunk, int start, int end) {
+   int depth = 0;
+   int max_depth = 0;
+   for (int offset = start; offset < end;) {
+      uint8_t *code = &chunk->code[offset];
+      switch (code[0]) {
+         case OP_CONSTANT: depth += 1; offset += 2; break;
+         case OP_NIL:
+         case OP_TRUE:
+         case OP_FALSE: depth += 1; offset += 1; break;
+         case OP_EQUAL:
+         case OP_GREATER:
+         case OP_LESS:
+         case OP_ADD:
+         case OP_SUBTRACT:
+         case OP_MULTIPLY:
+         case OP_DIVIDE:
+         case OP_POP:
+         case OP_PRINT: depth -= 1; offset += 1; break;
+         case OP_BUILD_LIST: depth += 1 - code[1]; offset += 2; break;
+         case OP_BUILD_MAP: depth += 1 - 2 * code[1]; offset += 2; break;
+         case OP_GET_INDEX: depth -= 1; offset += 1; break;
+         case OP_SET_INDEX: depth -= 2; offset += 1; break;
+         case OP_CALL_NATIVE: depth += 1 - code[2]; offset += 3; break;
+         case OP_SPAWN: offset += 4 + (code[2] << 8 | code[3]); break;
+         default: offset += 1; break;
+      }
+      if (depth > max_depth) max_depth = depth;
    }
-#endif
-   emit_return();
+   return max_depth;
 }
 
-static void emit_byte(uint8_t byte) {
-   write_chunk(current_chunk(), byte, parser.previous.line);
+static void emit_byte(Parser *parser, uint8_t byte) {
+   write_chunk(current_chunk(parser), byte, parser->previous.line);
 }
 
-static void emit_bytes(uint8_t byte1, uint8_t byte2) {
-   emit_byte(byte1);
-   emit_byte(byte2);
+static void emit_bytes(Parser *parser, uint8_t byte1, uint8_t byte2) {
+   emit_byte(parser, byte1);
+   emit_byte(parser, byte2);
 }
 
-static void emit_constant(Value value) {
-   emit_bytes(OP_CONSTANT, make_constant(value));
+static void emit_constant(Parser *parser, Value value) {
+   emit_bytes(parser, OP_CONSTANT, make_constant(parser, value));
 }
 
-static uint8_t make_constant(Value value) {
-   int constant_index = add_constant(current_chunk(), value);
+static uint8_t make_constant(Parser *parser, Value value) {
+   int constant_index = add_constant(current_chunk(parser), value);
    if (constant_index > UINT8_MAX) {
-   error_at_previous("Too many constants in one chunk");
+   error_at_previous(parser, "Too many constants in one chunk");
    return 0;
    }
 
    return (uint8_t) constant_index;
 }
 
-static void emit_return() {
-   emit_byte(OP_RETURN);
+static void emit_return(Parser *parser) {
+   emit_byte(parser, OP_RETURN);
 }
 
-static void error_at_previous(const char *message) {
-   error_at(&parser.previous, message);
+static void error_at_previous(Parser *parser, const char *message) {
+   error_at(parser, &parser->previous, message);
 }
 
-static void error_at_current(const char *message) {
-   error_at(&parser.current, message);
+static void error_at_current(Parser *parser, const char *message) {
+   error_at(parser, &parser->current, message);
 }
 
-static void error_at(Token *error_token, const char *message) {
-   if (parser.panic_mode) return;
-   parser.panic_mode = true;
+static void error_at(Parser *parser, Token *error_token, const char *message) {
+   if (parser->panic_mode) return;
+   parser->panic_mode = true;
 
-   fprintf(stderr, "[line %d] Error", error_token->line);
+   FILE *errors = parser->vm->errors;
+   fprintf(errors, "[line %d] Error", error_token->line);
 
    if (error_token->type == TOKEN_EOF) {
-   fprintf(stderr, " at end");
+   fprintf(errors, " at end");
    } else if (error_token->type == TOKEN_ERROR) {
    // Nothing
    } else {
-   fprintf(stderr, " at '%.*s'", error_token->length, error_token->start);
+   fprintf(errors, " at '%.*s'", error_token->length, error_token->start);
    }
 
-   fprintf(stderr, ": %s\n", message);
-   parser.had_error = true;
+   fprintf(errors, ": %s\n", message);
+   parser->had_error = true;
 }
 
 ParseRule rules[] = {
    { grouping, NULL, PREC_CALL }, // TOKEN_LEFT_PAREN
    { NULL,  NULL, PREC_NONE }, // TOKEN_RIGHT_PAREN
-   { NULL,  NULL, PREC_NONE }, // TOKEN_LEFT_BRACE
+   { map,  NULL, PREC_NONE }, // TOKEN_LEFT_BRACE
    { NULL,  NULL, PREC_NONE }, // TOKEN_RIGHT_BRACE
+   { list,  subscript, PREC_CALL }, // TOKEN_LEFT_BRACKET
+   { NULL,  NULL, PREC_NONE }, // TOKEN_RIGHT_BRACKET
+   { NULL,  NULL, PREC_NONE }, // TOKEN_COLON
    { NULL,  NULL, PREC_NONE }, // TOKEN_COMMA
    { NULL,  NULL, PREC_CALL }, // TOKEN_DOT
    { unary, binary,  PREC_TERM }, // TOKEN_MINUS
@@ -325,7 +573,7 @@ ParseRule rules[] = {
    { NULL,  binary, PREC_COMPARISON }, // TOKEN_GREATER_EQUAL
    { NULL,  binary, PREC_COMPARISON }, // TOKEN_LESS
    { NULL,  binary, PREC_COMPARISON }, // TOKEN_LESS_EQUAL
-   { NULL,  NULL, PREC_NONE }, // TOKEN_IDENTIFIER
+   { native_call,  NULL, PREC_NONE }, // TOKEN_IDENTIFIER
    { string,  NULL, PREC_NONE }, // TOKEN_STRING
    { number,NULL, PREC_NONE }, // TOKEN_NUMBER
    { NULL,  NULL, PREC_AND },  // TOKEN_AND
@@ -339,11 +587,13 @@ ParseRule rules[] = {
    { NULL,  NULL, PREC_OR }, // TOKEN_OR
    { NULL,  NULL, PREC_NONE }, // TOKEN_PRINT
    { NULL,  NULL, PREC_NONE }, // TOKEN_RETURN
+   { NULL,  NULL, PREC_NONE }, // TOKEN_SPAWN
    { NULL,  NULL, PREC_NONE }, // TOKEN_SUPER
    { NULL,  NULL, PREC_NONE }, // TOKEN_THIS
    { literal,  NULL, PREC_NONE }, // TOKEN_TRUE
    { NULL,  NULL, PREC_NONE }, // TOKEN_VAR
    { NULL,  NULL, PREC_NONE }, // TOKEN_WHILE
+   { NULL,  NULL, PREC_NONE }, // TOKEN_YIELD
    { NULL,  NULL, PREC_NONE }, // TOKEN_ERROR
    { NULL,  NULL, PREC_NONE }, // TOKEN_EOF
 };
\ No newline at end of file
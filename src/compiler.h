@@ -5,6 +5,11 @@
 #include "vm.h"
 #include "chunk.h"
 
-bool compile(const char *source, VM *vm, Chunk *chunk);
+#include "scanner.h"
+
+// compiles [length] bytes of [source]
+bool compile(const char *source, size_t length, VM *vm, Chunk *chunk);
+// compiles what [reader] returns while it is still arriving
+bool compile_stream(SourceReader *reader, VM *vm, Chunk *chunk);
 
 #endif
\ No newline at end of file
@@ -1,84 +1,158 @@
-#include <stdio.h>
-
 #include "common.h"
 #include "debug.h"
+#include "native.h"
 #include "value.h"
 
-static void print_line_info(Chunk *chunk, int offset);
+static void print_line_info(Output *out, Chunk *chunk, int offset);
+
+static int simple_instruction(Output *out, const char *instruction, int offset);
+static int constant_instruction(Output *out, const char *instruction, Chunk *chunk, int offset);
+static int byte_instruction(Output *out, const char *instruction, Chunk *chunk, int offset);
+static int native_instruction(Output *out, const char *instruction, Chunk *chunk, int offset);
+static int spawn_instruction(Output *out, const char *instruction, Chunk *chunk, int offset);
 
-static int simple_instruction(const char *instruction, int offset);
-static int constant_instruction(const char *instruction, Chunk *chunk, int offset);
+static const char *opcode_names[] = {
+   [OP_CONSTANT] = "OP_CONSTANT",
+   [OP_NIL] = "OP_NIL",
+   [OP_TRUE] = "OP_TRUE",
+   [OP_FALSE] = "OP_FALSE",
+   [OP_EQUAL] = "OP_EQUAL",
+   [OP_GREATER] = "OP_GREATER",
+   [OP_LESS] = "OP_LESS",
+   [OP_ADD] = "OP_ADD",
+   [OP_SUBTRACT] = "OP_SUBTRACT",
+   [OP_MULTIPLY] = "OP_MULTIPLY",
+   [OP_DIVIDE] = "OP_DIVIDE",
+   [OP_NOT] = "OP_NOT",
+   [OP_NEGATE] = "OP_NEGATE",
+   [OP_POP] = "OP_POP",
+   [OP_BUILD_LIST] = "OP_BUILD_LIST",
+   [OP_BUILD_MAP] = "OP_BUILD_MAP",
+   [OP_GET_INDEX] = "OP_GET_INDEX",
+   [OP_SET_INDEX] = "OP_SET_INDEX",
+   [OP_CALL_NATIVE] = "OP_CALL_NATIVE",
+   [OP_PRINT] = "OP_PRINT",
+   [OP_SPAWN] = "OP_SPAWN",
+   [OP_YIELD] = "OP_YIELD",
+   [OP_END_FIBER] = "OP_END_FIBER",
+   [OP_RETURN] = "OP_RETURN",
+};
+
+const char* opcode_name(uint8_t opcode) {
+   if (opcode > OP_RETURN || opcode_names[opcode] == NULL) return "OP_UNKNOWN";
+   return opcode_names[opcode];
+}
 
-void disassemble_chunk(Chunk *chunk, const char *name) {
-   printf(">>> %s <<<\n", name);
+void disassemble_chunk(Output *out, Chunk *chunk, const char *name) {
+   output_format(out, ">>> %s <<<\n", name);
    for (int offset = 0; offset < chunk->count;) {
-      offset = disassemble_instruction(chunk, offset);
+      offset = disassemble_instruction(out, chunk, offset);
    }
 }
 
-int disassemble_instruction(Chunk *chunk, int offset) {
-   printf("%04d ", offset);
-   print_line_info(chunk, offset);
+int disassemble_instruction(Output *out, Chunk *chunk, int offset) {
+   output_format(out, "%04d ", offset);
+   print_line_info(out, chunk, offset);
 
    uint8_t instruction = chunk->code[offset];
    switch(instruction) {
       case OP_CONSTANT:
-         return constant_instruction("OP_CONSTANT", chunk, offset);
+         return constant_instruction(out, "OP_CONSTANT", chunk, offset);
       case OP_NIL:
-         return simple_instruction("OP_NIL", offset);
+         return simple_instruction(out, "OP_NIL", offset);
       case OP_TRUE:
-         return simple_instruction("OP_TRUE", offset);
+         return simple_instruction(out, "OP_TRUE", offset);
       case OP_FALSE:
-         return simple_instruction("OP_FALSE", offset);
+         return simple_instruction(out, "OP_FALSE", offset);
       case OP_EQUAL:
-         return simple_instruction("OP_EQUAL", offset);
+         return simple_instruction(out, "OP_EQUAL", offset);
       case OP_GREATER:
-         return simple_instruction("OP_GREATER", offset);
+         return simple_instruction(out, "OP_GREATER", offset);
       case OP_LESS:
-         return simple_instruction("OP_LESS", offset);
+         return simple_instruction(out, "OP_LESS", offset);
       case OP_ADD:
-         return simple_instruction("OP_ADD", offset);
+         return simple_instruction(out, "OP_ADD", offset);
       case OP_SUBTRACT:
-         return simple_instruction("OP_SUBTRACT", offset);
+         return simple_instruction(out, "OP_SUBTRACT", offset);
       case OP_MULTIPLY:
-         return simple_instruction("OP_MULTIPLY", offset);
+         return simple_instruction(out, "OP_MULTIPLY", offset);
       case OP_DIVIDE:
-         return simple_instruction("OP_DIVIDE", offset);
+         return simple_instruction(out, "OP_DIVIDE", offset);
       case OP_NOT:
-         return simple_instruction("OP_NOT", offset);
+         return simple_instruction(out, "OP_NOT", offset);
       case OP_NEGATE:
-         return simple_instruction("OP_NEGATE", offset);
+         return simple_instruction(out, "OP_NEGATE", offset);
       case OP_POP:
-         return simple_instruction("OP_POP", offset);
+         return simple_instruction(out, "OP_POP", offset);
+      case OP_BUILD_LIST:
+         return byte_instruction(out, "OP_BUILD_LIST", chunk, offset);
+      case OP_BUILD_MAP:
+         return byte_instruction(out, "OP_BUILD_MAP", chunk, offset);
+      case OP_GET_INDEX:
+         return simple_instruction(out, "OP_GET_INDEX", offset);
+      case OP_SET_INDEX:
+         return simple_instruction(out, "OP_SET_INDEX", offset);
+      case OP_CALL_NATIVE:
+         return native_instruction(out, "OP_CALL_NATIVE", chunk, offset);
       case OP_PRINT:
-         return simple_instruction("OP_PRINT", offset);
+         return simple_instruction(out, "OP_PRINT", offset);
+      case OP_SPAWN:
+         return spawn_instruction(out, "OP_SPAWN", chunk, offset);
+      case OP_YIELD:
+         return simple_instruction(out, "OP_YIELD", offset);
+      case OP_END_FIBER:
+         return simple_instruction(out, "OP_END_FIBER", offset);
       case OP_RETURN:
-         return simple_instruction("OP_RETURN", offset);
+         return simple_instruction(out, "OP_RETURN", offset);
       default:
-         printf("Unknown Opcode: %d\n", instruction);
+         output_format(out, "Unknown Opcode: %d\n", instruction);
          return offset + 1;
    }
 }
 
-static void print_line_info(Chunk *chunk, int offset) {
+static void print_line_info(Output *out, Chunk *chunk, int offset) {
    if (offset > 0 && chunk->lines[offset] == chunk->lines[offset - 1]) {
-      printf("   | ");
+      output_format(out, "   | ");
    } else {
-      printf("%4d ", chunk->lines[offset]);
+      output_format(out, "%4d ", chunk->lines[offset]);
    }
 }
 
-static int simple_instruction(const char *instruction, int offset) {
-   printf("%s\n", instruction);
+static int simple_instruction(Output *out, const char *instruction, int offset) {
+   output_format(out, "%s\n", instruction);
    return offset + 1;
 }
 
-static int constant_instruction(const char *instruction, Chunk *chunk, int offset) {
+static int constant_instruction(Output *out, const char *instruction, Chunk *chunk, int offset) {
    uint8_t constant_index = chunk->code[offset + 1];
 
-   printf("%-16s %4d '", instruction, constant_index);
-   print_value(chunk->constants.values[constant_index]);
-   printf("'\n");
+   output_format(out, "%-16s %4d '", instruction, constant_index);
+   write_value(out, chunk->constants.values[constant_index]);
+   output_format(out, "'\n");
 
    return offset + 2;
+}
+
+static int byte_instruction(Output *out, const char *instruction, Chunk *chunk, int offset) {
+   output_format(out, "%-16s %4d\n", instruction, chunk->code[offset + 1]);
+   return offset + 2;
+}
+
+static int native_instruction(Output *out, const char *instruction, Chunk *chunk, int offset) {
+   uint8_t native_index = chunk->code[offset + 1];
+   uint8_t arg_count = chunk->code[offset + 2];
+
+   output_format(out, "%-16s %4d '%s' (%d args)\n", instruction, native_index,
+      natives[native_index].name, arg_count);
+
+   return offset + 3;
+}
+
+static int spawn_instruction(Output *out, const char *instruction, Chunk *chunk, int offset) {
+   uint8_t stack_size = chunk->code[offset + 1];
+   uint16_t jump = (uint16_t)(chunk->code[offset + 2] << 8 | chunk->code[offset + 3]);
+
+   output_format(out, "%-16s %4d -> %d\n", instruction, stack_size, offset + 4 + jump);
+
+   return offset + 4;
 }
\ No newline at end of file
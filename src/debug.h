@@ -2,8 +2,10 @@
 #define KI_DEBUG_H
 
 #include "chunk.h"
+#include "output.h"
 
-void disassemble_chunk(Chunk *chunk, const char *name);
-int disassemble_instruction(Chunk *chunk, int offset);
+void disassemble_chunk(Output *out, Chunk *chunk, const char *name);
+int disassemble_instruction(Output *out, Chunk *chunk, int offset);
+const char* opcode_name(uint8_t opcode);
 
 #endif
\ No newline at end of file
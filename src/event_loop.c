@@ -0,0 +1,140 @@
+#include <errno.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include "event_loop.h"
+#include "memory.h"
+
+#define MAX_EVENTS 64
+
+static bool update_interest(EventLoop *loop, int fd);
+
+void init_event_loop(EventLoop *loop) {
+   loop->epoll_fd = -1;
+   loop->waiting = 0;
+   loop->fds = NULL;
+   loop->fd_capacity = 0;
+}
+
+void free_event_loop(EventLoop *loop) {
+   if (loop->epoll_fd >= 0) close(loop->epoll_fd);
+   FREE_ARRAY(loop->fds, FdWaiters, loop->fd_capacity);
+   init_event_loop(loop);
+}
+
+bool event_loop_wait(EventLoop *loop, int fd, bool writing, Fiber *fiber) {
+   if (fd < 0) return false;
+
+   if (loop->epoll_fd < 0) {
+      loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      if (loop->epoll_fd < 0) return false;
+   }
+
+   if (fd >= loop->fd_capacity) {
+      int old_capacity = loop->fd_capacity;
+      int capacity = GROW_CAPACITY(old_capacity);
+      while (capacity <= fd) capacity = GROW_CAPACITY(capacity);
+      loop->fds = GROW_ARRAY(loop->fds, FdWaiters, old_capacity, capacity);
+      for (int i = old_capacity; i < capacity; ++i) {
+         loop->fds[i].reader = NULL;
+         loop->fds[i].writer = NULL;
+      }
+      loop->fd_capacity = capacity;
+   }
+
+   Fiber **slot = writing ? &loop->fds[fd].writer : &loop->fds[fd].reader;
+   if (*slot != NULL) return false;
+
+   *slot = fiber;
+   if (!update_interest(loop, fd)) {
+      *slot = NULL;
+      return false;
+   }
+
+   ++loop->waiting;
+   return true;
+}
+
+Fiber* event_loop_poll(EventLoop *loop, int timeout) {
+   if (loop->waiting == 0) return NULL;
+
+   struct epoll_event events[MAX_EVENTS];
+   int count = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout);
+   // EINTR included, the caller asks again if it has to
+   if (count <= 0) return NULL;
+
+   Fiber *ready = NULL;
+   for (int i = 0; i < count; ++i) {
+      int fd = events[i].data.fd;
+      FdWaiters *waiters = &loop->fds[fd];
+      // errors and hang ups wake both sides, the retried call reports them
+      bool failed = events[i].events & (EPOLLERR | EPOLLHUP);
+
+      if (waiters->reader != NULL && (failed || events[i].events & EPOLLIN)) {
+         waiters->reader->next = ready;
+         ready = waiters->reader;
+         waiters->reader = NULL;
+         --loop->waiting;
+      }
+      if (waiters->writer != NULL && (failed || events[i].events & EPOLLOUT)) {
+         waiters->writer->next = ready;
+         ready = waiters->writer;
+         waiters->writer = NULL;
+         --loop->waiting;
+      }
+
+      update_interest(loop, fd);
+   }
+
+   return ready;
+}
+
+bool event_loop_forget(EventLoop *loop, int fd) {
+   if (loop->epoll_fd < 0 || fd < 0 || fd >= loop->fd_capacity) return true;
+   if (loop->fds[fd].reader != NULL || loop->fds[fd].writer != NULL) return false;
+
+   epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+   return true;
+}
+
+Fiber* event_loop_clear(EventLoop *loop) {
+   Fiber *parked = NULL;
+   for (int fd = 0; loop->waiting > 0 && fd < loop->fd_capacity; ++fd) {
+      FdWaiters *waiters = &loop->fds[fd];
+      if (waiters->reader != NULL) {
+         waiters->reader->next = parked;
+         parked = waiters->reader;
+         waiters->reader = NULL;
+         --loop->waiting;
+      }
+      if (waiters->writer != NULL) {
+         waiters->writer->next = parked;
+         parked = waiters->writer;
+         waiters->writer = NULL;
+         --loop->waiting;
+      }
+      epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+   }
+   return parked;
+}
+
+// tells epoll which directions of [fd] still have a fiber waiting
+static bool update_interest(EventLoop *loop, int fd) {
+   FdWaiters *waiters = &loop->fds[fd];
+   struct epoll_event event;
+   event.events = 0;
+   event.data.fd = fd;
+   if (waiters->reader != NULL) event.events |= EPOLLIN;
+   if (waiters->writer != NULL) event.events |= EPOLLOUT;
+
+   if (event.events == 0) {
+      // epoll reports errors and hang ups even with no events asked for,
+      // so nobody waiting means not registered at all
+      epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+      return true;
+   }
+
+   if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &event) == 0) return true;
+   if (errno != ENOENT) return false;
+   return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,41 @@
+#ifndef KI_EVENT_LOOP_H
+#define KI_EVENT_LOOP_H
+
+#include "common.h"
+#include "fiber.h"
+
+// fibers parked on a file descriptor, at most one per direction
+typedef struct {
+   Fiber *reader;
+   Fiber *writer;
+} FdWaiters;
+
+// Parks fibers until the file descriptor they wait on is ready, backed
+// by epoll
+// The epoll instance is only created once a fiber first has to wait,
+// scripts that never block on I/O don't pay for it
+typedef struct {
+   int epoll_fd;
+   // number of parked fibers
+   int waiting;
+   // indexed by file descriptor
+   FdWaiters *fds;
+   int fd_capacity;
+} EventLoop;
+
+void init_event_loop(EventLoop *loop);
+void free_event_loop(EventLoop *loop);
+// parks [fiber] until [fd] can be read from, or written to
+// returns false if another fiber already waits for the same thing or
+// the descriptor can't be waited on
+bool event_loop_wait(EventLoop *loop, int fd, bool writing, Fiber *fiber);
+// waits up to [timeout] milliseconds, -1 for no limit, for parked fibers
+// to become ready and returns them linked through [next]
+Fiber* event_loop_poll(EventLoop *loop, int timeout);
+// stops watching [fd], must be called before closing it
+// returns false, and keeps watching, if a fiber is still parked on it
+bool event_loop_forget(EventLoop *loop, int fd);
+// unparks every fiber without waiting, returns them linked through [next]
+Fiber* event_loop_clear(EventLoop *loop);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,18 @@
+#include "fiber.h"
+#include "memory.h"
+
+Fiber* new_fiber(uint8_t *ip, int stack_size) {
+   // the stack lives right after the fiber, one allocation for both
+   Fiber *fiber = (Fiber *)reallocate(NULL, 0,
+      sizeof(Fiber) + sizeof(Value) * stack_size);
+   fiber->ip = ip;
+   fiber->stack = (Value *)(fiber + 1);
+   fiber->stack_top = fiber->stack;
+   fiber->stack_size = stack_size;
+   fiber->next = NULL;
+   return fiber;
+}
+
+void free_fiber(Fiber *fiber) {
+   reallocate(fiber, sizeof(Fiber) + sizeof(Value) * fiber->stack_size, 0);
+}
\ No newline at end of file
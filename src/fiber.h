@@ -0,0 +1,25 @@
+#ifndef KI_FIBER_H
+#define KI_FIBER_H
+
+#include "common.h"
+#include "value.h"
+
+// A lightweight thread of execution inside a vm
+// A fiber is just an instruction pointer and a value stack, switching
+// fibers is saving the vm's two registers into one and loading them
+// from another. The stack is sized by the compiler to what the fiber's
+// code needs, so a fiber costs a few dozen bytes plus its stack.
+typedef struct sFiber {
+   uint8_t *ip;
+   Value *stack;
+   Value *stack_top;
+   int stack_size;
+   // next fiber in the vm's ready queue
+   struct sFiber *next;
+} Fiber;
+
+// a fiber starting at [ip] with room for [stack_size] values
+Fiber* new_fiber(uint8_t *ip, int stack_size);
+void free_fiber(Fiber *fiber);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image.h"
+#include "intern.h"
+#include "memory.h"
+#include "object.h"
+
+#define IMAGE_MAGIC "KIIMAGE1"
+
+// what the image assumes about the build loading it
+typedef struct {
+   uint32_t pointer_size;
+   uint32_t value_size;
+   uint32_t string_size;
+   uint32_t entry_size;
+} ImageLayout;
+
+typedef struct {
+   char magic[8];
+   ImageLayout layout;
+   uint64_t size;
+   // offsets of the pointers to relocate, uint64_t each
+   uint64_t relocations;
+   uint64_t relocation_count;
+   // the base set's entries
+   uint64_t entries;
+   int32_t table_count;
+   int32_t table_capacity;
+   // the chunk's arrays
+   uint64_t code;
+   uint64_t lines;
+   uint64_t constants;
+   int32_t count;
+   int32_t constant_count;
+} ImageHeader;
+
+// an image being written, in memory
+typedef struct {
+   char *bytes;
+   size_t length;
+   size_t capacity;
+   uint64_t *relocations;
+   int relocation_count;
+   int relocation_capacity;
+   // where each base table entry's string was written, 0 for none
+   uint64_t *string_offsets;
+   Table *strings;
+} ImageWriter;
+
+static uint64_t reserve(ImageWriter *writer, size_t size);
+static uint64_t append(ImageWriter *writer, const void *data, size_t size);
+static void relocate(ImageWriter *writer, uint64_t offset, uint64_t target);
+static uint64_t string_offset(ImageWriter *writer, ObjString *string);
+static void write_strings(ImageWriter *writer, ImageHeader *header);
+static bool write_constants(ImageWriter *writer, ImageHeader *header, Chunk *chunk);
+static bool write_file(const char *path, const char *bytes, size_t length);
+static void current_layout(ImageLayout *layout);
+static bool in_bounds(uint64_t offset, int64_t count, size_t element_size, size_t size);
+static bool header_in_bounds(ImageHeader *header, size_t size);
+static bool relocate_image(char *base, size_t size, ImageHeader *header);
+static bool pointers_in_bounds(char *base, size_t size, ImageHeader *header,
+   bool *relocated);
+static bool string_in_bounds(char *base, size_t size, ObjString *string, bool *relocated);
+static bool plain_value(Value *value);
+
+bool write_image(const char *path, Chunk *chunk) {
+   ImageWriter writer;
+   writer.bytes = NULL;
+   writer.length = 0;
+   writer.capacity = 0;
+   writer.relocations = NULL;
+   writer.relocation_count = 0;
+   writer.relocation_capacity = 0;
+   writer.strings = base_string_table();
+
+   ImageHeader header;
+   memset(&header, 0, sizeof(header));
+   memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+   current_layout(&header.layout);
+   reserve(&writer, sizeof(header));
+
+   write_strings(&writer, &header);
+   header.code = append(&writer, chunk->code, chunk->count);
+   header.lines = append(&writer, chunk->lines, sizeof(int) * chunk->count);
+   header.count = chunk->count;
+   bool written = write_constants(&writer, &header, chunk);
+
+   if (written) {
+      header.relocation_count = writer.relocation_count;
+      header.relocations = append(&writer, writer.relocations,
+         sizeof(uint64_t) * writer.relocation_count);
+      header.size = writer.length;
+      memcpy(writer.bytes, &header, sizeof(header));
+      written = write_file(path, writer.bytes, writer.length);
+   }
+
+   FREE_ARRAY(writer.string_offsets, uint64_t, writer.strings->capacity);
+   FREE_ARRAY(writer.relocations, uint64_t, writer.relocation_capacity);
+   FREE_ARRAY(writer.bytes, char, writer.capacity);
+   return written;
+}
+
+bool load_image(const char *path, Image *image) {
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   struct stat status;
+   if (fd < 0 || fstat(fd, &status) < 0) {
+      fprintf(stderr, "Could not open image \"%s\": %s\n", path, strerror(errno));
+      if (fd >= 0) close(fd);
+      return false;
+   }
+   size_t size = (size_t)status.st_size;
+   ImageHeader header;
+   ImageLayout layout;
+   current_layout(&layout);
+   if (size < sizeof(header) || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+      || memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) != 0
+      || memcmp(&header.layout, &layout, sizeof(layout)) != 0
+      || header.size != size)
+   {
+      fprintf(stderr, "\"%s\" isn't an image this build can load\n", path);
+      close(fd);
+      return false;
+   }
+   if (!header_in_bounds(&header, size)) {
+      fprintf(stderr, "\"%s\" is damaged\n", path);
+      close(fd);
+      return false;
+   }
+
+   // private, the relocations don't go back to the file
+   char *base = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (base == MAP_FAILED) {
+      fprintf(stderr, "Could not map image \"%s\": %s\n", path, strerror(errno));
+      return false;
+   }
+
+   if (!relocate_image(base, size, &header)) {
+      fprintf(stderr, "\"%s\" is damaged\n", path);
+      munmap(base, size);
+      return false;
+   }
+   mprotect(base, size, PROT_READ);
+
+   image->memory = base;
+   image->size = size;
+   image->strings.count = header.table_count;
+   image->strings.capacity = header.table_capacity;
+   image->strings.entries = (Entry *)(base + header.entries);
+   image->chunk.count = header.count;
+   image->chunk.capacity = header.count;
+   image->chunk.code = (uint8_t *)(base + header.code);
+   image->chunk.lines = (int *)(base + header.lines);
+   image->chunk.constants.count = header.constant_count;
+   image->chunk.constants.capacity = header.constant_count;
+   image->chunk.constants.values = (Value *)(base + header.constants);
+   return true;
+}
+
+void free_image(Image *image) {
+   munmap(image->memory, image->size);
+   image->memory = NULL;
+   image->size = 0;
+}
+
+// room for [size] bytes, 8 byte aligned, at the returned offset
+static uint64_t reserve(ImageWriter *writer, size_t size) {
+   size_t offset = (writer->length + 7) & ~(size_t)7;
+   if (offset + size > writer->capacity) {
+      size_t old_capacity = writer->capacity;
+      size_t capacity = GROW_CAPACITY(old_capacity);
+      while (capacity < offset + size) capacity = GROW_CAPACITY(capacity);
+      writer->bytes = GROW_ARRAY(writer->bytes, char, old_capacity, capacity);
+      writer->capacity = capacity;
+   }
+   memset(writer->bytes + writer->length, 0, offset + size - writer->length);
+   writer->length = offset + size;
+   return offset;
+}
+
+static uint64_t append(ImageWriter *writer, const void *data, size_t size) {
+   uint64_t offset = reserve(writer, size);
+   if (size > 0) memcpy(writer->bytes + offset, data, size);
+   return offset;
+}
+
+// makes the pointer at [offset] point at [target] once loaded
+static void relocate(ImageWriter *writer, uint64_t offset, uint64_t target) {
+   memcpy(writer->bytes + offset, &(uintptr_t) { target }, sizeof(uintptr_t));
+   if (writer->relocation_count == writer->relocation_capacity) {
+      int old_capacity = writer->relocation_capacity;
+      writer->relocation_capacity = GROW_CAPACITY(old_capacity);
+      writer->relocations = GROW_ARRAY(writer->relocations, uint64_t,
+         old_capacity, writer->relocation_capacity);
+   }
+   writer->relocations[writer->relocation_count++] = offset;
+}
+
+// every string, then the table's entries pointing at them
+static void write_strings(ImageWriter *writer, ImageHeader *header) {
+   Table *strings = writer->strings;
+   writer->string_offsets = ALLOCATE(uint64_t, strings->capacity);
+   for (int i = 0; i < strings->capacity; ++i) {
+      writer->string_offsets[i] = 0;
+      ObjString *string = strings->entries[i].key;
+      if (string == NULL) continue;
+
+      ObjString copy = *string;
+      copy.obj.next = NULL;
+      copy.shared = NULL;
+      uint64_t offset = append(writer, &copy, sizeof(copy));
+      uint64_t chars = append(writer, string->chars, string->length + 1);
+      relocate(writer, offset + offsetof(ObjString, chars), chars);
+      writer->string_offsets[i] = offset;
+   }
+
+   header->table_count = strings->count;
+   header->table_capacity = strings->capacity;
+   header->entries = append(writer, strings->entries, sizeof(Entry) * strings->capacity);
+   for (int i = 0; i < strings->capacity; ++i) {
+      if (writer->string_offsets[i] == 0) continue;
+      relocate(writer, header->entries + sizeof(Entry) * i + offsetof(Entry, key),
+         writer->string_offsets[i]);
+   }
+}
+
+// where [string] was written, 0 if it isn't a base string
+static uint64_t string_offset(ImageWriter *writer, ObjString *string) {
+   for (int i = 0; i < writer->strings->capacity; ++i) {
+      if (writer->strings->entries[i].key == string) return writer->string_offsets[i];
+   }
+   return 0;
+}
+
+static bool write_constants(ImageWriter *writer, ImageHeader *header, Chunk *chunk) {
+   ValueArray *constants = &chunk->constants;
+   header->constant_count = constants->count;
+   header->constants = append(writer, constants->values, sizeof(Value) * constants->count);
+   for (int i = 0; i < constants->count; ++i) {
+      Value value = constants->values[i];
+      if (!IS_OBJ(value)) continue;
+
+      uint64_t offset = IS_STRING(value) ? string_offset(writer, AS_STRING(value)) : 0;
+      if (offset == 0) {
+         fprintf(stderr, "Constant %d isn't a base string and can't be written\n", i);
+         return false;
+      }
+      relocate(writer, header->constants + sizeof(Value) * i + offsetof(Value, as.obj),
+         offset);
+   }
+   return true;
+}
+
+static bool write_file(const char *path, const char *bytes, size_t length) {
+   FILE *file = fopen(path, "wb");
+   if (file == NULL) {
+      fprintf(stderr, "Could not open file \"%s\"\n", path);
+      return false;
+   }
+   bool written = fwrite(bytes, 1, length, file) == length;
+   if (fclose(file) != 0) written = false;
+   if (!written) fprintf(stderr, "Could not write file \"%s\"\n", path);
+   return written;
+}
+
+// whether [count] elements of [element_size] at [offset] are aligned and inside the image
+static bool in_bounds(uint64_t offset, int64_t count, size_t element_size, size_t size) {
+   if (count < 0 || offset % 8 != 0 || offset > size) return false;
+   return (uint64_t)count <= (size - offset) / element_size;
+}
+
+// every array the header points at, so a damaged image is rejected before it's used
+static bool header_in_bounds(ImageHeader *header, size_t size) {
+   if (header->relocation_count > INT64_MAX) return false;
+   int32_t capacity = header->table_capacity;
+   // probing stops at an empty slot, so a full table would never end
+   bool table = header->table_count >= 0 && header->table_count < capacity;
+   return table
+      && in_bounds(header->relocations, (int64_t)header->relocation_count, sizeof(uint64_t), size)
+      && in_bounds(header->entries, capacity, sizeof(Entry), size)
+      && in_bounds(header->code, header->count, sizeof(uint8_t), size)
+      && in_bounds(header->lines, header->count, sizeof(int), size)
+      && in_bounds(header->constants, header->constant_count, sizeof(Value), size);
+}
+
+// turns the offsets the relocations list into pointers into [base]
+// a truncated or damaged image mustn't make it write past the end, nor
+// leave the strings and constants with a pointer that doesn't point at a
+// whole string in the image. The bytecode itself isn't checked.
+static bool relocate_image(char *base, size_t size, ImageHeader *header) {
+   // which pointer sized slots were relocated, so none is twice and the
+   // ones that should have been can be told apart
+   bool *relocated = ALLOCATE(bool, size / sizeof(uintptr_t));
+   memset(relocated, 0, size / sizeof(uintptr_t));
+   uint64_t *relocations = (uint64_t *)(base + header->relocations);
+   bool valid = true;
+   for (uint64_t i = 0; valid && i < header->relocation_count; ++i) {
+      uint64_t offset = relocations[i];
+      valid = in_bounds(offset, 1, sizeof(uintptr_t), size)
+         && !relocated[offset / sizeof(uintptr_t)];
+      if (!valid) break;
+      uintptr_t *slot = (uintptr_t *)(base + offset);
+      // every target is something written whole, so aligned
+      valid = in_bounds(*slot, 1, 1, size);
+      if (!valid) break;
+      *slot += (uintptr_t)base;
+      relocated[offset / sizeof(uintptr_t)] = true;
+   }
+   valid = valid && pointers_in_bounds(base, size, header, relocated);
+   FREE_ARRAY(relocated, bool, size / sizeof(uintptr_t));
+   return valid;
+}
+
+static bool pointers_in_bounds(char *base, size_t size, ImageHeader *header,
+   bool *relocated)
+{
+   int empty = 0;
+   for (int i = 0; i < header->table_capacity; ++i) {
+      uint64_t offset = header->entries + sizeof(Entry) * i;
+      Entry *entry = (Entry *)(base + offset);
+      if (!plain_value(&entry->value)) return false;
+      if (relocated[(offset + offsetof(Entry, key)) / sizeof(uintptr_t)]) {
+         if (!string_in_bounds(base, size, entry->key, relocated)) return false;
+      } else if (entry->key != NULL) {
+         return false;
+      } else if (IS_NIL(entry->value)) {
+         ++empty;
+      }
+   }
+   // probing stops at an empty entry
+   if (empty == 0) return false;
+
+   for (int i = 0; i < header->constant_count; ++i) {
+      uint64_t offset = header->constants + sizeof(Value) * i;
+      Value *value = (Value *)(base + offset);
+      if (value->type != VAL_OBJ) {
+         if (!plain_value(value)) return false;
+         continue;
+      }
+      // only strings are written as constants
+      if (!relocated[(offset + offsetof(Value, as.obj)) / sizeof(uintptr_t)]
+         || !string_in_bounds(base, size, (ObjString *)value->as.obj, relocated))
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+// whether [string] is a whole frozen string in the image, its characters
+// too, and points at nothing outside it
+static bool string_in_bounds(char *base, size_t size, ObjString *string, bool *relocated) {
+   uint64_t offset = (uint64_t)((char *)string - base);
+   if (!in_bounds(offset, 1, sizeof(ObjString), size)) return false;
+   uint8_t frozen;
+   memcpy(&frozen, &string->obj.is_frozen, sizeof(frozen));
+   if (string->obj.type != OBJ_STRING || frozen != 1 || string->obj.next != NULL
+      || string->shared != NULL)
+   {
+      return false;
+   }
+
+   if (!relocated[(offset + offsetof(ObjString, chars)) / sizeof(uintptr_t)]) return false;
+   uint64_t chars = (uint64_t)(string->chars - base);
+   return string->length >= 0 && (uint64_t)string->length < size - chars
+      && string->chars[string->length] == '\0';
+}
+
+// whether [value] is one that holds no pointer, a bool holding 0 or 1
+static bool plain_value(Value *value) {
+   switch (value->type) {
+      case VAL_BOOL: {
+         uint8_t boolean;
+         memcpy(&boolean, &value->as.boolean, sizeof(boolean));
+         return boolean <= 1;
+      }
+      case VAL_NIL:
+      case VAL_NUMBER:
+      case VAL_INT:
+         return true;
+      default:
+         return false;
+   }
+}
+
+static void current_layout(ImageLayout *layout) {
+   memset(layout, 0, sizeof(*layout));
+   layout->pointer_size = sizeof(void *);
+   layout->value_size = sizeof(Value);
+   layout->string_size = sizeof(ObjString);
+   layout->entry_size = sizeof(Entry);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef KI_IMAGE_H
+#define KI_IMAGE_H
+
+#include "common.h"
+#include "chunk.h"
+#include "table.h"
+
+// A snapshot of everything a script needs before it runs: the base
+// intern set and the script compiled against it
+//
+// The image is laid out the way the structs are in memory, with image
+// offsets where the pointers go and a list of where those are. Loading
+// maps the file copy on write, adds the address it landed at to each of
+// them and makes it read only, with nothing read, interned or compiled.
+// An image only loads into a build with the same struct layout.
+typedef struct {
+   void *memory;
+   size_t size;
+   // both point into [memory]
+   Table strings;
+   Chunk chunk;
+} Image;
+
+// writes the base intern set, which must be frozen, and [chunk], whose
+// string constants must all be base strings
+// returns false, after reporting why, if it can't
+bool write_image(const char *path, Chunk *chunk);
+// returns false, after reporting why, if [path] isn't an image this build
+// can load
+bool load_image(const char *path, Image *image);
+// only valid once nothing uses the image's strings or chunk anymore
+void free_image(Image *image);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "intern.h"
+#include "memory.h"
+#include "scanner.h"
+#include "table.h"
+
+static Table base_strings;
+static Obj *base_objects = NULL;
+// set when the table is the caller's, see use_base_strings()
+static bool base_borrowed = false;
+// the set is only read after this is set, which also publishes it to
+// other threads
+static atomic_bool frozen = false;
+
+ObjString* add_base_string(const char *chars, int length) {
+   uint32_t hash = hash_string(chars, length);
+   ObjString *interned = table_find_string(&base_strings, chars, length, hash);
+   if (interned != NULL) return interned;
+
+   char *heap_chars = ALLOCATE(char, length + 1);
+   memcpy(heap_chars, chars, length);
+   heap_chars[length] = '\0';
+
+   ObjString *string = ALLOCATE(ObjString, 1);
+   string->obj.type = OBJ_STRING;
+   string->obj.is_frozen = true;
+   string->obj.next = base_objects;
+   base_objects = (Obj *)string;
+   string->length = length;
+   string->chars = heap_chars;
+   string->hash = hash;
+   string->shared = NULL;
+
+   table_set(&base_strings, string, NIL_VAL);
+   return string;
+}
+
+void add_base_strings_from_source(const char *source, size_t length) {
+   Scanner scanner;
+   init_scanner(&scanner, source, length);
+
+   for (;;) {
+      Token token = scan_token(&scanner);
+      if (token.type == TOKEN_EOF) break;
+
+      if (token.type == TOKEN_IDENTIFIER) {
+         add_base_string(token.start, token.length);
+      } else if (token.type == TOKEN_STRING) {
+         // without the quotes, the way the compiler interns literals
+         add_base_string(token.start + 1, token.length - 2);
+      }
+   }
+}
+
+void freeze_base_strings() {
+   atomic_store_explicit(&frozen, true, memory_order_release);
+}
+
+ObjString* find_base_string(const char *chars, int length, uint32_t hash) {
+   if (!atomic_load_explicit(&frozen, memory_order_acquire)) return NULL;
+   return table_find_string(&base_strings, chars, length, hash);
+}
+
+void free_base_strings() {
+   atomic_store(&frozen, false);
+   if (base_borrowed) {
+      init_table(&base_strings);
+      base_borrowed = false;
+   } else {
+      free_table(&base_strings);
+   }
+   free_objects(base_objects);
+   base_objects = NULL;
+}
+
+Table* base_string_table() {
+   return &base_strings;
+}
+
+void use_base_strings(Table *strings) {
+   free_base_strings();
+   base_strings = *strings;
+   base_borrowed = true;
+   freeze_base_strings();
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#ifndef KI_INTERN_H
+#define KI_INTERN_H
+
+#include "common.h"
+#include "object.h"
+#include "table.h"
+
+// The base intern set, a process wide set of frozen strings every vm
+// looks in before its own [strings] table
+//
+// It is filled once, then frozen, and never changes afterwards, so vms
+// on any thread read it without locking. It must be frozen before any
+// vm interns a string, otherwise a vm could hold a private copy of a
+// base string and lose pointer equality between the two.
+
+// adds a string to the base set, only valid before it is frozen
+ObjString* add_base_string(const char *chars, int length);
+// adds every identifier and string literal of [length] bytes of [source]
+void add_base_strings_from_source(const char *source, size_t length);
+// publishes the base set, lookups before this find nothing
+void freeze_base_strings();
+// the base string with these characters, or NULL
+ObjString* find_base_string(const char *chars, int length, uint32_t hash);
+// only valid once no vm uses the base set anymore
+void free_base_strings();
+// the base set's table, for writing it out once frozen
+Table* base_string_table();
+// makes [strings] the base set and freezes it, instead of filling it
+// the table and its strings stay the caller's, see image.h
+void use_base_strings(Table *strings);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,248 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "io.h"
+#include "memory.h"
+#include "object.h"
+
+static NativeResult block_on(VM *vm, int fd, bool writing);
+static bool is_ready(int fd, bool writing);
+static bool fd_argument(VM *vm, Value value, int *fd);
+static bool address_arguments(VM *vm, Value *args, struct sockaddr_in *address);
+static NativeResult io_error(VM *vm, const char *operation);
+
+NativeResult open_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!IS_TEXT(args[0]) || !IS_TEXT(args[1])) {
+      runtime_error(vm, "Expected a path and a mode");
+      return NATIVE_ERROR;
+   }
+
+   // the system wants terminated strings
+   const char *path = text_string(vm, args[0])->chars;
+   const char *mode = text_string(vm, args[1])->chars;
+   int flags = O_NONBLOCK | O_CLOEXEC;
+   if (strcmp(mode, "r") == 0) {
+      flags |= O_RDONLY;
+   } else if (strcmp(mode, "w") == 0) {
+      flags |= O_WRONLY | O_CREAT | O_TRUNC;
+   } else if (strcmp(mode, "a") == 0) {
+      flags |= O_WRONLY | O_CREAT | O_APPEND;
+   } else {
+      runtime_error(vm, "Mode must be \"r\", \"w\" or \"a\"");
+      return NATIVE_ERROR;
+   }
+
+   int fd = open(path, flags, 0644);
+   if (fd < 0) return io_error(vm, "open");
+
+   *result = INT_VAL(fd);
+   return NATIVE_OK;
+}
+
+NativeResult read_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int fd;
+   int max;
+   if (!fd_argument(vm, args[0], &fd) || !int_argument(vm, args[1], &max)) {
+      return NATIVE_ERROR;
+   }
+   if (max <= 0) {
+      runtime_error(vm, "Can only read a positive number of bytes");
+      return NATIVE_ERROR;
+   }
+
+   if (!is_ready(fd, false)) return block_on(vm, fd, false);
+
+   char *buffer = TRY_ALLOCATE(char, max);
+   if (buffer == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   ssize_t count = read(fd, buffer, max);
+   if (count > 0) *result = OBJ_VAL(copy_string(vm, buffer, (int)count));
+   FREE_ARRAY(buffer, char, max);
+
+   if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return block_on(vm, fd, false);
+   }
+   if (count < 0) return io_error(vm, "read");
+   if (count == 0) *result = NIL_VAL;
+   return NATIVE_OK;
+}
+
+NativeResult write_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int fd;
+   if (!fd_argument(vm, args[0], &fd)) return NATIVE_ERROR;
+   if (!IS_TEXT(args[1])) {
+      runtime_error(vm, "Can only write strings");
+      return NATIVE_ERROR;
+   }
+
+   if (!is_ready(fd, true)) return block_on(vm, fd, true);
+
+   // keeps what was printed before the write ahead of it, [fd] may well
+   // be standard output
+   flush_output(&vm->output);
+   ssize_t count = write(fd, text_chars(args[1]), text_length(args[1]));
+   if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return block_on(vm, fd, true);
+   }
+   if (count < 0) return io_error(vm, "write");
+
+   *result = INT_VAL(count);
+   return NATIVE_OK;
+}
+
+NativeResult close_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int fd;
+   if (!fd_argument(vm, args[0], &fd)) return NATIVE_ERROR;
+
+   if (!event_loop_forget(&vm->events, fd)) {
+      runtime_error(vm, "Can't close %d while another fiber waits on it", fd);
+      return NATIVE_ERROR;
+   }
+   if (close(fd) < 0) return io_error(vm, "close");
+
+   *result = NIL_VAL;
+   return NATIVE_OK;
+}
+
+NativeResult listen_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   struct sockaddr_in address;
+   if (!address_arguments(vm, args, &address)) return NATIVE_ERROR;
+
+   int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (fd < 0) return io_error(vm, "listen");
+
+   int reuse = 1;
+   setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+   if (bind(fd, (struct sockaddr *)&address, sizeof(address)) < 0
+   || listen(fd, SOMAXCONN) < 0)
+   {
+   close(fd);
+   return io_error(vm, "listen");
+   }
+
+   *result = INT_VAL(fd);
+   return NATIVE_OK;
+}
+
+NativeResult accept_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int fd;
+   if (!fd_argument(vm, args[0], &fd)) return NATIVE_ERROR;
+
+   int connection = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+   if (connection < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return block_on(vm, fd, false);
+   }
+   if (connection < 0) return io_error(vm, "accept");
+
+   *result = INT_VAL(connection);
+   return NATIVE_OK;
+}
+
+NativeResult connect_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   struct sockaddr_in address;
+   if (!address_arguments(vm, args, &address)) return NATIVE_ERROR;
+
+   int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if (fd < 0) return io_error(vm, "connect");
+
+   // a retried call would connect again, so rather than waiting here the
+   // connection is left to complete in the background
+   if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0
+   && errno != EINPROGRESS)
+   {
+   close(fd);
+   return io_error(vm, "connect");
+   }
+
+   *result = INT_VAL(fd);
+   return NATIVE_OK;
+}
+
+NativeResult pipe_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   (void)args;
+   int fds[2];
+   if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) return io_error(vm, "pipe");
+
+   ObjList *ends = new_list(vm, 2);
+   if (ends == NULL) {
+      close(fds[0]);
+      close(fds[1]);
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   ends->items.values[0] = INT_VAL(fds[0]);
+   ends->items.values[1] = INT_VAL(fds[1]);
+   ends->items.count = 2;
+
+   *result = OBJ_VAL(ends);
+   return NATIVE_OK;
+}
+
+static NativeResult block_on(VM *vm, int fd, bool writing) {
+   if (!wait_for_fd(vm, fd, writing)) return NATIVE_ERROR;
+   return NATIVE_BLOCK;
+}
+
+// descriptors the script didn't open, like stdin, may be in blocking
+// mode, they are only used once poll says they won't block
+static bool is_ready(int fd, bool writing) {
+   int flags = fcntl(fd, F_GETFL);
+   if (flags < 0 || flags & O_NONBLOCK) return true;
+
+   struct pollfd poll_fd = { fd, writing ? POLLOUT : POLLIN, 0 };
+   return poll(&poll_fd, 1, 0) != 0;
+}
+
+static bool fd_argument(VM *vm, Value value, int *fd) {
+   if (!int_argument(vm, value, fd)) return false;
+   if (*fd >= 0) return true;
+
+   runtime_error(vm, "Expected a file descriptor");
+   return false;
+}
+
+static bool address_arguments(VM *vm, Value *args, struct sockaddr_in *address) {
+   int port;
+   if (!IS_TEXT(args[0]) || !int_argument(vm, args[1], &port)) {
+      runtime_error(vm, "Expected a host and a port");
+      return false;
+   }
+
+   const char *host = text_string(vm, args[0])->chars;
+   if (strcmp(host, "localhost") == 0) host = "127.0.0.1";
+
+   memset(address, 0, sizeof(*address));
+   address->sin_family = AF_INET;
+   address->sin_port = htons((uint16_t)port);
+   if (port < 0 || port > UINT16_MAX || inet_pton(AF_INET, host, &address->sin_addr) != 1) {
+      runtime_error(vm, "Invalid address %.*s:%d", text_length(args[0]),
+         text_chars(args[0]), port);
+      return false;
+   }
+   return true;
+}
+
+static NativeResult io_error(VM *vm, const char *operation) {
+   runtime_error(vm, "Could not %s: %s", operation, strerror(errno));
+   return NATIVE_ERROR;
+}
\ No newline at end of file
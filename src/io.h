@@ -0,0 +1,30 @@
+#ifndef KI_IO_H
+#define KI_IO_H
+
+#include "native.h"
+
+// Non blocking I/O natives
+// File descriptors are plain numbers. When an operation would block, the
+// calling fiber is parked on the vm's event loop and the call is retried
+// once the descriptor is ready, while the vm runs its other fibers.
+
+// open(path, mode), mode is "r", "w" or "a"
+NativeResult open_native(VM *vm, int arg_count, Value *args, Value *result);
+// read(fd, max), returns at most [max] bytes, or nil at end of file
+NativeResult read_native(VM *vm, int arg_count, Value *args, Value *result);
+// write(fd, string), returns the number of bytes written
+NativeResult write_native(VM *vm, int arg_count, Value *args, Value *result);
+// close(fd)
+NativeResult close_native(VM *vm, int arg_count, Value *args, Value *result);
+// listen(host, port), returns a listening tcp socket
+NativeResult listen_native(VM *vm, int arg_count, Value *args, Value *result);
+// accept(fd), returns the socket of the next connection
+NativeResult accept_native(VM *vm, int arg_count, Value *args, Value *result);
+// connect(host, port), returns a tcp socket
+// the connection completes in the background, the first read or write
+// waits for it
+NativeResult connect_native(VM *vm, int arg_count, Value *args, Value *result);
+// pipe(), returns [read end, write end]
+NativeResult pipe_native(VM *vm, int arg_count, Value *args, Value *result);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "list.h"
+#include "memory.h"
+#include "object.h"
+
+// what a list holds, decides which loop a bulk operation takes
+typedef enum {
+   ELEMENTS_INTS,
+   // numbers only, no ints
+   ELEMENTS_DOUBLES,
+   // ints and numbers
+   ELEMENTS_NUMERIC,
+   ELEMENTS_STRINGS,
+   ELEMENTS_OTHER
+} ElementKind;
+
+static bool check_list(VM *vm, Value value);
+static ElementKind classify(ValueArray *items);
+static double sum_doubles(const Value *values, int count);
+static Value extreme(ValueArray *items, ElementKind kind, bool want_max);
+static void sort_ints(int64_t *items, int count);
+static void sort_doubles(double *items, int count);
+static bool is_nan(Value value);
+static int compare_numeric(const void *a, const void *b);
+static int compare_strings(const void *a, const void *b);
+
+NativeResult len_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (IS_LIST(args[0])) {
+      *result = INT_VAL(AS_LIST(args[0])->items.count);
+   } else if (IS_TEXT(args[0])) {
+      *result = INT_VAL(text_length(args[0]));
+   } else if (IS_MAP(args[0])) {
+      *result = INT_VAL(AS_MAP(args[0])->table.count);
+   } else {
+      runtime_error(vm, "Can only take the length of lists, maps and strings");
+      return NATIVE_ERROR;
+   }
+   return NATIVE_OK;
+}
+
+NativeResult append_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   if (!try_write_value_array(&AS_LIST(args[0])->items, args[1])) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   *result = args[0];
+   return NATIVE_OK;
+}
+
+NativeResult sum_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   ValueArray *items = &AS_LIST(args[0])->items;
+   switch (classify(items)) {
+   case ELEMENTS_INTS: {
+      int64_t total = 0;
+      for (int i = 0; i < items->count; ++i) {
+         int64_t next;
+         if (__builtin_add_overflow(total, AS_INT(items->values[i]), &next)) {
+            // promoted like any other overflowing addition, the rest is
+            // added as numbers
+            double promoted = (double)total;
+            for (; i < items->count; ++i) promoted += AS_INT(items->values[i]);
+            *result = NUMBER_VAL(promoted);
+            return NATIVE_OK;
+         }
+         total = next;
+      }
+      *result = INT_VAL(total);
+      return NATIVE_OK;
+   }
+   case ELEMENTS_DOUBLES:
+      *result = NUMBER_VAL(sum_doubles(items->values, items->count));
+      return NATIVE_OK;
+   case ELEMENTS_NUMERIC: {
+      double total = 0;
+      for (int i = 0; i < items->count; ++i) total += AS_DOUBLE(items->values[i]);
+      *result = NUMBER_VAL(total);
+      return NATIVE_OK;
+   }
+   default:
+      runtime_error(vm, "Can only sum lists of numbers");
+      return NATIVE_ERROR;
+   }
+}
+
+NativeResult min_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   ValueArray *items = &AS_LIST(args[0])->items;
+   ElementKind kind = classify(items);
+   if (items->count == 0 || kind == ELEMENTS_STRINGS || kind == ELEMENTS_OTHER) {
+      runtime_error(vm, "Expected a non empty list of numbers");
+      return NATIVE_ERROR;
+   }
+
+   *result = extreme(items, kind, false);
+   return NATIVE_OK;
+}
+
+NativeResult max_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   ValueArray *items = &AS_LIST(args[0])->items;
+   ElementKind kind = classify(items);
+   if (items->count == 0 || kind == ELEMENTS_STRINGS || kind == ELEMENTS_OTHER) {
+      runtime_error(vm, "Expected a non empty list of numbers");
+      return NATIVE_ERROR;
+   }
+
+   *result = extreme(items, kind, true);
+   return NATIVE_OK;
+}
+
+NativeResult map_add_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   ValueArray *items = &AS_LIST(args[0])->items;
+   ElementKind kind = classify(items);
+   if (!IS_NUMERIC(args[1])
+   || kind == ELEMENTS_STRINGS || (kind == ELEMENTS_OTHER && items->count > 0))
+   {
+   runtime_error(vm, "Can only add a number to a list of numbers");
+   return NATIVE_ERROR;
+   }
+
+   ObjList *mapped = new_list(vm, items->count);
+   if (mapped == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   Value *from = items->values;
+   Value *to = mapped->items.values;
+   if (kind == ELEMENTS_DOUBLES) {
+      double addend = AS_DOUBLE(args[1]);
+      for (int i = 0; i < items->count; ++i) {
+         to[i] = NUMBER_VAL(AS_NUMBER(from[i]) + addend);
+      }
+   } else if (kind == ELEMENTS_INTS && IS_INT(args[1])) {
+      int64_t addend = AS_INT(args[1]);
+      for (int i = 0; i < items->count; ++i) {
+         int64_t sum;
+         if (__builtin_add_overflow(AS_INT(from[i]), addend, &sum)) {
+            to[i] = NUMBER_VAL((double)AS_INT(from[i]) + (double)addend);
+         } else {
+            to[i] = INT_VAL(sum);
+         }
+      }
+   } else {
+      double addend = AS_DOUBLE(args[1]);
+      for (int i = 0; i < items->count; ++i) {
+         to[i] = NUMBER_VAL(AS_DOUBLE(from[i]) + addend);
+      }
+   }
+   mapped->items.count = items->count;
+
+   *result = OBJ_VAL(mapped);
+   return NATIVE_OK;
+}
+
+NativeResult sort_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_list(vm, args[0])) return NATIVE_ERROR;
+
+   ValueArray *items = &AS_LIST(args[0])->items;
+   int count = items->count;
+   switch (classify(items)) {
+   // the keys are sorted on their own, packed, then written back
+   case ELEMENTS_INTS: {
+      int64_t *keys = TRY_ALLOCATE(int64_t, count);
+      if (keys == NULL) {
+         allocation_failed(vm);
+         return NATIVE_ERROR;
+      }
+      for (int i = 0; i < count; ++i) keys[i] = AS_INT(items->values[i]);
+      sort_ints(keys, count);
+      for (int i = 0; i < count; ++i) items->values[i] = INT_VAL(keys[i]);
+      FREE_ARRAY(keys, int64_t, count);
+      break;
+   }
+   case ELEMENTS_DOUBLES: {
+      double *keys = TRY_ALLOCATE(double, count);
+      if (keys == NULL) {
+         allocation_failed(vm);
+         return NATIVE_ERROR;
+      }
+      for (int i = 0; i < count; ++i) keys[i] = AS_NUMBER(items->values[i]);
+      sort_doubles(keys, count);
+      for (int i = 0; i < count; ++i) items->values[i] = NUMBER_VAL(keys[i]);
+      FREE_ARRAY(keys, double, count);
+      break;
+   }
+   case ELEMENTS_NUMERIC:
+      qsort(items->values, count, sizeof(Value), compare_numeric);
+      break;
+   case ELEMENTS_STRINGS:
+      qsort(items->values, count, sizeof(Value), compare_strings);
+      break;
+   case ELEMENTS_OTHER:
+      if (count == 0) break;
+      runtime_error(vm, "Can only sort lists of numbers or lists of strings");
+      return NATIVE_ERROR;
+   }
+
+   *result = args[0];
+   return NATIVE_OK;
+}
+
+NativeResult range_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int count;
+   if (!int_argument(vm, args[0], &count)) return NATIVE_ERROR;
+   if (count < 0) {
+      runtime_error(vm, "Range can't be negative");
+      return NATIVE_ERROR;
+   }
+
+   ObjList *list = new_list(vm, count);
+   if (list == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   for (int i = 0; i < count; ++i) list->items.values[i] = INT_VAL(i);
+   list->items.count = count;
+
+   *result = OBJ_VAL(list);
+   return NATIVE_OK;
+}
+
+static bool check_list(VM *vm, Value value) {
+   if (IS_LIST(value)) return true;
+
+   runtime_error(vm, "Expected a list");
+   return false;
+}
+
+static ElementKind classify(ValueArray *items) {
+   bool ints = false;
+   bool doubles = false;
+   bool strings = false;
+   for (int i = 0; i < items->count; ++i) {
+      Value value = items->values[i];
+      if (IS_INT(value)) {
+         ints = true;
+      } else if (IS_NUMBER(value)) {
+         doubles = true;
+      } else if (IS_TEXT(value)) {
+         strings = true;
+      } else {
+         return ELEMENTS_OTHER;
+      }
+   }
+
+   if (strings) return ints || doubles ? ELEMENTS_OTHER : ELEMENTS_STRINGS;
+   if (ints && doubles) return ELEMENTS_NUMERIC;
+   if (doubles) return ELEMENTS_DOUBLES;
+   // an empty list counts as ints, so its sum is 0
+   return ints || items->count == 0 ? ELEMENTS_INTS : ELEMENTS_OTHER;
+}
+
+// four independent running sums, two per vector register, so the adds
+// don't wait on each other
+// the result may differ from a left to right sum in the last bits
+static double sum_doubles(const Value *values, int count) {
+   int i = 0;
+   double total = 0;
+#ifdef __SSE2__
+   __m128d low = _mm_setzero_pd();
+   __m128d high = _mm_setzero_pd();
+   for (; i + 4 <= count; i += 4) {
+      low = _mm_add_pd(low, _mm_set_pd(AS_NUMBER(values[i + 1]), AS_NUMBER(values[i])));
+      high = _mm_add_pd(high, _mm_set_pd(AS_NUMBER(values[i + 3]), AS_NUMBER(values[i + 2])));
+   }
+   double lanes[2];
+   _mm_storeu_pd(lanes, _mm_add_pd(low, high));
+   total = lanes[0] + lanes[1];
+#endif
+   for (; i < count; ++i) total += AS_NUMBER(values[i]);
+   return total;
+}
+
+// the smallest or largest element of a non empty list of numbers, or
+// the first NaN
+// min and max instructions ignore a NaN in one of their operands, so the
+// vector loop notes whether it saw one on the side
+static Value extreme(ValueArray *items, ElementKind kind, bool want_max) {
+   Value *values = items->values;
+   int count = items->count;
+
+   if (kind == ELEMENTS_INTS) {
+      int64_t best = AS_INT(values[0]);
+      for (int i = 1; i < count; ++i) {
+         int64_t value = AS_INT(values[i]);
+         if (want_max ? value > best : value < best) best = value;
+      }
+      return INT_VAL(best);
+   }
+
+   if (kind == ELEMENTS_DOUBLES) {
+      int i = 0;
+      double best = AS_NUMBER(values[0]);
+      bool nan = false;
+#ifdef __SSE2__
+      __m128d lanes = _mm_set1_pd(best);
+      __m128d nans = _mm_setzero_pd();
+      for (; i + 2 <= count; i += 2) {
+         __m128d pair = _mm_set_pd(AS_NUMBER(values[i + 1]), AS_NUMBER(values[i]));
+         lanes = want_max ? _mm_max_pd(lanes, pair) : _mm_min_pd(lanes, pair);
+         nans = _mm_or_pd(nans, _mm_cmpunord_pd(pair, pair));
+      }
+      double unpacked[2];
+      _mm_storeu_pd(unpacked, lanes);
+      best = want_max ? (unpacked[0] > unpacked[1] ? unpacked[0] : unpacked[1])
+         : (unpacked[0] < unpacked[1] ? unpacked[0] : unpacked[1]);
+      nan = _mm_movemask_pd(nans) != 0;
+#endif
+      for (; i < count; ++i) {
+         double value = AS_NUMBER(values[i]);
+         nan = nan || isnan(value);
+         if (want_max ? value > best : value < best) best = value;
+      }
+      if (nan || isnan(best)) {
+         while (!is_nan(*values)) ++values;
+         return *values;
+      }
+      return NUMBER_VAL(best);
+   }
+
+   // ints and numbers, the element itself is returned
+   Value best = values[0];
+   for (int i = 1; i < count && !is_nan(best); ++i) {
+      int order = compare_numeric(&values[i], &best);
+      if (is_nan(values[i]) || (want_max ? order > 0 : order < 0)) best = values[i];
+   }
+   return best;
+}
+
+// three way quicksort, so runs of equal keys don't make it quadratic,
+// recursing into the smaller side to bound the stack
+#define DEFINE_SORT(name, type) \
+   static void name(type *items, int count) { \
+      while (count > 16) { \
+         type first = items[0]; \
+         type middle = items[count / 2]; \
+         type last = items[count - 1]; \
+         type pivot = first < middle \
+            ? (middle < last ? middle : (first < last ? last : first)) \
+            : (first < last ? first : (middle < last ? last : middle)); \
+         int less = 0; \
+         int i = 0; \
+         int greater = count; \
+         while (i < greater) { \
+            type item = items[i]; \
+            if (item < pivot) { \
+               items[i++] = items[less]; \
+               items[less++] = item; \
+            } else if (pivot < item) { \
+               items[i] = items[--greater]; \
+               items[greater] = item; \
+            } else { \
+               ++i; \
+            } \
+         } \
+         if (less < count - greater) { \
+            name(items, less); \
+            items += greater; \
+            count -= greater; \
+         } else { \
+            name(items + greater, count - greater); \
+            count = less; \
+         } \
+      } \
+      for (int i = 1; i < count; ++i) { \
+         type item = items[i]; \
+         int j = i; \
+         for (; j > 0 && item < items[j - 1]; --j) items[j] = items[j - 1]; \
+         items[j] = item; \
+      } \
+   }
+
+DEFINE_SORT(sort_ints, int64_t)
+DEFINE_SORT(sort_doubles, double)
+
+#undef DEFINE_SORT
+
+static bool is_nan(Value value) {
+   return IS_NUMBER(value) && isnan(AS_NUMBER(value));
+}
+
+static int compare_numeric(const void *a, const void *b) {
+   Value x = *(const Value *)a;
+   Value y = *(const Value *)b;
+   if (IS_INT(x) && IS_INT(y)) return (AS_INT(x) > AS_INT(y)) - (AS_INT(x) < AS_INT(y));
+
+   double dx = AS_DOUBLE(x);
+   double dy = AS_DOUBLE(y);
+   return (dx > dy) - (dx < dy);
+}
+
+static int compare_strings(const void *a, const void *b) {
+   Value x = *(const Value *)a;
+   Value y = *(const Value *)b;
+   int x_length = text_length(x);
+   int y_length = text_length(y);
+   int order = memcmp(text_chars(x), text_chars(y), x_length < y_length ? x_length : y_length);
+   if (order != 0) return order;
+   return (x_length > y_length) - (x_length < y_length);
+}
\ No newline at end of file
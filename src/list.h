@@ -0,0 +1,27 @@
+#ifndef KI_LIST_H
+#define KI_LIST_H
+
+#include "native.h"
+
+// List natives
+// The bulk operations run as one loop over the list's storage, with a
+// faster loop when every element is a number or every element is an int
+
+// len(list, map or string)
+NativeResult len_native(VM *vm, int arg_count, Value *args, Value *result);
+// append(list, value), returns the list
+NativeResult append_native(VM *vm, int arg_count, Value *args, Value *result);
+// sum(list), ints add up to an int unless the total overflows
+NativeResult sum_native(VM *vm, int arg_count, Value *args, Value *result);
+// min(list) and max(list), the list must not be empty
+// NaN if any element is NaN
+NativeResult min_native(VM *vm, int arg_count, Value *args, Value *result);
+NativeResult max_native(VM *vm, int arg_count, Value *args, Value *result);
+// map_add(list, number), a new list with [number] added to every element
+NativeResult map_add_native(VM *vm, int arg_count, Value *args, Value *result);
+// sort(list), sorts numbers or strings in place and returns the list
+NativeResult sort_native(VM *vm, int arg_count, Value *args, Value *result);
+// range(n), the list [0, 1, ..., n - 1]
+NativeResult range_native(VM *vm, int arg_count, Value *args, Value *result);
+
+#endif
\ No newline at end of file
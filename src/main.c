@@ -1,76 +1,493 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #include "common.h"
 #include "chunk.h"
+#include "channel.h"
+#include "compiler.h"
 #include "debug.h"
+#include "image.h"
+#include "intern.h"
+#include "runner.h"
+#include "scheduler.h"
+#include "server.h"
+#include "source.h"
+#include "tokens.h"
 #include "vm.h"
 #include "input.h"
 
-static void repl();
-static void run_file(const char *path);
-static char* read_file(const char *path);
+static void repl(VM *vm);
+static int run_file(VM *vm, const char *path);
+static int run_stream(VM *vm, int fd, const char *name);
+static void run_files(const char **paths, int count, RunOptions *options);
+static int run_sliced(const char **paths, Priority *priorities, int count,
+   uint64_t quantum, RunOptions *options);
+static void lex_stats(const char *path);
+static void load_base_strings(const char *path);
+static int save_image(const char *path, Source *source, RunOptions *options);
+static void report_profile();
+static void report_samples();
+static void open_debug_output(const char *path);
+static void usage();
 
-VM vm;
+static Profile profile;
+// where --profile-json writes, the report goes to stderr without it
+static const char *profile_path = NULL;
+static Sampler sampler;
+// where --sample writes the folded samples
+static const char *sample_path = NULL;
+// where --trace and --disasm write
+static Output debug_output;
 
 int main(int argc, const char* argv[]) {
+   RunOptions options;
+   init_run_options(&options);
+
+   bool only_lex = false;
+   bool parallel = false;
+   bool profiling = false;
+   bool memory_stats = false;
+   bool tracing = false;
+   bool disassembling = false;
+   const char *trace_path = NULL;
+   int sample_hz = 1000;
+   // --slice runs every path on one vm, a slice of [quantum] instructions
+   // at a time, those given with --high and --low first
+   long long quantum = 0;
+   const char *serve_path = NULL;
+   const char *client_path = NULL;
+   bool has_base_strings = false;
+   const char *save_image_path = NULL;
+   const char *image_path = NULL;
+   const char **sliced_paths = (const char **)malloc(sizeof(const char *) * argc);
+   Priority *priorities = (Priority *)malloc(sizeof(Priority) * argc);
+   int sliced_count = 0;
+   int arg = 1;
+   for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; ++arg) {
+      if (strcmp(argv[arg], "--batch-lex") == 0) {
+         options.batch_lexing = true;
+      } else if (strcmp(argv[arg], "--lex-stats") == 0) {
+         only_lex = true;
+      } else if (strcmp(argv[arg], "--compile") == 0) {
+         options.compile_only = true;
+         parallel = true;
+      } else if (strcmp(argv[arg], "--intern-base") == 0 && arg + 1 < argc) {
+         load_base_strings(argv[++arg]);
+         has_base_strings = true;
+      } else if (strcmp(argv[arg], "--save-image") == 0 && arg + 1 < argc) {
+         save_image_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--image") == 0 && arg + 1 < argc) {
+         image_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--profile") == 0) {
+         profiling = true;
+      } else if (strcmp(argv[arg], "--profile-json") == 0 && arg + 1 < argc) {
+         profile_path = argv[++arg];
+         profiling = true;
+      } else if (strcmp(argv[arg], "--mem-stats") == 0) {
+         options.memory_stats = true;
+         memory_stats = true;
+      } else if (strcmp(argv[arg], "--sample") == 0 && arg + 1 < argc) {
+         sample_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--sample-hz") == 0 && arg + 1 < argc) {
+         sample_hz = atoi(argv[++arg]);
+         if (sample_hz < 1 || sample_hz > 100000) usage();
+      } else if (strcmp(argv[arg], "--trace") == 0) {
+         tracing = true;
+      } else if (strcmp(argv[arg], "--disasm") == 0) {
+         disassembling = true;
+      } else if (strcmp(argv[arg], "--trace-file") == 0 && arg + 1 < argc) {
+         trace_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--max-memory") == 0 && arg + 1 < argc) {
+         options.limits.memory = atoll(argv[++arg]);
+         if (options.limits.memory < 1) usage();
+      } else if (strcmp(argv[arg], "--max-steps") == 0 && arg + 1 < argc) {
+         long long steps = atoll(argv[++arg]);
+         if (steps < 1) usage();
+         options.limits.steps = (uint64_t)steps;
+      } else if (strcmp(argv[arg], "--max-time") == 0 && arg + 1 < argc) {
+         options.limits.milliseconds = atoll(argv[++arg]);
+         if (options.limits.milliseconds < 1) usage();
+      } else if (strcmp(argv[arg], "--slice") == 0 && arg + 1 < argc) {
+         quantum = atoll(argv[++arg]);
+         if (quantum < 1) usage();
+      } else if (strcmp(argv[arg], "--high") == 0 && arg + 1 < argc) {
+         sliced_paths[sliced_count] = argv[++arg];
+         priorities[sliced_count++] = PRIORITY_HIGH;
+      } else if (strcmp(argv[arg], "--low") == 0 && arg + 1 < argc) {
+         sliced_paths[sliced_count] = argv[++arg];
+         priorities[sliced_count++] = PRIORITY_LOW;
+      } else if (strcmp(argv[arg], "--serve") == 0 && arg + 1 < argc) {
+         serve_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--client") == 0 && arg + 1 < argc) {
+         client_path = argv[++arg];
+      } else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc) {
+         options.jobs = atoi(argv[++arg]);
+         if (options.jobs < 1) usage();
+         parallel = true;
+      } else {
+         usage();
+      }
+   }
+   bool debugging = profiling || tracing || disassembling || sample_path != NULL;
+   bool other_modes = parallel || only_lex || quantum > 0 || sliced_count > 0
+      || serve_path != NULL || client_path != NULL;
+   if (save_image_path != NULL) {
+      if (image_path != NULL || other_modes || debugging || arg != argc - 1) usage();
+      free(sliced_paths);
+      free(priorities);
+      // the script's own strings go in the base set, and so in the image
+      Source source;
+      if (!read_source(argv[arg], &source)) return 74;
+      add_base_strings_from_source(source.chars, source.length);
+      freeze_base_strings();
+      int status = save_image(save_image_path, &source, &options);
+      free_source(&source);
+      free_base_strings();
+      return status;
+   }
+   Image image;
+   if (image_path != NULL) {
+      if (has_base_strings || other_modes || arg != argc) usage();
+      if (!load_image(image_path, &image)) {
+         free(sliced_paths);
+         free(priorities);
+         return 74;
+      }
+      use_base_strings(&image.strings);
+   } else {
+      freeze_base_strings();
+   }
+
+   if (serve_path != NULL || client_path != NULL) {
+      free(sliced_paths);
+      free(priorities);
+      if (debugging || options.compile_only || quantum > 0 || sliced_count > 0) {
+         usage();
+      }
+      int status;
+      if (serve_path != NULL) {
+         if (client_path != NULL || arg != argc) usage();
+         status = serve(serve_path, &options);
+      } else {
+         if (arg != argc - 1) usage();
+         status = run_client(client_path, argv[arg]);
+      }
+      free_channels();
+      free_base_strings();
+      return status;
+   }
+
+   if (quantum > 0 || sliced_count > 0) {
+      if (quantum == 0 || parallel || debugging) usage();
+      for (; arg < argc; ++arg) {
+         sliced_paths[sliced_count] = argv[arg];
+         priorities[sliced_count++] = PRIORITY_NORMAL;
+      }
+      if (sliced_count == 0) usage();
+      int status = run_sliced(sliced_paths, priorities, sliced_count,
+         (uint64_t)quantum, &options);
+      free(sliced_paths);
+      free(priorities);
+      free_channels();
+      free_base_strings();
+      return status;
+   }
+   free(sliced_paths);
+   free(priorities);
+
+   if (parallel) {
+      if (arg == argc || profiling || tracing || disassembling || sample_path != NULL) {
+         usage();
+      }
+      run_files(&argv[arg], argc - arg, &options);
+      free_channels();
+      free_base_strings();
+      return 0;
+   }
+
+   if (only_lex) {
+      if (arg != argc - 1) usage();
+      lex_stats(argv[arg]);
+      return 0;
+   }
+
+   VM vm;
    init_vm(&vm);
+   vm.batch_lexing = options.batch_lexing;
+   vm.limits = options.limits;
+   if (profiling) {
+      init_profile(&profile);
+      vm.profile = &profile;
+      // reported at exit, however the script ends
+      atexit(report_profile);
+   }
+   if (sample_path != NULL) {
+      const char *name = image_path != NULL ? image_path : "repl";
+      start_sampler(&sampler, &vm, sample_hz, arg < argc ? argv[arg] : name);
+      atexit(report_samples);
+   }
+   if (tracing || disassembling) {
+      open_debug_output(trace_path);
+      if (tracing) vm.trace = &debug_output;
+      if (disassembling) vm.disassembly = &debug_output;
+   }
 
-   if (argc == 1) {
-      repl();
-   } else if (argc == 2) {
-      run_file(argv[1]);
+   int status = 0;
+   if (image_path != NULL) {
+      // interpret() does this around the chunk it compiles
+      MemoryStats *previous = use_memory_stats(&vm.memory);
+      status = exit_status(interpret_chunk(&vm, &image.chunk));
+      use_memory_stats(previous);
+   } else if (arg == argc) {
+      repl(&vm);
+   } else if (arg == argc - 1) {
+      status = run_file(&vm, argv[arg]);
    } else {
-      fprintf(stderr, "Usage: ki [path]\n");
-      exit(64);
+      usage();
    }
    
+   // what's still live at the end, and the peak
+   if (memory_stats) write_vm_memory_stats(&vm, stderr);
    free_vm(&vm);
-   return 0;
+   if (tracing || disassembling) {
+      free_output(&debug_output);
+      if (debug_output.fd != STDERR_FILENO) close(debug_output.fd);
+   }
+   free_channels();
+   free_base_strings();
+   if (image_path != NULL) free_image(&image);
+   return status;
+}
+
+static void usage() {
+   fprintf(stderr, "Usage: ki [--batch-lex] [--lex-stats] [--intern-base path]\n");
+   fprintf(stderr, "          [--profile] [--profile-json out] [--sample out] [--sample-hz N]\n");
+   fprintf(stderr, "          [--trace] [--disasm] [--trace-file out] [--mem-stats]\n");
+   fprintf(stderr, "          [--max-memory bytes] [--max-steps N] [--max-time ms] [path | -]\n");
+   fprintf(stderr, "       ki [--compile] [--intern-base path] [--mem-stats]\n");
+   fprintf(stderr, "          [--max-memory bytes] [--max-steps N] [--max-time ms] --jobs N path...\n");
+   fprintf(stderr, "       ki [--intern-base path] [--mem-stats] [--max-memory bytes]\n");
+   fprintf(stderr, "          [--max-steps N] [--max-time ms] --slice N [--high path] [--low path]\n");
+   fprintf(stderr, "          path...\n");
+   fprintf(stderr, "       ki [--intern-base path] [--mem-stats] [--max-memory bytes]\n");
+   fprintf(stderr, "          [--max-steps N] [--max-time ms] [--jobs N] --serve socket\n");
+   fprintf(stderr, "       ki --client socket path\n");
+   fprintf(stderr, "       ki [--intern-base path] --save-image out path\n");
+   fprintf(stderr, "       ki [--profile] [--profile-json out] [--sample out] [--sample-hz N]\n");
+   fprintf(stderr, "          [--trace] [--trace-file out] [--mem-stats] [--max-memory bytes]\n");
+   fprintf(stderr, "          [--max-steps N] [--max-time ms] --image image\n");
+   exit(64);
+}
+
+// seeds the shared base intern set with the identifiers and string
+// literals of a file, before any vm exists
+static void load_base_strings(const char *path) {
+   Source source;
+   if (!read_source(path, &source)) exit(74);
+   add_base_strings_from_source(source.chars, source.length);
+   free_source(&source);
+}
+
+// compiles the script against the base set and writes both to [path]
+static int save_image(const char *path, Source *source, RunOptions *options) {
+   VM vm;
+   init_vm(&vm);
+   vm.batch_lexing = options->batch_lexing;
+   MemoryStats *previous = use_memory_stats(&vm.memory);
+   Chunk chunk;
+   init_chunk(&chunk);
+
+   int status = 65;
+   if (compile(source->chars, source->length, &vm, &chunk)) {
+      status = write_image(path, &chunk) ? 0 : 74;
+   }
+
+   free_chunk(&chunk);
+   use_memory_stats(previous);
+   free_vm(&vm);
+   return status;
+}
+
+static void report_profile() {
+   if (profile_path == NULL) {
+      write_profile_report(&profile, stderr);
+   } else {
+      FILE *file = fopen(profile_path, "w");
+      if (file == NULL) {
+         fprintf(stderr, "Could not open file \"%s\"\n", profile_path);
+      } else {
+         write_profile_json(&profile, file);
+         fclose(file);
+      }
+   }
+   free_profile(&profile);
 }
 
-static void repl() {
+// the trace and disassembly go to stderr unless given a file
+static void open_debug_output(const char *path) {
+   init_output(&debug_output);
+   if (path == NULL) {
+      output_to_fd(&debug_output, STDERR_FILENO);
+      return;
+   }
+
+   int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) {
+      fprintf(stderr, "Could not open file \"%s\"\n", path);
+      exit(74);
+   }
+   output_to_fd(&debug_output, fd);
+}
+
+static void report_samples() {
+   FILE *file = fopen(sample_path, "w");
+   if (file == NULL) {
+      fprintf(stderr, "Could not open file \"%s\"\n", sample_path);
+   } else {
+      write_folded_samples(&sampler, file);
+      fclose(file);
+   }
+   stop_sampler(&sampler);
+}
+
+static void repl(VM *vm) {
    for (;;) {
       char *line = readline("> ");
-      interpret(&vm, line);
+      if (line == NULL) return;
+      interpret(vm, line, strlen(line));
       add_history(line);
       free(line);
    }
 }
 
-static void run_file(const char *path) {
-   char *source = read_file(path);
-   InterpretResult result = interpret(&vm, source);
-   free(source);
+// returns the status to exit with
+static int run_file(VM *vm, const char *path) {
+   // stdin and pipes are compiled as they arrive instead of read first
+   if (strcmp(path, "-") == 0) return run_stream(vm, STDIN_FILENO, "stdin");
+   struct stat status;
+   if (stat(path, &status) == 0 && (S_ISFIFO(status.st_mode) || S_ISCHR(status.st_mode))) {
+      int fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (fd < 0) {
+         fprintf(stderr, "Could not open file \"%s\"\n", path);
+         return 74;
+      }
+      int result = run_stream(vm, fd, path);
+      close(fd);
+      return result;
+   }
 
-   if (result == INTERPRET_COMPILE_ERROR) exit(65);
-   if (result == INTERPRET_RUNTIME_ERROR) exit(70);
+   Source source;
+   if (!read_source(path, &source)) return 74;
+   InterpretResult result = interpret(vm, source.chars, source.length);
+   free_source(&source);
+   return exit_status(result);
 }
 
-static char* read_file(const char *path) {
-   FILE *file = fopen(path, "rb");
-   if (file == NULL) {
-      fprintf(stderr, "Could not open file \"%s\"\n", path);
-      exit(74);
+static int run_stream(VM *vm, int fd, const char *name) {
+   FdReader reader;
+   init_fd_reader(&reader, fd, name);
+   InterpretResult result = interpret_stream(vm, &reader.reader);
+   return reader.failed ? 74 : exit_status(result);
+}
+
+// runs every file on one vm and one thread, see scheduler.h
+// returns the status a single failing file would have
+static int run_sliced(const char **paths, Priority *priorities, int count,
+   uint64_t quantum, RunOptions *options)
+{
+   VM vm;
+   init_vm(&vm);
+   vm.batch_lexing = options->batch_lexing;
+   vm.limits = options->limits;
+   Scheduler scheduler;
+   init_scheduler(&scheduler, &vm, quantum);
+
+   int status = 0;
+   for (int i = 0; i < count; ++i) {
+      Source source;
+      if (!read_source(paths[i], &source)) {
+         fprintf(stderr, "Failed: \"%s\"\n", paths[i]);
+         status = 74;
+         continue;
+      }
+      schedule_script(&scheduler, paths[i], source.chars, source.length, priorities[i]);
+      free_source(&source);
+   }
+
+   run_scheduler(&scheduler);
+
+   for (ScheduledScript *script = scheduler.done_head; script != NULL;
+      script = script->next)
+   {
+      if (script->result == INTERPRET_OK) continue;
+      int script_status = exit_status(script->result);
+      if (status == 0 || (status != 74 && script_status == 65)) {
+         status = script_status;
+      }
+      fprintf(stderr, "Failed: \"%s\"\n", script->name);
    }
-   
-   // determine file size
-   fseek(file, 0L, SEEK_END);
-   size_t file_size = ftell(file);
-   rewind(file);
 
-   char *buffer = (char*)malloc(file_size + 1);
-   if (buffer == NULL) {
-      fprintf(stderr, "Not enough memory to read \"%s\"\n", path);
+   free_scheduler(&scheduler);
+   if (options->memory_stats) write_vm_memory_stats(&vm, stderr);
+   free_vm(&vm);
+   return status;
+}
+
+// runs every file on its own vm, [options->jobs] files at a time
+// exits with the status a single failing file would have
+static void run_files(const char **paths, int count, RunOptions *options) {
+   Script *scripts = (Script *)malloc(sizeof(Script) * count);
+   for (int i = 0; i < count; ++i) {
+      scripts[i].path = paths[i];
    }
 
-   size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-   if (bytes_read < file_size) {
-      fprintf(stderr, "Could not read file \"%s\"\n", path);
+   int failed = run_scripts(scripts, count, options);
+
+   int status = 0;
+   for (int i = 0; failed > 0 && i < count; ++i) {
+      switch (scripts[i].status) {
+         case SCRIPT_OK: continue;
+         case SCRIPT_READ_ERROR: status = 74; break;
+         case SCRIPT_COMPILE_ERROR: if (status != 74) status = 65; break;
+         case SCRIPT_RUNTIME_ERROR: if (status == 0) status = 70; break;
+         case SCRIPT_MEMORY_LIMIT: if (status == 0) status = 71; break;
+         case SCRIPT_BUDGET_EXCEEDED: if (status == 0) status = 75; break;
+      }
+      fprintf(stderr, "Failed: \"%s\"\n", scripts[i].path);
    }
 
-   buffer[bytes_read] = '\0';
+   free(scripts);
+   if (status != 0) exit(status);
+}
+
+// lexes the file into a token buffer and reports throughput and the
+// memory the buffer takes
+static void lex_stats(const char *path) {
+   Source source;
+   if (!read_source(path, &source)) exit(74);
+   TokenBuffer tokens;
+   init_token_buffer(&tokens);
+
+   struct timespec start, end;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   tokenize(&tokens, source.chars, source.length);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   double seconds = (end.tv_sec - start.tv_sec)
+      + (end.tv_nsec - start.tv_nsec) / 1e9;
+   printf("tokens:        %d\n", tokens.count);
+   printf("source bytes:  %zu\n", source.length);
+   printf("seconds:       %.6f\n", seconds);
+   printf("tokens/sec:    %.0f\n", seconds > 0 ? tokens.count / seconds : 0.0);
+   printf("bytes/token:   %.2f (%zu bytes, Token is %zu bytes)\n",
+      (double)token_buffer_size(&tokens) / tokens.count,
+      token_buffer_size(&tokens), sizeof(Token));
 
-   fclose(file);
-   return buffer;
+   free_token_buffer(&tokens);
+   free_source(&source);
 }
\ No newline at end of file
@@ -0,0 +1,90 @@
+#include "map.h"
+#include "memory.h"
+#include "object.h"
+
+static bool check_map(VM *vm, Value value);
+static ObjList* collect(VM *vm, ValueTable *table, bool keys);
+
+NativeResult keys_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_map(vm, args[0])) return NATIVE_ERROR;
+
+   ObjList *keys = collect(vm, &AS_MAP(args[0])->table, true);
+   if (keys == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   *result = OBJ_VAL(keys);
+   return NATIVE_OK;
+}
+
+NativeResult values_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_map(vm, args[0])) return NATIVE_ERROR;
+
+   ObjList *values = collect(vm, &AS_MAP(args[0])->table, false);
+   if (values == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   *result = OBJ_VAL(values);
+   return NATIVE_OK;
+}
+
+NativeResult has_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_map(vm, args[0])) return NATIVE_ERROR;
+
+   Value value;
+   *result = BOOL_VAL(value_table_get(&AS_MAP(args[0])->table, map_key(vm, args[1]), &value));
+   return NATIVE_OK;
+}
+
+NativeResult remove_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!check_map(vm, args[0])) return NATIVE_ERROR;
+
+   *result = BOOL_VAL(value_table_delete(&AS_MAP(args[0])->table, map_key(vm, args[1])));
+   return NATIVE_OK;
+}
+
+NativeResult reserve_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int count;
+   if (!check_map(vm, args[0]) || !int_argument(vm, args[1], &count)) {
+      return NATIVE_ERROR;
+   }
+   if (count < 0) {
+      runtime_error(vm, "Can't reserve a negative count");
+      return NATIVE_ERROR;
+   }
+   if (count > VALUE_TABLE_MAX) {
+      runtime_error(vm, "Can't reserve more than %d entries", VALUE_TABLE_MAX);
+      return NATIVE_ERROR;
+   }
+
+   if (!value_table_reserve(&AS_MAP(args[0])->table, count)) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   *result = args[0];
+   return NATIVE_OK;
+}
+
+static bool check_map(VM *vm, Value value) {
+   if (IS_MAP(value)) return true;
+
+   runtime_error(vm, "Expected a map");
+   return false;
+}
+
+static ObjList* collect(VM *vm, ValueTable *table, bool keys) {
+   ObjList *list = new_list(vm, table->count);
+   if (list == NULL) return NULL;
+   for (int i = 0; i < table->used; ++i) {
+      ValueEntry *entry = &table->entries[i];
+      if (entry->deleted) continue;
+      list->items.values[list->items.count++] = keys ? entry->key : entry->value;
+   }
+   return list;
+}
\ No newline at end of file
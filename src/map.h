@@ -0,0 +1,19 @@
+#ifndef KI_MAP_H
+#define KI_MAP_H
+
+#include "native.h"
+
+// Map natives, keys and values come back in insertion order
+
+// keys(map)
+NativeResult keys_native(VM *vm, int arg_count, Value *args, Value *result);
+// values(map)
+NativeResult values_native(VM *vm, int arg_count, Value *args, Value *result);
+// has(map, key)
+NativeResult has_native(VM *vm, int arg_count, Value *args, Value *result);
+// remove(map, key), returns whether the key was there
+NativeResult remove_native(VM *vm, int arg_count, Value *args, Value *result);
+// reserve(map, count), makes room for [count] entries and returns the map
+NativeResult reserve_native(VM *vm, int arg_count, Value *args, Value *result);
+
+#endif
\ No newline at end of file
@@ -1,17 +1,122 @@
+#include <stdio.h>
 #include <stdlib.h>
 
+#include "channel.h"
 #include "common.h"
 #include "memory.h"
 
+_Static_assert(OBJ_MAP + 1 == OBJ_TYPE_COUNT, "OBJ_TYPE_COUNT is out of date");
+
+static void count_reallocation(MemoryStats *stats, void *previous, size_t old_size,
+   size_t new_size);
+static bool over_limit(MemoryStats *stats, size_t old_size, size_t new_size);
 static void free_object(Obj *object);
+static void uncount_object(ObjType type, size_t size);
+
+static const char *object_type_names[OBJ_TYPE_COUNT] = {
+   [OBJ_STRING] = "string",
+   [OBJ_CHANNEL] = "channel",
+   [OBJ_LIST] = "list",
+   [OBJ_SLICE] = "slice",
+   [OBJ_MAP] = "map",
+};
+
+// what reallocate() counts into on this thread
+static _Thread_local MemoryStats *current_stats = NULL;
 
 void* reallocate (void *previous, size_t old_size, size_t new_size) {
+   count_reallocation(current_stats, previous, old_size, new_size);
+
    if (new_size == 0) {
       free(previous);
       return NULL;
    }
 
-   return realloc(previous, new_size);
+   void *memory = realloc(previous, new_size);
+   if (memory == NULL) {
+      // the callers take the memory as given, there is no going on
+      fprintf(stderr, "Out of memory\n");
+      exit(71);
+   }
+   return memory;
+}
+
+void* try_reallocate(void *previous, size_t old_size, size_t new_size) {
+   if (new_size == 0) return reallocate(previous, old_size, new_size);
+
+   MemoryStats *stats = current_stats;
+   if (previous == NULL) old_size = 0;
+   if (stats != NULL && over_limit(stats, old_size, new_size)) {
+      stats->over_limit = true;
+      return NULL;
+   }
+
+   void *memory = realloc(previous, new_size);
+   if (memory != NULL) count_reallocation(stats, previous, old_size, new_size);
+   return memory;
+}
+
+void init_memory_stats(MemoryStats *stats) {
+   stats->bytes = 0;
+   stats->peak_bytes = 0;
+   stats->allocations = 0;
+   stats->reallocations = 0;
+   stats->frees = 0;
+   for (int i = 0; i < OBJ_TYPE_COUNT; ++i) {
+      stats->objects[i] = 0;
+      stats->object_bytes[i] = 0;
+   }
+   stats->limit = INT64_MAX;
+   stats->over_limit = false;
+}
+
+MemoryStats* use_memory_stats(MemoryStats *stats) {
+   MemoryStats *previous = current_stats;
+   current_stats = stats;
+   return previous;
+}
+
+void write_memory_stats(MemoryStats *stats, FILE *file) {
+   fprintf(file, "bytes allocated:  %lld\n", (long long)stats->bytes);
+   fprintf(file, "peak bytes:       %lld\n", (long long)stats->peak_bytes);
+   fprintf(file, "allocations:      %llu\n", (unsigned long long)stats->allocations);
+   fprintf(file, "reallocations:    %llu\n", (unsigned long long)stats->reallocations);
+   fprintf(file, "frees:            %llu\n", (unsigned long long)stats->frees);
+   fprintf(file, "%-10s %12s %12s\n", "object", "live", "bytes");
+   for (int i = 0; i < OBJ_TYPE_COUNT; ++i) {
+      fprintf(file, "%-10s %12lld %12lld\n", object_type_names[i],
+         (long long)stats->objects[i], (long long)stats->object_bytes[i]);
+   }
+}
+
+static void count_reallocation(MemoryStats *stats, void *previous, size_t old_size,
+   size_t new_size)
+{
+   if (stats == NULL) return;
+
+   if (new_size == 0) {
+      if (previous != NULL) ++stats->frees;
+   } else if (previous == NULL) {
+      ++stats->allocations;
+   } else {
+      ++stats->reallocations;
+   }
+   if (previous == NULL) old_size = 0;
+   stats->bytes += (int64_t)new_size - (int64_t)old_size;
+   if (stats->bytes > stats->peak_bytes) stats->peak_bytes = stats->bytes;
+}
+
+static bool over_limit(MemoryStats *stats, size_t old_size, size_t new_size) {
+   if (stats->limit == INT64_MAX || new_size <= old_size) return false;
+
+   size_t growth = new_size - old_size;
+   return growth > (size_t)INT64_MAX || (int64_t)growth > stats->limit - stats->bytes;
+}
+
+void count_object(ObjType type, size_t size) {
+   if (current_stats == NULL) return;
+   ++current_stats->objects[type];
+   current_stats->object_bytes[type] += size;
 }
 
 void free_objects(Obj *objects) {
@@ -26,10 +131,44 @@ static void free_object(Obj *object) {
    switch (object->type) {
       case OBJ_STRING: {
          ObjString *string = (ObjString *)object;
-         FREE_ARRAY(string->chars, char, string->length + 1);
+         if (string->shared != NULL) {
+            release_shared_chars(string->shared);
+         } else {
+            FREE_ARRAY(string->chars, char, string->length + 1);
+         }
          FREE(ObjString, string);
+         uncount_object(OBJ_STRING, sizeof(ObjString));
+         break;
+      }
+      case OBJ_CHANNEL: {
+         release_channel(((ObjChannel *)object)->channel);
+         FREE(ObjChannel, object);
+         uncount_object(OBJ_CHANNEL, sizeof(ObjChannel));
+         break;
+      }
+      case OBJ_LIST: {
+         free_value_array(&((ObjList *)object)->items);
+         FREE(ObjList, object);
+         uncount_object(OBJ_LIST, sizeof(ObjList));
+         break;
+      }
+      // the parent and the copy are objects of their own
+      case OBJ_SLICE:
+         FREE(ObjSlice, object);
+         uncount_object(OBJ_SLICE, sizeof(ObjSlice));
+         break;
+      case OBJ_MAP: {
+         free_value_table(&((ObjMap *)object)->table);
+         FREE(ObjMap, object);
+         uncount_object(OBJ_MAP, sizeof(ObjMap));
          break;
       }
    }
 
+}
+
+static void uncount_object(ObjType type, size_t size) {
+   if (current_stats == NULL) return;
+   --current_stats->objects[type];
+   current_stats->object_bytes[type] -= size;
 }
\ No newline at end of file
@@ -18,6 +18,13 @@
 #define FREE_ARRAY(array, type, count) \
    reallocate((array), sizeof(type) * (count), 0)
 
+#define TRY_ALLOCATE(type, count) \
+   (type*)try_reallocate(NULL, 0, sizeof(type) * (size_t)(count))
+
+#define TRY_GROW_ARRAY(array, type, old_count, new_count) \
+   (type*)try_reallocate((array), sizeof(type) * (size_t)(old_count), \
+      sizeof(type) * (size_t)(new_count))
+
 // This one function handles memory allocating, deallocating and reallocating
 // We need all memory allocations in the interpreter to pass through it in order to be able
 //   to implement a garbage collector
@@ -25,8 +32,16 @@
 // Given a 0 [old_size], it allocates new memory and return a pointer to it
 // Given non-zero [old_size] and [new_size] it resizes the memory pointed to by [previous]
 //   and return a pointer pointing to the resized memory (may differ from [previous]) 
+// Running out of memory ends the process
 void* reallocate(void *previous, size_t old_size, size_t new_size);
+// Like reallocate(), for allocations a script decides the size of
+// Returns NULL, leaving [previous] as it was, rather than grow past the limit
+//   of the current memory stats, which sets their [over_limit], or when out of
+//   memory
+void* try_reallocate(void *previous, size_t old_size, size_t new_size);
 // frees a linked list of objects
 void free_objects(Obj *objects);
+// counts a new object in the current memory stats
+void count_object(ObjType type, size_t size);
 
 #endif
\ No newline at end of file
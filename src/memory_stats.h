@@ -0,0 +1,38 @@
+#ifndef KI_MEMORY_STATS_H
+#define KI_MEMORY_STATS_H
+
+#include <stdio.h>
+
+#include "common.h"
+
+// one slot per ObjType, memory.c checks the two agree
+#define OBJ_TYPE_COUNT 5
+
+// What reallocate() did on behalf of one vm
+// reallocate() has no vm to hand, it counts into the stats made current
+// on its thread with use_memory_stats(), which the vm does whenever it
+// compiles, runs or frees. Memory that moves between vms, like channel
+// messages, is counted where it's allocated and where it's freed, so
+// [bytes] may be off by that much, either way
+typedef struct {
+   int64_t bytes;
+   int64_t peak_bytes;
+   uint64_t allocations;
+   uint64_t reallocations;
+   uint64_t frees;
+   // live objects and the bytes of their structs, by ObjType
+   int64_t objects[OBJ_TYPE_COUNT];
+   int64_t object_bytes[OBJ_TYPE_COUNT];
+   // what try_reallocate() won't let [bytes] grow past, INT64_MAX for no
+   // limit, and whether it refused to since the limit was last set
+   int64_t limit;
+   bool over_limit;
+} MemoryStats;
+
+void init_memory_stats(MemoryStats *stats);
+// makes reallocate() on this thread count into [stats], NULL for nothing,
+// and returns the stats it counted into until now
+MemoryStats* use_memory_stats(MemoryStats *stats);
+void write_memory_stats(MemoryStats *stats, FILE *file);
+
+#endif
\ No newline at end of file
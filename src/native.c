@@ -0,0 +1,69 @@
+#include <limits.h>
+#include <string.h>
+
+#include "channel.h"
+#include "io.h"
+#include "list.h"
+#include "map.h"
+#include "slice.h"
+#include "native.h"
+
+const Native natives[] = {
+   { "channel", 1, channel_native },
+   { "send", 2, send_native },
+   { "try_send", 2, try_send_native },
+   { "receive", 1, receive_native },
+   { "try_receive", 1, try_receive_native },
+   { "open", 2, open_native },
+   { "read", 2, read_native },
+   { "write", 2, write_native },
+   { "close", 1, close_native },
+   { "listen", 2, listen_native },
+   { "accept", 1, accept_native },
+   { "connect", 2, connect_native },
+   { "pipe", 0, pipe_native },
+   { "len", 1, len_native },
+   { "append", 2, append_native },
+   { "sum", 1, sum_native },
+   { "min", 1, min_native },
+   { "max", 1, max_native },
+   { "map_add", 2, map_add_native },
+   { "sort", 1, sort_native },
+   { "range", 1, range_native },
+   { "substr", 3, substr_native },
+   { "split", 2, split_native },
+   { "keys", 1, keys_native },
+   { "values", 1, values_native },
+   { "has", 2, has_native },
+   { "remove", 2, remove_native },
+   { "reserve", 2, reserve_native },
+   { NULL, 0, NULL },
+};
+
+int find_native(const char *name, int length) {
+   for (int i = 0; natives[i].name != NULL; ++i) {
+      if (strncmp(natives[i].name, name, length) == 0
+      && natives[i].name[length] == '\0')
+      {
+      return i;
+      }
+   }
+   return -1;
+}
+
+bool int_argument(VM *vm, Value value, int *integer) {
+   if (IS_INT(value) && AS_INT(value) >= INT_MIN && AS_INT(value) <= INT_MAX) {
+      *integer = (int)AS_INT(value);
+      return true;
+   }
+   if (IS_NUMBER(value)) {
+      double number = AS_NUMBER(value);
+      if (number >= INT_MIN && number <= INT_MAX && number == (int)number) {
+         *integer = (int)number;
+         return true;
+      }
+   }
+
+   runtime_error(vm, "Expected an integer");
+   return false;
+}
\ No newline at end of file
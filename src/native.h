@@ -0,0 +1,36 @@
+#ifndef KI_NATIVE_H
+#define KI_NATIVE_H
+
+#include "common.h"
+#include "value.h"
+#include "vm.h"
+
+typedef enum {
+   NATIVE_OK,
+   // the native reported a runtime error
+   NATIVE_ERROR,
+   // the native parked the running fiber with wait_for_fd(), the call
+   // is made again with the same arguments once the fiber is woken up
+   NATIVE_BLOCK
+} NativeResult;
+
+// [args] points to the arguments on the vm stack, the native stores what
+// it returns in [result]
+typedef NativeResult (*NativeFn)(VM *vm, int arg_count, Value *args, Value *result);
+
+typedef struct {
+   const char *name;
+   int arity;
+   NativeFn function;
+} Native;
+
+// Natives are resolved by name at compile time and called by index
+extern const Native natives[];
+
+// index of the native called [name], or -1
+int find_native(const char *name, int length);
+// stores [value] in [integer] if it is a whole number that fits an int,
+// reports a runtime error otherwise
+bool int_argument(VM *vm, Value value, int *integer);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,706 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <locale.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memory.h"
+#include "number.h"
+#include "number_tables.h"
+
+// Grisu3, after Florian Loitsch's "Printing Floating-Point Numbers Quickly
+// and Accurately with Integers"
+// Numbers are handled as a 64 bit significand and a binary exponent, the
+// digits come out of integer arithmetic against a cached power of ten
+// Grisu3 knows when that arithmetic was too imprecise to be sure its
+// digits are the shortest, for those few numbers Grisu2's digits, which
+// always read back but may be a digit too long, are shortened while an
+// exact parse still reads them back
+
+#define SIGNIFICAND_BITS 52
+#define HIDDEN_BIT ((uint64_t)1 << SIGNIFICAND_BITS)
+#define SIGNIFICAND_MASK (HIDDEN_BIT - 1)
+#define EXPONENT_BIAS (1023 + SIGNIFICAND_BITS)
+
+typedef struct {
+   uint64_t f;
+   int e;
+} DiyFp;
+
+// enough 32 bit limbs for any double or shortest decimal, both scaled to
+// integers, 10^309 times 2^1074 at the most
+#define BIG_LIMBS 72
+
+// just enough of an unsigned big integer to compare a decimal with a
+// double exactly
+typedef struct {
+   uint32_t limbs[BIG_LIMBS];
+   int count;
+} BigInt;
+
+static DiyFp diy_fp_from_double(double value);
+static DiyFp normalize(DiyFp x);
+static void normalized_boundaries(DiyFp v, DiyFp *minus, DiyFp *plus);
+static DiyFp multiply(DiyFp a, DiyFp b);
+static DiyFp cached_power(int e, int *k);
+static int grisu2(double value, char *digits, int *k);
+static int generate_digits(DiyFp w, DiyFp plus, uint64_t delta, char *digits, int *k);
+static void round_weed(char *digits, int length, uint64_t delta, uint64_t rest,
+   uint64_t ten_kappa, uint64_t distance);
+static int grisu3(double value, char *digits, int *k);
+static bool generate_digits_checked(DiyFp minus, DiyFp w, DiyFp plus, char *digits,
+   int *length, int *k);
+static bool round_weed_checked(char *digits, int length, uint64_t distance,
+   uint64_t unsafe, uint64_t rest, uint64_t ten_kappa, uint64_t unit);
+static int shorten(double value, char *digits, int length, int *k);
+static bool reads_back(uint64_t mantissa, int exponent, double value);
+static int compare_midpoint(uint64_t mantissa, int exponent, double value);
+static double read_decimal(uint64_t mantissa, int exponent);
+static int compare_exactly(double value, uint64_t mantissa, int exponent);
+static void big_from(BigInt *big, uint64_t value);
+static void big_multiply(BigInt *big, uint32_t factor);
+static void big_shift(BigInt *big, int bits);
+static int big_compare(BigInt *a, BigInt *b);
+static int count_digits(uint32_t n);
+static int prettify(char *buffer, int length, int k);
+static int write_exponent(char *buffer, int exponent);
+static bool eisel_lemire(uint64_t mantissa, int exponent, double *value);
+static double parse_slow(const char *start, int length);
+static void make_c_locale(void);
+static int count_digits64(uint64_t n);
+
+// significant digits that always fit a uint64_t
+#define MAX_FAST_DIGITS 19
+// largest integer every smaller one of which a double holds exactly
+#define MAX_EXACT_INTEGER ((uint64_t)1 << 53)
+
+static const double exact_powers_of_ten[] = {
+   1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static locale_t c_locale;
+static pthread_once_t c_locale_once = PTHREAD_ONCE_INIT;
+
+static const uint64_t powers_of_ten[] = {
+   1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+   10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+   100000000000ull, 1000000000000ull, 10000000000000ull,
+   100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+   100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull,
+};
+
+int format_number(double value, char *buffer) {
+   // keeps what printf("%g") printed for these
+   if (isnan(value) || isinf(value)) {
+      strcpy(buffer, isnan(value) ? "nan" : value < 0 ? "-inf" : "inf");
+      return (int)strlen(buffer);
+   }
+
+   int length = 0;
+   if (signbit(value)) {
+      buffer[length++] = '-';
+      value = -value;
+   }
+   if (value == 0) {
+      buffer[length++] = '0';
+      buffer[length] = '\0';
+      return length;
+   }
+
+   int k;
+   int digits = grisu3(value, buffer + length, &k);
+   if (digits == 0) {
+      digits = grisu2(value, buffer + length, &k);
+      digits = shorten(value, buffer + length, digits, &k);
+   }
+   return length + prettify(buffer + length, digits, k);
+}
+
+static DiyFp diy_fp_from_double(double value) {
+   uint64_t bits;
+   memcpy(&bits, &value, sizeof(bits));
+
+   int biased_e = (int)(bits >> SIGNIFICAND_BITS);
+   uint64_t significand = bits & SIGNIFICAND_MASK;
+   if (biased_e != 0) {
+      return (DiyFp) { significand + HIDDEN_BIT, biased_e - EXPONENT_BIAS };
+   }
+   // subnormal
+   return (DiyFp) { significand, 1 - EXPONENT_BIAS };
+}
+
+static DiyFp normalize(DiyFp x) {
+   int shift = __builtin_clzll(x.f);
+   return (DiyFp) { x.f << shift, x.e - shift };
+}
+
+// the halfway points to the neighbouring doubles, every number between
+// them reads back as [v], [minus] and [plus] share an exponent
+static void normalized_boundaries(DiyFp v, DiyFp *minus, DiyFp *plus) {
+   *plus = normalize((DiyFp) { (v.f << 1) + 1, v.e - 1 });
+
+   // the gap below a power of two is half the one above it
+   if (v.f == HIDDEN_BIT) {
+      *minus = (DiyFp) { (v.f << 2) - 1, v.e - 2 };
+   } else {
+      *minus = (DiyFp) { (v.f << 1) - 1, v.e - 1 };
+   }
+   minus->f <<= minus->e - plus->e;
+   minus->e = plus->e;
+}
+
+// upper 64 bits of the product, rounded
+static DiyFp multiply(DiyFp a, DiyFp b) {
+   unsigned __int128 product = (unsigned __int128)a.f * b.f;
+   uint64_t high = (uint64_t)(product >> 64);
+   uint64_t low = (uint64_t)product;
+   high += low >> 63;
+   return (DiyFp) { high, a.e + b.e + 64 };
+}
+
+// the cached 10^-k that brings a number with binary exponent [e] into
+// the range the digit generation works in
+static DiyFp cached_power(int e, int *k) {
+   // (-61 - e) * log10(2), offset to stay positive so rounding up is a
+   // truncation and an increment
+   double dk = (-61 - e) * 0.30102999566398114 + 347;
+   int ik = (int)dk;
+   if (dk - ik > 0.0) ++ik;
+
+   int index = (ik >> 3) + 1;
+   *k = -(CACHED_POWER_MIN + index * CACHED_POWER_STEP);
+   return (DiyFp) { cached_power_f[index], cached_power_e[index] };
+}
+
+// writes the digits of [value] without a decimal point, the number is
+// digits * 10^k
+static int grisu2(double value, char *digits, int *k) {
+   DiyFp v = diy_fp_from_double(value);
+   DiyFp minus;
+   DiyFp plus;
+   normalized_boundaries(v, &minus, &plus);
+
+   DiyFp c_mk = cached_power(plus.e, k);
+   DiyFp w = multiply(normalize(v), c_mk);
+   DiyFp w_plus = multiply(plus, c_mk);
+   DiyFp w_minus = multiply(minus, c_mk);
+   // stay inside the boundaries despite the rounding of multiply()
+   ++w_minus.f;
+   --w_plus.f;
+
+   return generate_digits(w, w_plus, w_plus.f - w_minus.f, digits, k);
+}
+
+static int generate_digits(DiyFp w, DiyFp plus, uint64_t delta, char *digits, int *k) {
+   DiyFp one = { (uint64_t)1 << -plus.e, plus.e };
+   uint64_t distance = plus.f - w.f;
+   uint32_t integral = (uint32_t)(plus.f >> -one.e);
+   uint64_t fraction = plus.f & (one.f - 1);
+   int kappa = count_digits(integral);
+   int length = 0;
+
+   while (kappa > 0) {
+      uint32_t power = (uint32_t)powers_of_ten[kappa - 1];
+      uint32_t digit = integral / power;
+      integral %= power;
+      if (digit != 0 || length != 0) digits[length++] = (char)('0' + digit);
+      --kappa;
+
+      uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+      if (rest <= delta) {
+         *k += kappa;
+         round_weed(digits, length, delta, rest,
+            powers_of_ten[kappa] << -one.e, distance);
+         return length;
+      }
+   }
+
+   for (;;) {
+      fraction *= 10;
+      delta *= 10;
+      char digit = (char)(fraction >> -one.e);
+      if (digit != 0 || length != 0) digits[length++] = (char)('0' + digit);
+      fraction &= one.f - 1;
+      --kappa;
+
+      if (fraction < delta) {
+         *k += kappa;
+         int index = -kappa;
+         round_weed(digits, length, delta, fraction, one.f,
+            distance * (index < 20 ? powers_of_ten[index] : 0));
+         return length;
+      }
+   }
+}
+
+// moves the last digit towards the exact value while the result stays
+// inside the boundaries
+static void round_weed(char *digits, int length, uint64_t delta, uint64_t rest,
+   uint64_t ten_kappa, uint64_t distance)
+{
+   while (rest < distance && delta - rest >= ten_kappa
+   && (rest + ten_kappa < distance || distance - rest > rest + ten_kappa - distance))
+   {
+   --digits[length - 1];
+   rest += ten_kappa;
+   }
+}
+
+// the shortest digits of [value], the closest of them to it, or 0 if
+// the boundaries were too imprecise to tell
+static int grisu3(double value, char *digits, int *k) {
+   DiyFp v = diy_fp_from_double(value);
+   DiyFp minus;
+   DiyFp plus;
+   normalized_boundaries(v, &minus, &plus);
+
+   DiyFp c_mk = cached_power(plus.e, k);
+   DiyFp w = multiply(normalize(v), c_mk);
+   DiyFp w_plus = multiply(plus, c_mk);
+   DiyFp w_minus = multiply(minus, c_mk);
+
+   int length;
+   if (!generate_digits_checked(w_minus, w, w_plus, digits, &length, k)) return 0;
+   return length;
+}
+
+// the digits of the shortest number in the interval widened by the
+// rounding of multiply(), which is [unit] either way, and whether
+// round_weed_checked() could tell they are also in the exact interval
+static bool generate_digits_checked(DiyFp minus, DiyFp w, DiyFp plus, char *digits,
+   int *length, int *k)
+{
+   uint64_t unit = 1;
+   uint64_t too_low = minus.f - unit;
+   uint64_t too_high = plus.f + unit;
+   uint64_t unsafe = too_high - too_low;
+   DiyFp one = { (uint64_t)1 << -w.e, w.e };
+   uint32_t integral = (uint32_t)(too_high >> -one.e);
+   uint64_t fraction = too_high & (one.f - 1);
+   int kappa = count_digits(integral);
+   *length = 0;
+
+   while (kappa > 0) {
+      uint32_t power = (uint32_t)powers_of_ten[kappa - 1];
+      digits[(*length)++] = (char)('0' + integral / power);
+      integral %= power;
+      --kappa;
+
+      uint64_t rest = ((uint64_t)integral << -one.e) + fraction;
+      if (rest < unsafe) {
+         *k += kappa;
+         return round_weed_checked(digits, *length, too_high - w.f, unsafe, rest,
+            (uint64_t)power << -one.e, unit);
+      }
+   }
+
+   for (;;) {
+      fraction *= 10;
+      unit *= 10;
+      unsafe *= 10;
+      digits[(*length)++] = (char)('0' + (fraction >> -one.e));
+      fraction &= one.f - 1;
+      --kappa;
+
+      if (fraction < unsafe) {
+         *k += kappa;
+         return round_weed_checked(digits, *length, (too_high - w.f) * unit, unsafe,
+            fraction, one.f, unit);
+      }
+   }
+}
+
+// round_weed() with the distances known only to within [unit], false if
+// that leaves it unsure the digits read back or are the closest ones
+static bool round_weed_checked(char *digits, int length, uint64_t distance,
+   uint64_t unsafe, uint64_t rest, uint64_t ten_kappa, uint64_t unit)
+{
+   uint64_t small_distance = distance - unit;
+   uint64_t big_distance = distance + unit;
+   while (rest < small_distance && unsafe - rest >= ten_kappa
+   && (rest + ten_kappa < small_distance
+      || small_distance - rest >= rest + ten_kappa - small_distance))
+   {
+   --digits[length - 1];
+   rest += ten_kappa;
+   }
+
+   // a smaller last digit may still be closer, depending on the error
+   if (rest < big_distance && unsafe - rest >= ten_kappa
+   && (rest + ten_kappa < big_distance
+      || big_distance - rest > rest + ten_kappa - big_distance))
+   {
+      return false;
+   }
+   // and the digits have to be inside the boundaries whatever the error
+   return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+// drops digits from Grisu2's [length] while the number, rounded to one
+// digit less either way, still reads back as [value]
+// The numbers that read back as [value] are an interval holding the
+// digits, so if a shorter one is in it, one of the two roundings is
+static int shorten(double value, char *digits, int length, int *k) {
+   uint64_t mantissa = 0;
+   for (int i = 0; i < length; ++i) mantissa = mantissa * 10 + (uint64_t)(digits[i] - '0');
+
+   int exponent = *k;
+   while (mantissa >= 10) {
+      uint64_t down = mantissa / 10;
+      bool down_reads = reads_back(down, exponent + 1, value);
+      bool up_reads = reads_back(down + 1, exponent + 1, value);
+      if (!down_reads && !up_reads) break;
+
+      // the one nearer [value] when both read back, the even one if
+      // they are as near
+      bool up = !down_reads;
+      if (down_reads && up_reads) {
+         int side = compare_midpoint(down, exponent + 1, value);
+         up = side > 0 || (side == 0 && down % 2 == 1);
+      }
+      mantissa = up ? down + 1 : down;
+      ++exponent;
+   }
+
+   // Grisu2's last digit may be one off the nearest that reads back
+   int side;
+   if (reads_back(mantissa + 1, exponent, value)
+      && ((side = compare_midpoint(mantissa, exponent, value)) > 0
+         || (side == 0 && mantissa % 2 == 1)))
+   {
+      ++mantissa;
+   } else if (mantissa > 1 && reads_back(mantissa - 1, exponent, value)
+      && ((side = compare_midpoint(mantissa - 1, exponent, value)) < 0
+         || (side == 0 && mantissa % 2 == 1)))
+   {
+      --mantissa;
+   }
+
+   *k = exponent;
+   length = count_digits64(mantissa);
+   for (int i = length - 1; i >= 0; --i) {
+      digits[i] = (char)('0' + mantissa % 10);
+      mantissa /= 10;
+   }
+   return length;
+}
+
+// whether [mantissa] * 10^[exponent] is read as [value], exactly
+static bool reads_back(uint64_t mantissa, int exponent, double value) {
+   return read_decimal(mantissa, exponent) == value;
+}
+
+// which side of the midpoint between [mantissa] and [mantissa] + 1, times
+// 10^[exponent], [value] is on, 0 if it is the midpoint
+// Reading is monotonic, so a midpoint read as a smaller double is below
+// [value] and one read as a larger double above it, only one read as
+// [value] itself needs the exact comparison
+static int compare_midpoint(uint64_t mantissa, int exponent, double value) {
+   double midpoint = read_decimal(mantissa * 10 + 5, exponent - 1);
+   if (value != midpoint) return value > midpoint ? 1 : -1;
+   return compare_exactly(value, mantissa * 10 + 5, exponent - 1);
+}
+
+// the double nearest [mantissa] * 10^[exponent]
+static double read_decimal(uint64_t mantissa, int exponent) {
+   double value;
+   if (eisel_lemire(mantissa, exponent, &value)) return value;
+
+   char text[NUMBER_BUFFER_SIZE];
+   int length = format_integer((int64_t)mantissa, text);
+   length += write_exponent(text + length, exponent);
+   return parse_slow(text, length);
+}
+
+// the sign of [value] - [mantissa] * 10^[exponent], both made integers
+// by multiplying them with the same powers of two and five
+static int compare_exactly(double value, uint64_t mantissa, int exponent) {
+   DiyFp v = diy_fp_from_double(value);
+   BigInt a;
+   BigInt b;
+   big_from(&a, v.f);
+   big_from(&b, mantissa);
+
+   // 10^exponent is 5^exponent * 2^exponent, the five goes to whichever
+   // side keeps it an integer
+   BigInt *fives = exponent >= 0 ? &b : &a;
+   for (int i = 0; i < abs(exponent); ++i) big_multiply(fives, 5);
+   int a_twos = v.e - (exponent < 0 ? exponent : 0);
+   int b_twos = exponent > 0 ? exponent : 0;
+   int least = a_twos < b_twos ? a_twos : b_twos;
+   big_shift(&a, a_twos - least);
+   big_shift(&b, b_twos - least);
+   return big_compare(&a, &b);
+}
+
+static void big_from(BigInt *big, uint64_t value) {
+   big->limbs[0] = (uint32_t)value;
+   big->limbs[1] = (uint32_t)(value >> 32);
+   big->count = big->limbs[1] != 0 ? 2 : 1;
+}
+
+static void big_multiply(BigInt *big, uint32_t factor) {
+   uint64_t carry = 0;
+   for (int i = 0; i < big->count; ++i) {
+      uint64_t product = (uint64_t)big->limbs[i] * factor + carry;
+      big->limbs[i] = (uint32_t)product;
+      carry = product >> 32;
+   }
+   if (carry != 0) big->limbs[big->count++] = (uint32_t)carry;
+}
+
+static void big_shift(BigInt *big, int bits) {
+   int limbs = bits / 32;
+   int shift = bits % 32;
+   if (shift != 0) {
+      uint32_t carry = 0;
+      for (int i = 0; i < big->count; ++i) {
+         uint32_t limb = big->limbs[i];
+         big->limbs[i] = limb << shift | carry;
+         carry = limb >> (32 - shift);
+      }
+      if (carry != 0) big->limbs[big->count++] = carry;
+   }
+   if (limbs != 0) {
+      memmove(big->limbs + limbs, big->limbs, sizeof(uint32_t) * big->count);
+      memset(big->limbs, 0, sizeof(uint32_t) * limbs);
+      big->count += limbs;
+   }
+}
+
+static int big_compare(BigInt *a, BigInt *b) {
+   if (a->count != b->count) return a->count > b->count ? 1 : -1;
+   for (int i = a->count - 1; i >= 0; --i) {
+      if (a->limbs[i] != b->limbs[i]) return a->limbs[i] > b->limbs[i] ? 1 : -1;
+   }
+   return 0;
+}
+
+static int count_digits(uint32_t n) {
+   int count = 1;
+   while (count < 10 && n >= powers_of_ten[count]) ++count;
+   return count;
+}
+
+// lays out [length] digits meaning digits * 10^k
+static int prettify(char *buffer, int length, int k) {
+   // position of the decimal point relative to the first digit
+   int point = length + k;
+
+   if (length <= point && point <= 21) {
+      // integer, 1234e3 -> 1234000
+      memset(buffer + length, '0', point - length);
+      buffer[point] = '\0';
+      return point;
+   }
+   if (0 < point && point <= 21) {
+      // 1234e-2 -> 12.34
+      memmove(buffer + point + 1, buffer + point, length - point);
+      buffer[point] = '.';
+      buffer[length + 1] = '\0';
+      return length + 1;
+   }
+   if (-6 < point && point <= 0) {
+      // 1234e-6 -> 0.001234
+      int offset = 2 - point;
+      memmove(buffer + offset, buffer, length);
+      buffer[0] = '0';
+      buffer[1] = '.';
+      memset(buffer + 2, '0', offset - 2);
+      buffer[length + offset] = '\0';
+      return length + offset;
+   }
+
+   // 1234e30 -> 1.234e+33
+   int written = 1;
+   if (length > 1) {
+      memmove(buffer + 2, buffer + 1, length - 1);
+      buffer[1] = '.';
+      written = length + 1;
+   }
+   return written + write_exponent(buffer + written, point - 1);
+}
+
+static int write_exponent(char *buffer, int exponent) {
+   int length = 0;
+   buffer[length++] = 'e';
+   buffer[length++] = exponent < 0 ? '-' : '+';
+   if (exponent < 0) exponent = -exponent;
+
+   if (exponent >= 100) buffer[length++] = (char)('0' + exponent / 100);
+   if (exponent >= 10) buffer[length++] = (char)('0' + exponent / 10 % 10);
+   buffer[length++] = (char)('0' + exponent % 10);
+   buffer[length] = '\0';
+   return length;
+}
+
+bool parse_number(const char *start, int length, double *value) {
+   const char *end = start + length;
+   const char *c = start;
+   uint64_t mantissa = 0;
+   int digits = 0;
+   int exponent = 0;
+
+   while (c < end && *c >= '0' && *c <= '9') {
+      mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+      if (mantissa != 0) ++digits;
+      ++c;
+   }
+   if (c == start) return false;
+
+   if (c < end && *c == '.') {
+      const char *fraction = ++c;
+      while (c < end && *c >= '0' && *c <= '9') {
+         mantissa = mantissa * 10 + (uint64_t)(*c - '0');
+         if (mantissa != 0) ++digits;
+         ++c;
+      }
+      if (c == fraction) return false;
+      exponent = -(int)(c - fraction);
+   }
+   if (c != end) return false;
+
+   // the mantissa overflowed, too rare to be worth more than strtod
+   if (digits > MAX_FAST_DIGITS) {
+      *value = parse_slow(start, length);
+      return true;
+   }
+
+   // integers and the like, a single exactly rounded operation
+   if (mantissa <= MAX_EXACT_INTEGER) {
+      if (exponent == 0) {
+         *value = (double)mantissa;
+         return true;
+      }
+      if (exponent >= -22) {
+         *value = (double)mantissa / exact_powers_of_ten[-exponent];
+         return true;
+      }
+   }
+
+   if (eisel_lemire(mantissa, exponent, value)) return true;
+
+   *value = parse_slow(start, length);
+   return true;
+}
+
+// Daniel Lemire's "Number Parsing at a Gigabyte per Second", after
+// Michael Eisel's algorithm: [mantissa] * 10^[exponent] from a 128 bit
+// product with the truncated power of ten
+// Returns false in the rare cases the product is too close to call
+static bool eisel_lemire(uint64_t mantissa, int exponent, double *value) {
+   if (mantissa == 0) {
+      *value = 0;
+      return true;
+   }
+   if (exponent < WIDE_POWER_MIN || exponent > WIDE_POWER_MAX) return false;
+
+   const uint64_t *power = wide_powers[exponent - WIDE_POWER_MIN];
+   int shift = __builtin_clzll(mantissa);
+   mantissa <<= shift;
+   // floor(exponent * log2(10)) + 64 + the bias, less the normalization
+   uint64_t binary_exponent =
+      (uint64_t)(((217706 * exponent) >> 16) + 64 + 1023) - (uint64_t)shift;
+
+   unsigned __int128 product = (unsigned __int128)mantissa * power[0];
+   uint64_t high = (uint64_t)(product >> 64);
+   uint64_t low = (uint64_t)product;
+
+   // the truncated half of the power may still carry into the bits kept
+   if ((high & 0x1ff) == 0x1ff && low + mantissa < mantissa) {
+      unsigned __int128 wider = (unsigned __int128)mantissa * power[1];
+      uint64_t wider_high = (uint64_t)(wider >> 64);
+      uint64_t merged_low = low + wider_high;
+      if (merged_low < low) ++high;
+      if ((high & 0x1ff) == 0x1ff && merged_low + 1 == 0
+      && (uint64_t)wider + mantissa < mantissa)
+      {
+      return false;
+      }
+      low = merged_low;
+   }
+
+   // keep 54 bits, one more than the double has to round with
+   uint64_t top = high >> 63;
+   uint64_t result = high >> (top + 9);
+   binary_exponent -= 1 ^ top;
+
+   // exactly halfway between two doubles, rounding to even needs the
+   // exact product
+   if (low == 0 && (high & 0x1ff) == 0 && (result & 3) == 1) return false;
+
+   result += result & 1;
+   result >>= 1;
+   if (result >> 53 != 0) {
+      result >>= 1;
+      ++binary_exponent;
+   }
+
+   // subnormal, infinite, or beyond
+   if (binary_exponent - 1 >= 0x7ff - 1) return false;
+
+   uint64_t bits = binary_exponent << SIGNIFICAND_BITS | (result & SIGNIFICAND_MASK);
+   memcpy(value, &bits, sizeof(bits));
+   return true;
+}
+
+// strtod in the "C" locale, the token isn't terminated so it is copied
+static double parse_slow(const char *start, int length) {
+   pthread_once(&c_locale_once, make_c_locale);
+
+   char *copy = ALLOCATE(char, length + 1);
+   memcpy(copy, start, length);
+   copy[length] = '\0';
+   double value = strtod_l(copy, NULL, c_locale);
+   FREE_ARRAY(copy, char, length + 1);
+   return value;
+}
+
+static void make_c_locale(void) {
+   c_locale = newlocale(LC_ALL_MASK, "C", (locale_t)0);
+}
+
+int format_integer(int64_t value, char *buffer) {
+   int length = 0;
+   // negated unsigned so INT64_MIN works too
+   uint64_t magnitude = (uint64_t)value;
+   if (value < 0) {
+      buffer[length++] = '-';
+      magnitude = 0 - magnitude;
+   }
+
+   length += count_digits64(magnitude);
+   buffer[length] = '\0';
+   char *digit = buffer + length;
+   do {
+      *--digit = (char)('0' + magnitude % 10);
+      magnitude /= 10;
+   } while (magnitude != 0);
+   return length;
+}
+
+bool parse_integer(const char *start, int length, int64_t *value) {
+   if (length == 0) return false;
+
+   uint64_t result = 0;
+   for (int i = 0; i < length; ++i) {
+      unsigned digit = (unsigned)(start[i] - '0');
+      if (digit > 9) return false;
+      if (result > ((uint64_t)INT64_MAX - digit) / 10) return false;
+      result = result * 10 + digit;
+   }
+
+   *value = (int64_t)result;
+   return true;
+}
+
+static int count_digits64(uint64_t n) {
+   int count = 1;
+   while (count < 20 && n >= powers_of_ten[count]) ++count;
+   return count;
+}
\ No newline at end of file
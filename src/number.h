@@ -0,0 +1,27 @@
+#ifndef KI_NUMBER_H
+#define KI_NUMBER_H
+
+#include "common.h"
+
+// enough for any double format_number() writes, plus the terminator
+#define NUMBER_BUFFER_SIZE 32
+
+// Writes the shortest decimal form of [value] that reads back as the
+// same double, without going through printf
+// Integers print without a fraction and very large or small magnitudes
+// use an exponent, like 1e+21 or 5e-7
+// Returns the number of characters written, [buffer] is terminated
+int format_number(double value, char *buffer);
+// Reads the [length] characters at [start], digits with an optional
+// fraction like the scanner's number tokens, into the nearest double
+// Exact and independent of the locale, only unusually long literals
+// leave the fast paths
+// Returns false if the characters aren't such a number
+bool parse_number(const char *start, int length, double *value);
+// Writes [value] in decimal, returns the number of characters written
+int format_integer(int64_t value, char *buffer);
+// Reads the [length] digits at [start] into [value]
+// Returns false if they aren't all digits or don't fit an int64_t
+bool parse_integer(const char *start, int length, int64_t *value);
+
+#endif
\ No newline at end of file
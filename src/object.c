@@ -1,19 +1,35 @@
-#include <stdio.h>
 #include <string.h>
 
+#include "channel.h"
+#include "intern.h"
 #include "object.h"
 #include "memory.h"
 #include "table.h"
 
 static ObjString* allocate_string(VM *vm, char *chars, int length, uint32_t hash);
-static uint32_t hash_string(const char *key, int length);
+static ObjString* find_interned(VM *vm, const char *chars, int length, uint32_t hash);
+static Obj* link_object(VM *vm, Obj *object, size_t size, ObjType type);
 
 #define ALLOCATE_OBJ(vm, type, object_type) \
    (type*)allocate_object(vm, sizeof(type), object_type)
+// NULL if the object can't be allocated, see try_reallocate()
+#define TRY_ALLOCATE_OBJ(vm, type, object_type) \
+   (type*)try_allocate_object(vm, sizeof(type), object_type)
 
 static Obj* allocate_object(VM *vm, size_t size, ObjType type) {
-   Obj *object = (Obj*)reallocate(NULL, 0, size);
+   return link_object(vm, (Obj*)reallocate(NULL, 0, size), size, type);
+}
+
+static Obj* try_allocate_object(VM *vm, size_t size, ObjType type) {
+   Obj *object = (Obj*)try_reallocate(NULL, 0, size);
+   if (object == NULL) return NULL;
+   return link_object(vm, object, size, type);
+}
+
+static Obj* link_object(VM *vm, Obj *object, size_t size, ObjType type) {
+   count_object(type, size);
    object->type = type;
+   object->is_frozen = false;
 
    object->next = vm->objects;
    vm->objects = object;
@@ -22,7 +38,7 @@ static Obj* allocate_object(VM *vm, size_t size, ObjType type) {
 
 ObjString* take_string(VM *vm, char *chars, int length) {
    uint32_t hash = hash_string(chars, length);
-   ObjString *interned = table_find_string(&vm->strings, chars, length, hash);
+   ObjString *interned = find_interned(vm, chars, length, hash);
    if (interned != NULL) {
       // we don't need a new string, it already exists in our strings collection
       // and since we own the string we can safely free it
@@ -35,7 +51,7 @@ ObjString* take_string(VM *vm, char *chars, int length) {
 
 ObjString* copy_string(VM *vm, const char *chars, int length) {
    uint32_t hash = hash_string(chars, length);
-   ObjString *interned = table_find_string(&vm->strings, chars, length, hash);
+   ObjString *interned = find_interned(vm, chars, length, hash);
    if (interned != NULL) return interned;
 
    char *heap_chars = ALLOCATE(char, length + 1);
@@ -45,11 +61,107 @@ ObjString* copy_string(VM *vm, const char *chars, int length) {
    return allocate_string(vm, heap_chars, length, hash);
 }
 
+SharedChars* share_string(ObjString *string) {
+   if (string->shared == NULL) {
+      SharedChars *shared = ALLOCATE(SharedChars, 1);
+      atomic_init(&shared->refs, 1);
+      shared->length = string->length;
+      shared->hash = string->hash;
+      shared->chars = string->chars;
+      string->shared = shared;
+   }
+
+   atomic_fetch_add(&string->shared->refs, 1);
+   return string->shared;
+}
+
+void release_shared_chars(SharedChars *shared) {
+   if (atomic_fetch_sub(&shared->refs, 1) != 1) return;
+
+   FREE_ARRAY(shared->chars, char, shared->length + 1);
+   FREE(SharedChars, shared);
+}
+
+ObjString* string_from_shared(VM *vm, SharedChars *shared) {
+   ObjString *interned = find_interned(vm, shared->chars, shared->length, shared->hash);
+   if (interned != NULL) {
+      release_shared_chars(shared);
+      return interned;
+   }
+
+   ObjString *string = allocate_string(vm, shared->chars, shared->length, shared->hash);
+   string->shared = shared;
+   return string;
+}
+
+ObjChannel* new_channel_object(VM *vm, Channel *channel) {
+   ObjChannel *object = ALLOCATE_OBJ(vm, ObjChannel, OBJ_CHANNEL);
+   object->channel = channel;
+   return object;
+}
+
+ObjList* new_list(VM *vm, int capacity) {
+   // the items come first, a list that would go over the limit isn't made
+   Value *values = NULL;
+   if (capacity > 0) {
+      values = TRY_ALLOCATE(Value, capacity);
+      if (values == NULL) return NULL;
+   }
+
+   ObjList *list = TRY_ALLOCATE_OBJ(vm, ObjList, OBJ_LIST);
+   if (list == NULL) {
+      FREE_ARRAY(values, Value, capacity);
+      return NULL;
+   }
+   init_value_array(&list->items);
+   list->items.values = values;
+   list->items.capacity = capacity;
+   return list;
+}
+
+ObjSlice* new_slice(VM *vm, Value text, int start, int length) {
+   ObjString *parent = IS_STRING(text) ? AS_STRING(text) : AS_SLICE(text)->parent;
+   if (IS_SLICE(text)) start += AS_SLICE(text)->start;
+
+   ObjSlice *slice = TRY_ALLOCATE_OBJ(vm, ObjSlice, OBJ_SLICE);
+   if (slice == NULL) return NULL;
+   slice->parent = parent;
+   slice->start = start;
+   slice->length = length;
+   slice->materialized = NULL;
+   return slice;
+}
+
+ObjMap* new_map(VM *vm) {
+   ObjMap *map = ALLOCATE_OBJ(vm, ObjMap, OBJ_MAP);
+   init_value_table(&map->table);
+   return map;
+}
+
+ObjString* text_string(VM *vm, Value text) {
+   if (IS_STRING(text)) return AS_STRING(text);
+
+   ObjSlice *slice = AS_SLICE(text);
+   if (slice->materialized == NULL) {
+      slice->materialized = copy_string(vm, text_chars(text), slice->length);
+   }
+   return slice->materialized;
+}
+
+bool texts_equal(Value a, Value b) {
+   // interned, the same characters are the same string
+   if (IS_STRING(a) && IS_STRING(b)) return AS_STRING(a) == AS_STRING(b);
+
+   return text_length(a) == text_length(b)
+      && memcmp(text_chars(a), text_chars(b), text_length(a)) == 0;
+}
+
 static ObjString* allocate_string(VM *vm, char *chars, int length, uint32_t hash) {
    ObjString *string = ALLOCATE_OBJ(vm, ObjString, OBJ_STRING);
    string->length = length;
    string->chars = chars;
    string->hash = hash;
+   string->shared = NULL;
 
    // we only care about the keys, so we set the values to nil
    // more like a hash set than a hash table
@@ -58,7 +170,15 @@ static ObjString* allocate_string(VM *vm, char *chars, int length, uint32_t hash
    return string;
 }
 
-static uint32_t hash_string(const char *key, int length) {
+// looks in the shared base set first so every vm ends up with the same
+// pointer for a base string
+static ObjString* find_interned(VM *vm, const char *chars, int length, uint32_t hash) {
+   ObjString *interned = find_base_string(chars, length, hash);
+   if (interned != NULL) return interned;
+   return table_find_string(&vm->strings, chars, length, hash);
+}
+
+uint32_t hash_string(const char *key, int length) {
    // FNV-1a hashing algorithm
    uint32_t hash = 2166136261u;
    for (int i = 0; i < length; ++i) {
@@ -69,10 +189,45 @@ static uint32_t hash_string(const char *key, int length) {
    return hash;
 }
 
-void print_obj(Value value) {
+void write_obj(Output *output, Value value) {
    switch(OBJ_TYPE(value)) {
    case OBJ_STRING:
-      printf("%s", AS_CSTRING(value));
+      output_write(output, AS_CSTRING(value), AS_STRING(value)->length);
+      break;
+   case OBJ_CHANNEL: {
+      const char *name = AS_CHANNEL(value)->channel->name;
+      output_write(output, "<channel ", 9);
+      output_write(output, name, strlen(name));
+      output_char(output, '>');
       break;
    }
+   case OBJ_LIST: {
+      ValueArray *items = &AS_LIST(value)->items;
+      output_char(output, '[');
+      for (int i = 0; i < items->count; ++i) {
+         if (i > 0) output_write(output, ", ", 2);
+         write_value(output, items->values[i]);
+      }
+      output_char(output, ']');
+      break;
+   }
+   case OBJ_SLICE:
+      output_write(output, text_chars(value), text_length(value));
+      break;
+   case OBJ_MAP: {
+      ValueTable *table = &AS_MAP(value)->table;
+      bool first = true;
+      output_char(output, '{');
+      for (int i = 0; i < table->used; ++i) {
+         if (table->entries[i].deleted) continue;
+         if (!first) output_write(output, ", ", 2);
+         first = false;
+         write_value(output, table->entries[i].key);
+         output_write(output, ": ", 2);
+         write_value(output, table->entries[i].value);
+      }
+      output_char(output, '}');
+      break;
+   }
+   }
 }
\ No newline at end of file
@@ -1,42 +1,143 @@
 #ifndef KI_OBJECT_H
 #define KI_OBJECT_H
 
+#include <stdatomic.h>
+
 #include "common.h"
 #include "vm.h"
 #include "value.h"
+#include "value_table.h"
 
 typedef enum {
-   OBJ_STRING
+   OBJ_STRING,
+   OBJ_CHANNEL,
+   OBJ_LIST,
+   OBJ_SLICE,
+   OBJ_MAP
 } ObjType;
 
 struct sObj {
    ObjType type;
+   // frozen objects are owned by the process rather than a vm and never
+   // change, so any vm on any thread may use them
+   bool is_frozen;
    struct sObj *next;
 };
 
+// String characters shared between vms
+// Whichever string drops the last reference frees them
+typedef struct {
+   atomic_int refs;
+   int length;
+   uint32_t hash;
+   char *chars;
+} SharedChars;
+
 struct sObjString {
    Obj obj;
    int length;
    char *chars;
    uint32_t hash;
+   // when set, [chars] belongs to it rather than to the string
+   SharedChars *shared;
 };
 
+typedef struct sChannel Channel;
+
+// a vm's handle on a channel shared between vms
+typedef struct {
+   Obj obj;
+   Channel *channel;
+} ObjChannel;
+
+// a growable array of values, stored contiguously
+typedef struct {
+   Obj obj;
+   ValueArray items;
+} ObjList;
+
+// Part of a string, made without copying its characters
+// Slices read and print like strings but aren't interned, an interned
+// copy is only made when something needs a real string, like a native
+// taking a path or a channel sending it
+typedef struct {
+   Obj obj;
+   // always a string, a slice of a slice points into the same one
+   ObjString *parent;
+   int start;
+   int length;
+   // the copy, once one was needed
+   ObjString *materialized;
+} ObjSlice;
+
+typedef struct {
+   Obj obj;
+   ValueTable table;
+} ObjMap;
+
 #define OBJ_TYPE(value) (AS_OBJ(value)->type)
 
 // using a function because [value] is used twice (in function) thus if 
 // we wrote it here directly it will result in evaluating the [value]
 // expression twice!
 #define IS_STRING(value) is_obj_type(value, OBJ_STRING)
+#define IS_CHANNEL(value) is_obj_type(value, OBJ_CHANNEL)
+#define IS_LIST(value) is_obj_type(value, OBJ_LIST)
+#define IS_SLICE(value) is_obj_type(value, OBJ_SLICE)
+#define IS_MAP(value) is_obj_type(value, OBJ_MAP)
+// strings and slices
+#define IS_TEXT(value) (IS_STRING(value) || IS_SLICE(value))
 
 #define AS_STRING(value) ((ObjString *)AS_OBJ(value))
 #define AS_CSTRING(value) AS_STRING(value)->chars
+#define AS_CHANNEL(value) ((ObjChannel *)AS_OBJ(value))
+#define AS_LIST(value) ((ObjList *)AS_OBJ(value))
+#define AS_SLICE(value) ((ObjSlice *)AS_OBJ(value))
+#define AS_MAP(value) ((ObjMap *)AS_OBJ(value))
 
 static inline bool is_obj_type(Value value, ObjType type) {
    return IS_OBJ(value) && AS_OBJ(value)->type == type;
 }
 
+// the characters of a string or slice, not terminated for slices
+static inline const char* text_chars(Value text) {
+   if (IS_STRING(text)) return AS_STRING(text)->chars;
+   return AS_SLICE(text)->parent->chars + AS_SLICE(text)->start;
+}
+
+static inline int text_length(Value text) {
+   if (IS_STRING(text)) return AS_STRING(text)->length;
+   return AS_SLICE(text)->length;
+}
+
+uint32_t hash_string(const char *key, int length);
 ObjString* take_string(VM *vm, char *chars, int length);
 ObjString* copy_string(VM *vm, const char *chars, int length);
-void print_obj(Value value);
+// hands the string's characters over to shared storage, if they aren't
+// already, and returns a new reference to it
+// no bytes are copied
+SharedChars* share_string(ObjString *string);
+void release_shared_chars(SharedChars *shared);
+// interns shared characters in [vm] without copying them
+// takes over the caller's reference
+ObjString* string_from_shared(VM *vm, SharedChars *shared);
+// takes over the caller's reference to [channel]
+ObjChannel* new_channel_object(VM *vm, Channel *channel);
+// an empty list with room for [capacity] items, or NULL if it can't be
+// allocated, see try_reallocate()
+ObjList* new_list(VM *vm, int capacity);
+// [length] characters of the string or slice [text] from [start] on, or
+// NULL if the slice can't be allocated
+ObjSlice* new_slice(VM *vm, Value text, int start, int length);
+// the string [text] is, or the interned copy of the slice it is
+ObjString* text_string(VM *vm, Value text);
+// whether two strings or slices hold the same characters
+bool texts_equal(Value a, Value b);
+ObjMap* new_map(VM *vm);
+// [value] as a map key, slices are keyed by their interned copy
+static inline Value map_key(VM *vm, Value value) {
+   return IS_SLICE(value) ? OBJ_VAL(text_string(vm, value)) : value;
+}
+void write_obj(Output *output, Value value);
 
 #endif
\ No newline at end of file
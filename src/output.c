@@ -0,0 +1,139 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "output.h"
+
+static void write_to_sink(Output *output, const char *chars, size_t length);
+
+void init_output(Output *output) {
+   output->type = SINK_FD;
+   output->fd = STDOUT_FILENO;
+   output->callback = NULL;
+   output->context = NULL;
+   output->memory = NULL;
+   output->memory_length = 0;
+   output->memory_capacity = 0;
+   output->length = 0;
+}
+
+void free_output(Output *output) {
+   flush_output(output);
+   FREE_ARRAY(output->memory, char, output->memory_capacity);
+   output->memory = NULL;
+   output->memory_length = 0;
+   output->memory_capacity = 0;
+}
+
+void output_to_fd(Output *output, int fd) {
+   flush_output(output);
+   output->type = SINK_FD;
+   output->fd = fd;
+}
+
+void output_to_memory(Output *output) {
+   flush_output(output);
+   output->type = SINK_MEMORY;
+}
+
+void output_to_callback(Output *output, OutputFn callback, void *context) {
+   flush_output(output);
+   output->type = SINK_CALLBACK;
+   output->callback = callback;
+   output->context = context;
+}
+
+void output_write(Output *output, const char *chars, size_t length) {
+   if (output->length + length > OUTPUT_BUFFER_SIZE) {
+      flush_output(output);
+      // too big to be worth copying
+      if (length > OUTPUT_BUFFER_SIZE / 2) {
+         write_to_sink(output, chars, length);
+         return;
+      }
+   }
+
+   memcpy(output->buffer + output->length, chars, length);
+   output->length += (int)length;
+}
+
+void output_char(Output *output, char c) {
+   if (output->length == OUTPUT_BUFFER_SIZE) flush_output(output);
+   output->buffer[output->length++] = c;
+}
+
+void output_format(Output *output, const char *format, ...) {
+   va_list args;
+   va_start(args, format);
+   int room = OUTPUT_BUFFER_SIZE - output->length;
+   int length = vsnprintf(output->buffer + output->length, room, format, args);
+   va_end(args);
+   if (length < room) {
+      output->length += length;
+      return;
+   }
+
+   // didn't fit, flush and try again
+   flush_output(output);
+   va_start(args, format);
+   if (length < OUTPUT_BUFFER_SIZE) {
+      output->length = vsnprintf(output->buffer, OUTPUT_BUFFER_SIZE, format, args);
+   } else {
+      char *chars = ALLOCATE(char, length + 1);
+      vsnprintf(chars, length + 1, format, args);
+      write_to_sink(output, chars, length);
+      FREE_ARRAY(chars, char, length + 1);
+   }
+   va_end(args);
+}
+
+void flush_output(Output *output) {
+   if (output->length == 0) return;
+   write_to_sink(output, output->buffer, output->length);
+   output->length = 0;
+}
+
+const char* output_contents(Output *output, size_t *length) {
+   flush_output(output);
+   *length = output->memory_length;
+   return output->memory;
+}
+
+static void write_to_sink(Output *output, const char *chars, size_t length) {
+   switch (output->type) {
+   case SINK_FD:
+      // anything printed through stdio so far goes first
+      if (output->fd == STDOUT_FILENO) fflush(stdout);
+      while (length > 0) {
+         ssize_t written = write(output->fd, chars, length);
+         if (written < 0) {
+            if (errno == EINTR) continue;
+            // nowhere left to report it, the output is dropped like
+            // printf would
+            return;
+         }
+         chars += written;
+         length -= written;
+      }
+      break;
+   case SINK_MEMORY:
+      if (output->memory_length + length > output->memory_capacity) {
+         size_t old_capacity = output->memory_capacity;
+         size_t capacity = GROW_CAPACITY(old_capacity);
+         while (capacity < output->memory_length + length) {
+            capacity = GROW_CAPACITY(capacity);
+         }
+         output->memory = GROW_ARRAY(output->memory, char, old_capacity, capacity);
+         output->memory_capacity = capacity;
+      }
+      memcpy(output->memory + output->memory_length, chars, length);
+      output->memory_length += length;
+      break;
+   case SINK_CALLBACK:
+      output->callback(output->context, chars, length);
+      break;
+   }
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef KI_OUTPUT_H
+#define KI_OUTPUT_H
+
+#include "common.h"
+
+#define OUTPUT_BUFFER_SIZE 8192
+
+typedef enum {
+   // written to a file descriptor
+   SINK_FD,
+   // collected in memory, read back with output_contents()
+   SINK_MEMORY,
+   // handed to a function
+   SINK_CALLBACK
+} SinkType;
+
+typedef void (*OutputFn)(void *context, const char *chars, size_t length);
+
+// Where a vm's printed output ends up
+// Writes are buffered and reach the sink when the buffer fills up or on
+// flush_output(), which the vm calls when a script ends, before
+// reporting an error and before it blocks
+typedef struct {
+   SinkType type;
+   int fd;
+   OutputFn callback;
+   void *context;
+   // everything flushed so far, for SINK_MEMORY
+   char *memory;
+   size_t memory_length;
+   size_t memory_capacity;
+   int length;
+   char buffer[OUTPUT_BUFFER_SIZE];
+} Output;
+
+// starts out writing to standard output
+void init_output(Output *output);
+// flushes and releases the memory sink's contents
+void free_output(Output *output);
+void output_to_fd(Output *output, int fd);
+void output_to_memory(Output *output);
+void output_to_callback(Output *output, OutputFn callback, void *context);
+void output_write(Output *output, const char *chars, size_t length);
+void output_char(Output *output, char c);
+// printf into the buffer
+void output_format(Output *output, const char *format, ...);
+void flush_output(Output *output);
+// what a memory sink collected, flushed first, not terminated
+const char* output_contents(Output *output, size_t *length);
+
+#endif
\ No newline at end of file
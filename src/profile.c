@@ -0,0 +1,188 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "debug.h"
+#include "memory.h"
+#include "profile.h"
+
+#define REPORT_LINES 20
+#define REPORT_PAIRS 20
+
+typedef struct {
+   int first;
+   int second;
+   uint64_t count;
+} Pair;
+
+static int sort_lines(Profile *profile, int *lines);
+static int sort_pairs(Profile *profile, Pair *pairs);
+static int compare_counters(const void *a, const void *b);
+static int compare_pairs(const void *a, const void *b);
+static double percent(uint64_t part, uint64_t whole);
+
+// the counters qsort compares through the indices it sorts
+static ProfileCounter *sorted_counters;
+
+void init_profile(Profile *profile) {
+   memset(profile->opcodes, 0, sizeof(profile->opcodes));
+   memset(profile->pairs, 0, sizeof(profile->pairs));
+   profile->lines = NULL;
+   profile->line_capacity = 0;
+   profile->last_opcode = -1;
+   profile->last_line = 0;
+   profile->last_tick = 0;
+}
+
+void free_profile(Profile *profile) {
+   FREE_ARRAY(profile->lines, ProfileCounter, profile->line_capacity);
+   init_profile(profile);
+}
+
+void profile_start(Profile *profile) {
+   profile->last_opcode = -1;
+}
+
+void profile_stop(Profile *profile) {
+   if (profile->last_opcode < 0) return;
+
+   uint64_t ticks = profile_ticks() - profile->last_tick;
+   profile->opcodes[profile->last_opcode].ticks += ticks;
+   profile->lines[profile->last_line].ticks += ticks;
+   profile->last_opcode = -1;
+}
+
+void grow_profile_lines(Profile *profile, int line) {
+   int old_capacity = profile->line_capacity;
+   int capacity = GROW_CAPACITY(old_capacity);
+   while (capacity <= line) capacity *= 2;
+
+   profile->lines = GROW_ARRAY(profile->lines, ProfileCounter, old_capacity, capacity);
+   memset(profile->lines + old_capacity, 0, sizeof(ProfileCounter) * (capacity - old_capacity));
+   profile->line_capacity = capacity;
+}
+
+void write_profile_report(Profile *profile, FILE *file) {
+   uint64_t count = 0;
+   uint64_t ticks = 0;
+   int opcodes[OPCODE_COUNT];
+   for (int i = 0; i < OPCODE_COUNT; ++i) {
+      opcodes[i] = i;
+      count += profile->opcodes[i].count;
+      ticks += profile->opcodes[i].ticks;
+   }
+   sorted_counters = profile->opcodes;
+   qsort(opcodes, OPCODE_COUNT, sizeof(int), compare_counters);
+
+   fprintf(file, "%-16s %14s %7s %16s %7s %10s\n", "opcode", "count", "%",
+      PROFILE_TICK_UNIT, "%", "per op");
+   for (int i = 0; i < OPCODE_COUNT; ++i) {
+      ProfileCounter *counter = &profile->opcodes[opcodes[i]];
+      if (counter->count == 0) continue;
+      fprintf(file, "%-16s %14llu %6.2f%% %16llu %6.2f%% %10.1f\n", opcode_name(opcodes[i]),
+         (unsigned long long)counter->count, percent(counter->count, count),
+         (unsigned long long)counter->ticks, percent(counter->ticks, ticks),
+         (double)counter->ticks / counter->count);
+   }
+   fprintf(file, "%-16s %14llu %7s %16llu\n", "total", (unsigned long long)count, "",
+      (unsigned long long)ticks);
+
+   int *lines = ALLOCATE(int, profile->line_capacity);
+   int line_count = sort_lines(profile, lines);
+   fprintf(file, "\n%-16s %14s %7s %16s %7s\n", "line", "count", "%", PROFILE_TICK_UNIT, "%");
+   for (int i = 0; i < line_count && i < REPORT_LINES; ++i) {
+      ProfileCounter *counter = &profile->lines[lines[i]];
+      fprintf(file, "%-16d %14llu %6.2f%% %16llu %6.2f%%\n", lines[i],
+         (unsigned long long)counter->count, percent(counter->count, count),
+         (unsigned long long)counter->ticks, percent(counter->ticks, ticks));
+   }
+   FREE_ARRAY(lines, int, profile->line_capacity);
+
+   Pair *pairs = ALLOCATE(Pair, OPCODE_COUNT * OPCODE_COUNT);
+   int pair_count = sort_pairs(profile, pairs);
+   fprintf(file, "\n%-33s %14s %7s\n", "opcode pair", "count", "%");
+   for (int i = 0; i < pair_count && i < REPORT_PAIRS; ++i) {
+      fprintf(file, "%-16s %-16s %14llu %6.2f%%\n", opcode_name(pairs[i].first),
+         opcode_name(pairs[i].second), (unsigned long long)pairs[i].count,
+         percent(pairs[i].count, count));
+   }
+   FREE_ARRAY(pairs, Pair, OPCODE_COUNT * OPCODE_COUNT);
+}
+
+void write_profile_json(Profile *profile, FILE *file) {
+   fprintf(file, "{\n   \"tick_unit\": \"%s\",\n   \"opcodes\": [", PROFILE_TICK_UNIT);
+   bool first = true;
+   for (int i = 0; i < OPCODE_COUNT; ++i) {
+      ProfileCounter *counter = &profile->opcodes[i];
+      if (counter->count == 0) continue;
+      fprintf(file, "%s\n      { \"name\": \"%s\", \"count\": %llu, \"ticks\": %llu }",
+         first ? "" : ",", opcode_name(i), (unsigned long long)counter->count,
+         (unsigned long long)counter->ticks);
+      first = false;
+   }
+
+   fprintf(file, "\n   ],\n   \"lines\": [");
+   first = true;
+   for (int i = 0; i < profile->line_capacity; ++i) {
+      ProfileCounter *counter = &profile->lines[i];
+      if (counter->count == 0) continue;
+      fprintf(file, "%s\n      { \"line\": %d, \"count\": %llu, \"ticks\": %llu }",
+         first ? "" : ",", i, (unsigned long long)counter->count,
+         (unsigned long long)counter->ticks);
+      first = false;
+   }
+
+   fprintf(file, "\n   ],\n   \"pairs\": [");
+   Pair *pairs = ALLOCATE(Pair, OPCODE_COUNT * OPCODE_COUNT);
+   int pair_count = sort_pairs(profile, pairs);
+   for (int i = 0; i < pair_count; ++i) {
+      fprintf(file, "%s\n      { \"first\": \"%s\", \"second\": \"%s\", \"count\": %llu }",
+         i == 0 ? "" : ",", opcode_name(pairs[i].first), opcode_name(pairs[i].second),
+         (unsigned long long)pairs[i].count);
+   }
+   FREE_ARRAY(pairs, Pair, OPCODE_COUNT * OPCODE_COUNT);
+   fprintf(file, "\n   ]\n}\n");
+}
+
+// the lines that ran, slowest first
+static int sort_lines(Profile *profile, int *lines) {
+   int count = 0;
+   for (int i = 0; i < profile->line_capacity; ++i) {
+      if (profile->lines[i].count > 0) lines[count++] = i;
+   }
+   if (count == 0) return 0;
+   sorted_counters = profile->lines;
+   qsort(lines, count, sizeof(int), compare_counters);
+   return count;
+}
+
+// the pairs that ran, most frequent first
+static int sort_pairs(Profile *profile, Pair *pairs) {
+   int count = 0;
+   for (int first = 0; first < OPCODE_COUNT; ++first) {
+      for (int second = 0; second < OPCODE_COUNT; ++second) {
+         if (profile->pairs[first][second] == 0) continue;
+         pairs[count++] = (Pair){ first, second, profile->pairs[first][second] };
+      }
+   }
+   qsort(pairs, count, sizeof(Pair), compare_pairs);
+   return count;
+}
+
+static int compare_counters(const void *a, const void *b) {
+   uint64_t ticks_a = sorted_counters[*(const int *)a].ticks;
+   uint64_t ticks_b = sorted_counters[*(const int *)b].ticks;
+   if (ticks_a != ticks_b) return ticks_a < ticks_b ? 1 : -1;
+   return *(const int *)a - *(const int *)b;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+   const Pair *pair_a = (const Pair *)a;
+   const Pair *pair_b = (const Pair *)b;
+   if (pair_a->count != pair_b->count) return pair_a->count < pair_b->count ? 1 : -1;
+   if (pair_a->first != pair_b->first) return pair_a->first - pair_b->first;
+   return pair_a->second - pair_b->second;
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+   return whole == 0 ? 0.0 : 100.0 * part / whole;
+}
\ No newline at end of file
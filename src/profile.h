@@ -0,0 +1,82 @@
+#ifndef KI_PROFILE_H
+#define KI_PROFILE_H
+
+#include <stdio.h>
+
+#include "chunk.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_TICK_UNIT "cycles"
+#else
+#include <time.h>
+#define PROFILE_TICK_UNIT "ns"
+#endif
+
+#define OPCODE_COUNT (OP_RETURN + 1)
+
+typedef struct {
+   uint64_t count;
+   uint64_t ticks;
+} ProfileCounter;
+
+// Execution counts and time per opcode and per source line, filled in by
+// the vm's profiling run loop
+// Time is measured in ticks, cycles where the cpu has a time stamp counter
+// and nanoseconds elsewhere, and the ticks between two instructions go to
+// the first of them
+typedef struct {
+   ProfileCounter opcodes[OPCODE_COUNT];
+   // how often each opcode ran right after another, [first][second]
+   uint64_t pairs[OPCODE_COUNT][OPCODE_COUNT];
+   // indexed by line
+   ProfileCounter *lines;
+   int line_capacity;
+   // the instruction being timed, -1 for none
+   int last_opcode;
+   int last_line;
+   uint64_t last_tick;
+} Profile;
+
+void init_profile(Profile *profile);
+void free_profile(Profile *profile);
+// starts the clock for a run of the vm
+void profile_start(Profile *profile);
+// charges the last instruction of a run
+void profile_stop(Profile *profile);
+// counts the opcode sorted by time, the hottest lines and the most
+// frequent opcode pairs
+void write_profile_report(Profile *profile, FILE *file);
+void write_profile_json(Profile *profile, FILE *file);
+
+void grow_profile_lines(Profile *profile, int line);
+
+static inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+// called by the vm before each instruction
+static inline void profile_instruction(Profile *profile, uint8_t opcode, int line) {
+   uint64_t now = profile_ticks();
+   if (profile->last_opcode >= 0) {
+      uint64_t ticks = now - profile->last_tick;
+      profile->opcodes[profile->last_opcode].ticks += ticks;
+      profile->lines[profile->last_line].ticks += ticks;
+      ++profile->pairs[profile->last_opcode][opcode];
+   }
+   if (line >= profile->line_capacity) grow_profile_lines(profile, line);
+
+   ++profile->opcodes[opcode].count;
+   ++profile->lines[line].count;
+   profile->last_opcode = opcode;
+   profile->last_line = line;
+   profile->last_tick = now;
+}
+
+#endif
\ No newline at end of file
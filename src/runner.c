@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chunk.h"
+#include "compiler.h"
+#include "memory.h"
+#include "runner.h"
+#include "source.h"
+#include "thread_pool.h"
+
+typedef struct {
+   RunOptions *options;
+   // one per worker
+   VM *vms;
+} Batch;
+
+typedef struct {
+   Batch *batch;
+   Script *script;
+} ScriptTask;
+
+static void script_task(int worker, void *arg);
+
+void init_run_options(RunOptions *options) {
+   options->jobs = cpu_count();
+   options->compile_only = false;
+   options->batch_lexing = false;
+   options->memory_stats = false;
+   options->limits = (Limits) { 0 };
+}
+
+int run_scripts(Script *scripts, int count, RunOptions *options) {
+   int jobs = options->jobs < count ? options->jobs : count;
+   if (jobs < 1) jobs = 1;
+
+   Batch batch;
+   batch.options = options;
+   batch.vms = ALLOCATE(VM, jobs);
+   for (int i = 0; i < jobs; ++i) {
+      init_vm(&batch.vms[i]);
+      batch.vms[i].batch_lexing = options->batch_lexing;
+      batch.vms[i].limits = options->limits;
+   }
+
+   ScriptTask *tasks = ALLOCATE(ScriptTask, count);
+   ThreadPool pool;
+   init_thread_pool(&pool, jobs);
+   for (int i = 0; i < count; ++i) {
+      tasks[i].batch = &batch;
+      tasks[i].script = &scripts[i];
+      thread_pool_submit(&pool, script_task, &tasks[i]);
+   }
+   free_thread_pool(&pool);
+
+   for (int i = 0; i < jobs; ++i) {
+      if (options->memory_stats) {
+         fprintf(stderr, "worker %d:\n", i);
+         write_vm_memory_stats(&batch.vms[i], stderr);
+      }
+      free_vm(&batch.vms[i]);
+   }
+   FREE_ARRAY(batch.vms, VM, jobs);
+   FREE_ARRAY(tasks, ScriptTask, count);
+
+   int failed = 0;
+   for (int i = 0; i < count; ++i) {
+      if (scripts[i].status != SCRIPT_OK) ++failed;
+   }
+   return failed;
+}
+
+ScriptStatus run_script(VM *vm, const char *path, bool compile_only) {
+   Source source;
+   if (!read_source(path, &source)) return SCRIPT_READ_ERROR;
+
+   ScriptStatus status = SCRIPT_OK;
+   if (compile_only) {
+      MemoryStats *previous = use_memory_stats(&vm->memory);
+      Chunk chunk;
+      init_chunk(&chunk);
+      if (!compile(source.chars, source.length, vm, &chunk)) {
+         status = SCRIPT_COMPILE_ERROR;
+      }
+      free_chunk(&chunk);
+      use_memory_stats(previous);
+   } else {
+      InterpretResult result = interpret(vm, source.chars, source.length);
+      if (result == INTERPRET_COMPILE_ERROR) status = SCRIPT_COMPILE_ERROR;
+      if (result == INTERPRET_RUNTIME_ERROR) status = SCRIPT_RUNTIME_ERROR;
+      if (result == INTERPRET_MEMORY_LIMIT) status = SCRIPT_MEMORY_LIMIT;
+      if (result == INTERPRET_BUDGET_EXCEEDED) status = SCRIPT_BUDGET_EXCEEDED;
+   }
+
+   free_source(&source);
+   return status;
+}
+
+int exit_status(InterpretResult result) {
+   if (result == INTERPRET_COMPILE_ERROR) return 65;
+   if (result == INTERPRET_RUNTIME_ERROR) return 70;
+   if (result == INTERPRET_MEMORY_LIMIT) return 71;
+   if (result == INTERPRET_BUDGET_EXCEEDED) return 75;
+   return 0;
+}
+
+static void script_task(int worker, void *arg) {
+   ScriptTask *task = (ScriptTask *)arg;
+   VM *vm = &task->batch->vms[worker];
+
+   task->script->status = run_script(vm, task->script->path,
+      task->batch->options->compile_only);
+
+   // start the next script on a clean heap
+   reset_vm(vm);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef KI_RUNNER_H
+#define KI_RUNNER_H
+
+#include "common.h"
+#include "vm.h"
+
+// Embedding API for running many independent scripts at once
+//
+// Each worker thread owns a VM, with its own heap, stack and intern
+// table, that is reset between scripts so scripts never see each other's
+// objects. Pending scripts sit in a work stealing queue so a few long
+// scripts don't leave the other workers idle.
+
+typedef enum {
+   SCRIPT_OK,
+   SCRIPT_READ_ERROR,
+   SCRIPT_COMPILE_ERROR,
+   SCRIPT_RUNTIME_ERROR,
+   SCRIPT_MEMORY_LIMIT,
+   SCRIPT_BUDGET_EXCEEDED
+} ScriptStatus;
+
+typedef struct {
+   const char *path;
+   // filled in by run_scripts
+   ScriptStatus status;
+} Script;
+
+typedef struct {
+   // number of worker threads
+   int jobs;
+   // only compile the scripts, don't run them
+   bool compile_only;
+   bool batch_lexing;
+   // write each worker vm's memory stats to stderr once all scripts ran
+   bool memory_stats;
+   // what each script may use, see vm.h
+   Limits limits;
+} RunOptions;
+
+void init_run_options(RunOptions *options);
+// runs (or compiles) every script and fills in its status
+// returns the number of scripts that didn't end with SCRIPT_OK
+int run_scripts(Script *scripts, int count, RunOptions *options);
+// runs a single script on [vm]
+ScriptStatus run_script(VM *vm, const char *path, bool compile_only);
+// the sysexits code ki exits with after a script ended with [result]
+int exit_status(InterpretResult result);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include <string.h>
+#include <sys/time.h>
+
+#include "memory.h"
+#include "sampler.h"
+#include "vm.h"
+
+static void on_sigprof(int signal);
+static void add_lines(Sampler *sampler, Chunk *chunk);
+static void grow_lines(Sampler *sampler, int line);
+static void set_sigprof_blocked(bool blocked);
+
+// the handler has no other way to find it
+static Sampler *active_sampler = NULL;
+
+void start_sampler(Sampler *sampler, VM *vm, int hz, const char *root) {
+   sampler->vm = vm;
+   sampler->root = root;
+   sampler->code = NULL;
+   sampler->code_length = 0;
+   sampler->main_offsets = NULL;
+   sampler->fiber_offsets = NULL;
+   sampler->running = false;
+   sampler->outside = 0;
+   sampler->main_lines = NULL;
+   sampler->fiber_lines = NULL;
+   sampler->line_capacity = 0;
+   active_sampler = sampler;
+   vm->sampler = sampler;
+
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = on_sigprof;
+   action.sa_flags = SA_RESTART;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGPROF, &action, NULL);
+
+   struct itimerval timer;
+   timer.it_interval.tv_sec = 0;
+   timer.it_interval.tv_usec = 1000000 / hz;
+   timer.it_value = timer.it_interval;
+   setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+void stop_sampler(Sampler *sampler) {
+   struct itimerval timer;
+   memset(&timer, 0, sizeof(timer));
+   setitimer(ITIMER_PROF, &timer, NULL);
+   signal(SIGPROF, SIG_IGN);
+   active_sampler = NULL;
+   sampler->vm->sampler = NULL;
+
+   FREE_ARRAY(sampler->main_lines, uint64_t, sampler->line_capacity);
+   FREE_ARRAY(sampler->fiber_lines, uint64_t, sampler->line_capacity);
+   sampler->main_lines = NULL;
+   sampler->fiber_lines = NULL;
+   sampler->line_capacity = 0;
+}
+
+void sampler_enter(Sampler *sampler, Chunk *chunk) {
+   // the histograms are allocated here, the handler can't
+   sampler->main_offsets = ALLOCATE(uint32_t, chunk->count);
+   sampler->fiber_offsets = ALLOCATE(uint32_t, chunk->count);
+   memset(sampler->main_offsets, 0, sizeof(uint32_t) * chunk->count);
+   memset(sampler->fiber_offsets, 0, sizeof(uint32_t) * chunk->count);
+   sampler->code = chunk->code;
+   sampler->code_length = chunk->count;
+   sampler->running = true;
+}
+
+void sampler_leave(Sampler *sampler, Chunk *chunk) {
+   sampler->running = false;
+
+   // no signal may see the histograms go
+   set_sigprof_blocked(true);
+   add_lines(sampler, chunk);
+   FREE_ARRAY(sampler->main_offsets, uint32_t, chunk->count);
+   FREE_ARRAY(sampler->fiber_offsets, uint32_t, chunk->count);
+   sampler->main_offsets = NULL;
+   sampler->fiber_offsets = NULL;
+   sampler->code = NULL;
+   sampler->code_length = 0;
+   set_sigprof_blocked(false);
+}
+
+void write_folded_samples(Sampler *sampler, FILE *file) {
+   set_sigprof_blocked(true);
+   for (int line = 0; line < sampler->line_capacity; ++line) {
+      if (sampler->main_lines[line] == 0) continue;
+      fprintf(file, "%s;line %d %llu\n", sampler->root, line,
+         (unsigned long long)sampler->main_lines[line]);
+   }
+   for (int line = 0; line < sampler->line_capacity; ++line) {
+      if (sampler->fiber_lines[line] == 0) continue;
+      fprintf(file, "%s;fiber;line %d %llu\n", sampler->root, line,
+         (unsigned long long)sampler->fiber_lines[line]);
+   }
+   if (sampler->outside > 0) {
+      fprintf(file, "%s;(not running) %llu\n", sampler->root,
+         (unsigned long long)sampler->outside);
+   }
+   set_sigprof_blocked(false);
+}
+
+static void on_sigprof(int signal) {
+   (void)signal;
+   Sampler *sampler = active_sampler;
+   if (sampler == NULL) return;
+
+   VM *vm = sampler->vm;
+   uint8_t *ip = vm->ip;
+   // [ip] is past the opcode by the time an instruction runs
+   if (!sampler->running || ip <= sampler->code || ip > sampler->code + sampler->code_length) {
+      ++sampler->outside;
+      return;
+   }
+
+   int offset = (int)(ip - sampler->code) - 1;
+   if (vm->fiber == &vm->main_fiber) {
+      ++sampler->main_offsets[offset];
+   } else {
+      ++sampler->fiber_offsets[offset];
+   }
+}
+
+static void add_lines(Sampler *sampler, Chunk *chunk) {
+   for (int offset = 0; offset < chunk->count; ++offset) {
+      uint32_t main = sampler->main_offsets[offset];
+      uint32_t fiber = sampler->fiber_offsets[offset];
+      if (main == 0 && fiber == 0) continue;
+
+      int line = chunk->lines[offset];
+      if (line >= sampler->line_capacity) grow_lines(sampler, line);
+      sampler->main_lines[line] += main;
+      sampler->fiber_lines[line] += fiber;
+   }
+}
+
+static void grow_lines(Sampler *sampler, int line) {
+   int old_capacity = sampler->line_capacity;
+   int capacity = GROW_CAPACITY(old_capacity);
+   while (capacity <= line) capacity *= 2;
+
+   sampler->main_lines = GROW_ARRAY(sampler->main_lines, uint64_t, old_capacity, capacity);
+   sampler->fiber_lines = GROW_ARRAY(sampler->fiber_lines, uint64_t, old_capacity, capacity);
+   memset(sampler->main_lines + old_capacity, 0, sizeof(uint64_t) * (capacity - old_capacity));
+   memset(sampler->fiber_lines + old_capacity, 0, sizeof(uint64_t) * (capacity - old_capacity));
+   sampler->line_capacity = capacity;
+}
+
+static void set_sigprof_blocked(bool blocked) {
+   sigset_t set;
+   sigemptyset(&set);
+   sigaddset(&set, SIGPROF);
+   sigprocmask(blocked ? SIG_BLOCK : SIG_UNBLOCK, &set, NULL);
+}
\ No newline at end of file
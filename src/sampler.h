@@ -0,0 +1,44 @@
+#ifndef KI_SAMPLER_H
+#define KI_SAMPLER_H
+
+#include <signal.h>
+#include <stdio.h>
+
+#include "chunk.h"
+
+typedef struct sVM VM;
+
+// A sampling profiler driven by a SIGPROF timer
+// The signal handler only bumps a counter for the instruction [vm->ip] is
+// in, per chunk offset, which the vm resolves to source lines through the
+// chunk's line info once the chunk is done. Samples of spawned fibers are
+// kept apart from the script's own
+typedef struct {
+   VM *vm;
+   // the name at the root of every folded stack
+   const char *root;
+   // the chunk being sampled, set before [running]
+   uint8_t *code;
+   int code_length;
+   uint32_t *main_offsets;
+   uint32_t *fiber_offsets;
+   volatile sig_atomic_t running;
+   // samples that landed outside the run loop, compiling for example
+   volatile uint64_t outside;
+   // totals per source line over every chunk run so far
+   uint64_t *main_lines;
+   uint64_t *fiber_lines;
+   int line_capacity;
+} Sampler;
+
+// starts sampling [vm] [hz] times per second of cpu time
+void start_sampler(Sampler *sampler, VM *vm, int hz, const char *root);
+void stop_sampler(Sampler *sampler);
+// called by the vm around running [chunk]
+void sampler_enter(Sampler *sampler, Chunk *chunk);
+void sampler_leave(Sampler *sampler, Chunk *chunk);
+// one "root;line N count" line per sampled line, the format flamegraph
+// tools read
+void write_folded_samples(Sampler *sampler, FILE *file);
+
+#endif
\ No newline at end of file
@@ -2,239 +2,267 @@
 #include <string.h>
 
 #include "common.h"
+#include "memory.h"
 #include "scanner.h"
-
-static Token identifier();
-static TokenType identifier_type();
-static TokenType check_keyword();
-static Token number();
-static Token string(char terminator);
-static void skip_whitespace_and_comments();
-static bool is_at_end();
-static char peek();
-static char peek_next();
-static char advance();
-static bool match(char expected);
-static Token make_token(TokenType type);
-static Token error_token(const char *message);
+#include "scanner_tables.h"
+
+// bytes read from a stream at once, pipes hand out 64K at most anyway
+#define SEGMENT_SIZE (64 * 1024)
+
+static Token identifier(Scanner *scanner);
+static TokenType identifier_type(Scanner *scanner);
+static Token number(Scanner *scanner);
+static Token string(Scanner *scanner, char terminator);
+static void skip_whitespace_and_comments(Scanner *scanner);
+static bool refill(Scanner *scanner);
+static bool is_at_end(Scanner *scanner);
+static char peek(Scanner *scanner);
+static char peek_next(Scanner *scanner);
+static char advance(Scanner *scanner);
+static bool match(Scanner *scanner, char expected);
+static Token make_token(Scanner *scanner, TokenType type);
+static Token error_token(Scanner *scanner, const char *message);
 static bool is_alphanumeric(char c);
 static bool is_alpha(char c);
 static bool is_digit(char c);
+static bool is_space(char c);
+
 
+void init_scanner(Scanner *scanner, const char *source, size_t length) {
+   scanner->start = source;
+   scanner->current = source;
+   scanner->end = source + length;
+   scanner->line = 1;
+   scanner->reader = NULL;
+   scanner->segments = NULL;
+}
 
-typedef struct {
-   const char *start;
-   const char *current;
-   int line;
-} Scanner;
+void init_stream_scanner(Scanner *scanner, SourceReader *reader) {
+   init_scanner(scanner, NULL, 0);
+   scanner->reader = reader;
+}
 
-Scanner scanner;
+void free_scanner(Scanner *scanner) {
+   SourceSegment *segment = scanner->segments;
+   while (segment != NULL) {
+      SourceSegment *next = segment->next;
+      reallocate(segment, sizeof(SourceSegment) + segment->capacity, 0);
+      segment = next;
+   }
+   scanner->segments = NULL;
+}
 
-void init_scanner(const char *source) {
-   scanner.start = source;
-   scanner.current = source;
-   scanner.line = 1;
+const char* scanner_position(Scanner *scanner) {
+   return scanner->current;
 }
 
-Token scan_token() {
-   skip_whitespace_and_comments();
+Token scan_token(Scanner *scanner) {
+   skip_whitespace_and_comments(scanner);
 
-   scanner.start = scanner.current;
+   scanner->start = scanner->current;
 
-   if (is_at_end()) return make_token(TOKEN_EOF);
+   if (is_at_end(scanner)) return make_token(scanner, TOKEN_EOF);
 
-   char c = advance();
-   if (is_alpha(c)) return identifier();
-   if (is_digit(c)) return number();
+   char c = advance(scanner);
+   if (is_alpha(c)) return identifier(scanner);
+   if (is_digit(c)) return number(scanner);
    switch (c) {
    // One character tokens
-   case '(': return make_token(TOKEN_LEFT_PAREN);
-   case ')': return make_token(TOKEN_RIGHT_PAREN);
-   case '{': return make_token(TOKEN_LEFT_BRACE);
-   case '}': return make_token(TOKEN_RIGHT_BRACE);
-   case ';': return make_token(TOKEN_SEMICOLON);
-   case ',': return make_token(TOKEN_COMMA);
-   case '.': return make_token(TOKEN_DOT);
-   case '-': return make_token(TOKEN_MINUS);
-   case '+': return make_token(TOKEN_PLUS);
-   case '/': return make_token(TOKEN_SLASH);
-   case '*': return make_token(TOKEN_STAR);
+   case '(': return make_token(scanner, TOKEN_LEFT_PAREN);
+   case ')': return make_token(scanner, TOKEN_RIGHT_PAREN);
+   case '{': return make_token(scanner, TOKEN_LEFT_BRACE);
+   case '}': return make_token(scanner, TOKEN_RIGHT_BRACE);
+   case '[': return make_token(scanner, TOKEN_LEFT_BRACKET);
+   case ']': return make_token(scanner, TOKEN_RIGHT_BRACKET);
+   case ';': return make_token(scanner, TOKEN_SEMICOLON);
+   case ':': return make_token(scanner, TOKEN_COLON);
+   case ',': return make_token(scanner, TOKEN_COMMA);
+   case '.': return make_token(scanner, TOKEN_DOT);
+   case '-': return make_token(scanner, TOKEN_MINUS);
+   case '+': return make_token(scanner, TOKEN_PLUS);
+   case '/': return make_token(scanner, TOKEN_SLASH);
+   case '*': return make_token(scanner, TOKEN_STAR);
    // One or two characters tokens
    case '!':
-      return make_token(match('=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
+      return make_token(scanner, match(scanner, '=') ? TOKEN_BANG_EQUAL : TOKEN_BANG);
    case '=':
-      return make_token(match('=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
+      return make_token(scanner, match(scanner, '=') ? TOKEN_EQUAL_EQUAL : TOKEN_EQUAL);
    case '>':
-      return make_token(match('=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
+      return make_token(scanner, match(scanner, '=') ? TOKEN_GREATER_EQUAL : TOKEN_GREATER);
    case '<':
-      return make_token(match('=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
+      return make_token(scanner, match(scanner, '=') ? TOKEN_LESS_EQUAL : TOKEN_LESS);
    // String literals
-   case '"': return string('"');
-   case '\'': return string('\'');
+   case '"': return string(scanner, '"');
+   case '\'': return string(scanner, '\'');
    }
 
-   return error_token("Unexpected character");
+   return error_token(scanner, "Unexpected character");
 }
 
-static Token identifier() {
-   while (is_alphanumeric(peek())) advance();
+static Token identifier(Scanner *scanner) {
+   while (is_alphanumeric(peek(scanner))) advance(scanner);
 
-   return make_token(identifier_type());
+   return make_token(scanner, identifier_type(scanner));
 }
 
-static TokenType identifier_type() {
-   switch(scanner.start[0]) {
-   case 'a': return check_keyword(1, 2, "nd", TOKEN_AND);
-   case 'c': return check_keyword(1, 4, "lass", TOKEN_CLASS);
-   case 'e': return check_keyword(1, 3, "lse", TOKEN_ELSE);
-   case 'f':
-      if (scanner.current - scanner.start > 1) {
-      switch (scanner.start[1]) {
-         case 'a': return check_keyword(2, 3, "lse", TOKEN_FALSE);
-         case 'o': return check_keyword(2, 1, "r", TOKEN_FOR);
-         case 'u': return check_keyword(2, 1, "n", TOKEN_FUN);
-      }
-      }
-      break;
-   case 'i': return check_keyword(1, 1, "f", TOKEN_IF);
-   case 'n': return check_keyword(1, 2, "il", TOKEN_NIL);
-   case 'o': return check_keyword(1, 1, "r", TOKEN_OR);
-   case 'p': return check_keyword(1, 4, "rint", TOKEN_PRINT);
-   case 'r': return check_keyword(1, 5, "eturn", TOKEN_RETURN);
-   case 's': return check_keyword(1, 4, "uper", TOKEN_SUPER);
-   case 't':
-      if (scanner.current - scanner.start > 1) {
-      switch (scanner.start[1]) {
-         case 'h': return check_keyword(2, 2, "is", TOKEN_THIS);
-         case 'r': return check_keyword(2, 2, "ue", TOKEN_TRUE);
-      }
-      }
-      break;
-   case 'v': return check_keyword(1, 2, "ar", TOKEN_VAR);
-   case 'w': return check_keyword(1, 4, "hile", TOKEN_WHILE);
+static TokenType identifier_type(Scanner *scanner) {
+   int length = (int)(scanner->current - scanner->start);
+   if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) {
+      return TOKEN_IDENTIFIER;
    }
 
-   return TOKEN_IDENTIFIER;
-}
-
-static TokenType check_keyword(int start, int length,
-   const char *rest, TokenType type)
-{
-   // check if the token length is the same as the keyword
-   // then compare both words
-   if (scanner.current - scanner.start == start + length
-   && memcmp(scanner.start + start, rest, length) == 0)
+   // every keyword has its own slot so a single comparison decides
+   const Keyword *keyword = &keywords[keyword_hash(scanner->start, length)];
+   if (keyword->length == length
+   && memcmp(scanner->start, keyword->name, length) == 0)
    {
-   return type;
+   return keyword->type;
    }
    return TOKEN_IDENTIFIER;
 }
 
-static Token number() {
-   while (is_digit(peek())) advance();
+static Token number(Scanner *scanner) {
+   while (is_digit(peek(scanner))) advance(scanner);
 
-   if (peek() == '.' && is_digit(peek_next())) {
+   if (peek(scanner) == '.' && is_digit(peek_next(scanner))) {
    // Consume the '.'
-   advance();
+   advance(scanner);
 
-   while (is_digit(peek())) advance();
+   while (is_digit(peek(scanner))) advance(scanner);
    }
 
-   return make_token(TOKEN_NUMBER);
+   return make_token(scanner, TOKEN_NUMBER);
 }
 
-static Token string(char terminator) {
-   while (peek() != terminator && !is_at_end()) {
-   if (peek() == '\n') ++scanner.line;
-   advance();
+static Token string(Scanner *scanner, char terminator) {
+   while (peek(scanner) != terminator && !is_at_end(scanner)) {
+   if (peek(scanner) == '\n') ++scanner->line;
+   advance(scanner);
    }
 
-   if (is_at_end()) return error_token("Unterminated string");
+   if (is_at_end(scanner)) return error_token(scanner, "Unterminated string");
 
    // Consume the closing character
-   advance();
-   return make_token(TOKEN_STRING);
+   advance(scanner);
+   return make_token(scanner, TOKEN_STRING);
 }
 
-static void skip_whitespace_and_comments() {
+static void skip_whitespace_and_comments(Scanner *scanner) {
    for (;;) {
-   char c = peek();
-   switch (c) {
-      case '\n':
-      ++scanner.line;
-      case ' ':
-      case '\r':
-      case '\t':
-      advance();
-      break;
-      
-      case '/':
-      if (peek_next() == '/') {
-         while (peek() != '\n' && !is_at_end()) advance();
-      } else {
-         return;
+   // nothing skipped is kept when the scanner refills
+   scanner->start = scanner->current;
+   char c = peek(scanner);
+   if (is_space(c)) {
+      advance(scanner);
+   } else if (c == '\n') {
+      ++scanner->line;
+      advance(scanner);
+   } else if (c == '/' && peek_next(scanner) == '/') {
+      while (peek(scanner) != '\n' && !is_at_end(scanner)) {
+         advance(scanner);
+         scanner->start = scanner->current;
       }
-
-      default:
+   } else {
       return;
    }
    }
 }
 
-static bool is_at_end() {
-   return *scanner.current == '\0';
+// reads more of a streamed source, moving the token being scanned along
+// so it stays in one piece; false at the end of the input
+static bool refill(Scanner *scanner) {
+   if (scanner->reader == NULL) return false;
+
+   size_t kept = (size_t)(scanner->end - scanner->start);
+   size_t scanned = (size_t)(scanner->current - scanner->start);
+   SourceSegment *segment = scanner->segments;
+   char *limit = segment != NULL ? segment->chars + segment->capacity : NULL;
+   if (segment == NULL || scanner->end == limit) {
+      // full, start a new segment big enough for the token so far to
+      // at least double
+      size_t capacity = SEGMENT_SIZE;
+      while (capacity < kept * 2) capacity *= 2;
+      segment = (SourceSegment *)reallocate(NULL, 0, sizeof(SourceSegment) + capacity);
+      segment->capacity = capacity;
+      segment->next = scanner->segments;
+      scanner->segments = segment;
+      if (kept > 0) memcpy(segment->chars, scanner->start, kept);
+      scanner->start = segment->chars;
+      scanner->current = segment->chars + scanned;
+      scanner->end = segment->chars + kept;
+      limit = segment->chars + capacity;
+   }
+
+   size_t read = scanner->reader->read(scanner->reader->context, (char *)scanner->end,
+      (size_t)(limit - scanner->end));
+   if (read == 0) {
+      // never ask again, a terminal would wait for another end of file
+      scanner->reader = NULL;
+      return false;
+   }
+   scanner->end += read;
+   return true;
+}
+
+static bool is_at_end(Scanner *scanner) {
+   return scanner->current >= scanner->end && !refill(scanner);
 }
 
-static char peek() {
-   return *scanner.current;
+static char peek(Scanner *scanner) {
+   if (is_at_end(scanner)) return '\0';
+   return *scanner->current;
 }
 
-static char peek_next() {
-   if (is_at_end()) return '\0';
-   return scanner.current[1];
+static char peek_next(Scanner *scanner) {
+   while (scanner->current + 1 >= scanner->end) {
+      if (!refill(scanner)) return '\0';
+   }
+   return scanner->current[1];
 }
 
-static char advance() {
-   ++scanner.current;
-   return scanner.current[-1];
+static char advance(Scanner *scanner) {
+   ++scanner->current;
+   return scanner->current[-1];
 }
 
-static bool match(char expected) {
-   if (is_at_end()) return false;
-   if (*scanner.current != expected) return false;
+static bool match(Scanner *scanner, char expected) {
+   if (is_at_end(scanner)) return false;
+   if (*scanner->current != expected) return false;
 
-   ++scanner.current;
+   ++scanner->current;
    return true;
 }
 
-static Token make_token(TokenType type) {
+static Token make_token(Scanner *scanner, TokenType type) {
    return (Token) {
    .type = type,
-   .start = scanner.start,
-   .length = (int)(scanner.current - scanner.start),
-   .line = scanner.line
+   .start = scanner->start,
+   .length = (int)(scanner->current - scanner->start),
+   .line = scanner->line
    };
 }
 
-static Token error_token(const char *message) {
+static Token error_token(Scanner *scanner, const char *message) {
    return (Token) {
    .type = TOKEN_ERROR,
    .start = message,
    .length = (int)strlen(message),
-   .line = scanner.line,
+   .line = scanner->line,
    };
 }
 
 static bool is_alphanumeric(char c) {
-   return is_alpha(c) || is_digit(c);
+   return char_class[(unsigned char)c] & (CHAR_ALPHA | CHAR_DIGIT);
 }
 
 static bool is_alpha(char c) {
-   return (c >= 'a' && c <= 'z'
-     || c >= 'A' && c >= 'Z'
-     || c == '_');
+   return char_class[(unsigned char)c] & CHAR_ALPHA;
 }
 
 static bool is_digit(char c) {
-   return c >= '0' && c <= '9';
+   return char_class[(unsigned char)c] & CHAR_DIGIT;
+}
+
+static bool is_space(char c) {
+   return char_class[(unsigned char)c] & CHAR_SPACE;
 }
\ No newline at end of file
@@ -1,11 +1,14 @@
 #ifndef KI_SCANNER_H
 #define KI_SCANNER_H
 
+#include <stddef.h>
+
 typedef enum {
    // One character tokens
    TOKEN_LEFT_PAREN, TOKEN_RIGHT_PAREN,
    TOKEN_LEFT_BRACE, TOKEN_RIGHT_BRACE,
-   TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,
+   TOKEN_LEFT_BRACKET, TOKEN_RIGHT_BRACKET,
+   TOKEN_COLON, TOKEN_COMMA, TOKEN_DOT, TOKEN_MINUS, TOKEN_PLUS,
    TOKEN_SEMICOLON, TOKEN_SLASH, TOKEN_STAR,
 
    // One or two characters tokens
@@ -20,7 +23,8 @@ typedef enum {
    // Keywords
    TOKEN_AND, TOKEN_CLASS, TOKEN_ELSE, TOKEN_FALSE, TOKEN_FOR,
    TOKEN_FUN, TOKEN_IF, TOKEN_NIL, TOKEN_OR, TOKEN_PRINT, TOKEN_RETURN,
-   TOKEN_SUPER, TOKEN_THIS, TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE,
+   TOKEN_SPAWN, TOKEN_SUPER, TOKEN_THIS, TOKEN_TRUE, TOKEN_VAR, TOKEN_WHILE,
+   TOKEN_YIELD,
 
    TOKEN_ERROR, TOKEN_EOF
 } TokenType;
@@ -32,7 +36,44 @@ typedef struct {
    int line;
 } Token;
 
-void init_scanner(const char *source);
-Token scan_token();
+// where a streaming scanner pulls its source from, a piece at a time
+typedef struct {
+   // reads up to [capacity] bytes into [buffer] and returns how many, 0 once
+   // the input is exhausted; may block until some input arrives
+   size_t (*read)(void *context, char *buffer, size_t capacity);
+   void *context;
+} SourceReader;
+
+// a piece of streamed source, tokens point into them so they are kept
+// until the scanner is freed
+typedef struct SourceSegment {
+   struct SourceSegment *next;
+   size_t capacity;
+   char chars[];
+} SourceSegment;
+
+// scanner state, one per source being scanned
+typedef struct {
+   // start of the token being scanned
+   const char *start;
+   const char *current;
+   // one past the last byte of the source, or of what was read so far
+   const char *end;
+   int line;
+   // NULL once the whole source is in memory
+   SourceReader *reader;
+   // newest first, a token never spans two of them
+   SourceSegment *segments;
+} Scanner;
+
+// scans [length] bytes of [source], which needn't be NUL terminated
+void init_scanner(Scanner *scanner, const char *source, size_t length);
+// scans what [reader] returns, as it arrives
+void init_stream_scanner(Scanner *scanner, SourceReader *reader);
+// frees the segments of a streaming scanner, the tokens go with them
+void free_scanner(Scanner *scanner);
+Token scan_token(Scanner *scanner);
+// where the scanner currently is in the source
+const char* scanner_position(Scanner *scanner);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,124 @@
+// Generated by tools/gen_scanner_tables.py, do not edit by hand.
+#ifndef KI_SCANNER_TABLES_H
+#define KI_SCANNER_TABLES_H
+
+#include "common.h"
+#include "scanner.h"
+
+#define CHAR_ALPHA 1
+#define CHAR_DIGIT 2
+#define CHAR_SPACE 4
+#define CHAR_NEWLINE 8
+
+// classification of every byte the scanner may see
+static const uint8_t char_class[256] = {
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, CHAR_SPACE, CHAR_NEWLINE, 0, 0, CHAR_SPACE, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   CHAR_SPACE, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT, CHAR_DIGIT,
+   CHAR_DIGIT, CHAR_DIGIT, 0, 0, 0, 0, 0, 0,
+   0, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, 0, 0, 0, 0, CHAR_ALPHA,
+   0, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA,
+   CHAR_ALPHA, CHAR_ALPHA, CHAR_ALPHA, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+#define KEYWORD_COUNT 18
+#define KEYWORD_MIN_LENGTH 2
+#define KEYWORD_MAX_LENGTH 6
+
+// association values of the keyword hash, indexed by character
+static const uint8_t keyword_asso[256] = {
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 15, 0, 10, 6, 15, 1, 0,
+   8, 15, 0, 0, 15, 0, 6, 17,
+   16, 0, 7, 13, 16, 4, 10, 10,
+   0, 1, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+   0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+typedef struct {
+   const char *name;
+   int length;
+   TokenType type;
+} Keyword;
+
+// keywords indexed by their hash
+static const Keyword keywords[KEYWORD_COUNT] = {
+   { "false", 5, TOKEN_FALSE },
+   { "if", 2, TOKEN_IF },
+   { "while", 5, TOKEN_WHILE },
+   { "nil", 3, TOKEN_NIL },
+   { "spawn", 5, TOKEN_SPAWN },
+   { "this", 4, TOKEN_THIS },
+   { "true", 4, TOKEN_TRUE },
+   { "class", 5, TOKEN_CLASS },
+   { "print", 5, TOKEN_PRINT },
+   { "yield", 5, TOKEN_YIELD },
+   { "for", 3, TOKEN_FOR },
+   { "super", 5, TOKEN_SUPER },
+   { "and", 3, TOKEN_AND },
+   { "else", 4, TOKEN_ELSE },
+   { "fun", 3, TOKEN_FUN },
+   { "or", 2, TOKEN_OR },
+   { "return", 6, TOKEN_RETURN },
+   { "var", 3, TOKEN_VAR },
+};
+
+static inline unsigned keyword_hash(const char *start, int length) {
+   return (length
+      + keyword_asso[(unsigned char)start[0]]
+      + keyword_asso[(unsigned char)start[1]]
+      + keyword_asso[(unsigned char)start[length - 1]]) % KEYWORD_COUNT;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,242 @@
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+
+#include "compiler.h"
+#include "memory.h"
+#include "scheduler.h"
+
+// how many slices run between two looks at the waiting scripts
+#define POLL_INTERVAL 16
+
+// weights 4, 2 and 1
+static const uint64_t strides[PRIORITY_COUNT] = { 1, 2, 4 };
+
+static void enqueue(Scheduler *scheduler, ScheduledScript *script);
+static RunQueue* next_queue(Scheduler *scheduler);
+static void run_script_slice(Scheduler *scheduler, ScheduledScript *script);
+static void finish_script(Scheduler *scheduler, ScheduledScript *script,
+   InterpretResult result);
+static void poll_waiting(Scheduler *scheduler, bool block);
+static void free_script_list(Scheduler *scheduler, ScheduledScript *script);
+
+void init_scheduler(Scheduler *scheduler, VM *vm, uint64_t quantum) {
+   scheduler->vm = vm;
+   scheduler->quantum = quantum;
+   for (int i = 0; i < PRIORITY_COUNT; ++i) {
+      scheduler->queues[i].head = NULL;
+      scheduler->queues[i].tail = NULL;
+      scheduler->queues[i].pass = 0;
+   }
+   scheduler->pass = 0;
+   scheduler->waiting = NULL;
+   scheduler->waiting_count = 0;
+   scheduler->poll_fds = NULL;
+   scheduler->poll_capacity = 0;
+   scheduler->done_head = NULL;
+   scheduler->done_tail = NULL;
+}
+
+void free_scheduler(Scheduler *scheduler) {
+   MemoryStats *previous = use_memory_stats(&scheduler->vm->memory);
+   for (int i = 0; i < PRIORITY_COUNT; ++i) {
+      free_script_list(scheduler, scheduler->queues[i].head);
+   }
+   free_script_list(scheduler, scheduler->waiting);
+   // their contexts and chunks went when they ended
+   ScheduledScript *script = scheduler->done_head;
+   while (script != NULL) {
+      ScheduledScript *next = script->next;
+      FREE(ScheduledScript, script);
+      script = next;
+   }
+   FREE_ARRAY(scheduler->poll_fds, struct pollfd, scheduler->poll_capacity);
+   use_memory_stats(previous);
+   init_scheduler(scheduler, scheduler->vm, scheduler->quantum);
+}
+
+ScheduledScript* schedule_script(Scheduler *scheduler, const char *name,
+   const char *source, size_t length, Priority priority)
+{
+   VM *vm = scheduler->vm;
+   MemoryStats *previous = use_memory_stats(&vm->memory);
+
+   ScheduledScript *script = ALLOCATE(ScheduledScript, 1);
+   script->name = name;
+   script->priority = priority;
+   script->started = false;
+   script->next = NULL;
+   init_chunk(&script->chunk);
+   init_script_context(vm, &script->context);
+
+   // the script's strings are interned in its own table
+   swap_script_context(vm, &script->context);
+   bool compiled = compile(source, length, vm, &script->chunk);
+   swap_script_context(vm, &script->context);
+
+   if (compiled) {
+      enqueue(scheduler, script);
+   } else {
+      finish_script(scheduler, script, INTERPRET_COMPILE_ERROR);
+   }
+   use_memory_stats(previous);
+   return script;
+}
+
+void run_scheduler(Scheduler *scheduler) {
+   VM *vm = scheduler->vm;
+   MemoryStats *previous = use_memory_stats(&vm->memory);
+
+   int slices = 0;
+   for (;;) {
+      RunQueue *queue = next_queue(scheduler);
+      if (queue == NULL) {
+         if (scheduler->waiting == NULL) break;
+         poll_waiting(scheduler, true);
+         continue;
+      }
+
+      ScheduledScript *script = queue->head;
+      queue->head = script->next;
+      if (queue->head == NULL) queue->tail = NULL;
+      scheduler->pass = queue->pass;
+      queue->pass += strides[script->priority];
+
+      run_script_slice(scheduler, script);
+      if (scheduler->waiting != NULL && ++slices % POLL_INTERVAL == 0) {
+         poll_waiting(scheduler, false);
+      }
+   }
+
+   flush_output(&vm->output);
+   use_memory_stats(previous);
+}
+
+static void enqueue(Scheduler *scheduler, ScheduledScript *script) {
+   RunQueue *queue = &scheduler->queues[script->priority];
+   script->next = NULL;
+   if (queue->tail == NULL) {
+      if (queue->pass < scheduler->pass) queue->pass = scheduler->pass;
+      queue->head = script;
+   } else {
+      queue->tail->next = script;
+   }
+   queue->tail = script;
+}
+
+// the non empty queue with the lowest pass, the higher priority on a tie
+static RunQueue* next_queue(Scheduler *scheduler) {
+   RunQueue *next = NULL;
+   for (int i = 0; i < PRIORITY_COUNT; ++i) {
+      RunQueue *queue = &scheduler->queues[i];
+      if (queue->head == NULL) continue;
+      if (next == NULL || queue->pass < next->pass) next = queue;
+   }
+   return next;
+}
+
+static void run_script_slice(Scheduler *scheduler, ScheduledScript *script) {
+   VM *vm = scheduler->vm;
+   swap_script_context(vm, &script->context);
+   // the time limit runs from the first slice, not from being queued
+   if (!script->started) {
+      start_script(vm, &script->chunk);
+      script->started = true;
+   }
+   InterpretResult result = run_slice(vm, scheduler->quantum);
+   swap_script_context(vm, &script->context);
+
+   switch (result) {
+      case INTERPRET_PREEMPTED:
+      enqueue(scheduler, script);
+      break;
+      case INTERPRET_WAITING:
+      script->next = scheduler->waiting;
+      scheduler->waiting = script;
+      ++scheduler->waiting_count;
+      break;
+      default:
+      finish_script(scheduler, script, result);
+      break;
+   }
+}
+
+static void finish_script(Scheduler *scheduler, ScheduledScript *script,
+   InterpretResult result)
+{
+   free_script_context(scheduler->vm, &script->context);
+   free_chunk(&script->chunk);
+   script->result = result;
+
+   script->next = NULL;
+   if (scheduler->done_tail == NULL) {
+      scheduler->done_head = script;
+   } else {
+      scheduler->done_tail->next = script;
+   }
+   scheduler->done_tail = script;
+}
+
+// queues the waiting scripts with a parked fiber that can go on, or that
+// are past their time limit, sleeping until there's one if [block]
+// each script has its own epoll instance, which polls as readable once
+// one of its descriptors is ready
+static void poll_waiting(Scheduler *scheduler, bool block) {
+   if (scheduler->poll_capacity < scheduler->waiting_count) {
+      int old_capacity = scheduler->poll_capacity;
+      int capacity = GROW_CAPACITY(old_capacity);
+      while (capacity < scheduler->waiting_count) capacity = GROW_CAPACITY(capacity);
+      scheduler->poll_fds = GROW_ARRAY(scheduler->poll_fds, struct pollfd,
+         old_capacity, capacity);
+      scheduler->poll_capacity = capacity;
+   }
+
+   int count = 0;
+   int64_t deadline = INT64_MAX;
+   for (ScheduledScript *script = scheduler->waiting; script != NULL;
+      script = script->next)
+   {
+      scheduler->poll_fds[count].fd = script->context.events.epoll_fd;
+      scheduler->poll_fds[count].events = POLLIN;
+      scheduler->poll_fds[count].revents = 0;
+      ++count;
+      if (script->context.deadline < deadline) deadline = script->context.deadline;
+   }
+
+   int timeout = 0;
+   if (block) {
+      // whatever was printed shows up before the scheduler goes to sleep
+      flush_output(&scheduler->vm->output);
+      timeout = -1;
+      if (deadline != INT64_MAX) {
+         int64_t left = deadline - now_milliseconds();
+         if (left < 0) left = 0;
+         timeout = left < INT32_MAX ? (int)left + 1 : INT32_MAX;
+      }
+   }
+   if (poll(scheduler->poll_fds, count, timeout) < 0 && errno != EINTR) return;
+
+   int64_t now = deadline != INT64_MAX ? now_milliseconds() : 0;
+   ScheduledScript **link = &scheduler->waiting;
+   for (int i = 0; i < count; ++i) {
+      ScheduledScript *script = *link;
+      // run_slice() reports the ones out of time
+      if (scheduler->poll_fds[i].revents != 0 || script->context.deadline < now) {
+         *link = script->next;
+         --scheduler->waiting_count;
+         enqueue(scheduler, script);
+      } else {
+         link = &script->next;
+      }
+   }
+}
+
+static void free_script_list(Scheduler *scheduler, ScheduledScript *script) {
+   while (script != NULL) {
+      ScheduledScript *next = script->next;
+      free_script_context(scheduler->vm, &script->context);
+      free_chunk(&script->chunk);
+      FREE(ScheduledScript, script);
+      script = next;
+   }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#ifndef KI_SCHEDULER_H
+#define KI_SCHEDULER_H
+
+#include <poll.h>
+
+#include "common.h"
+#include "chunk.h"
+#include "vm.h"
+
+// Runs many scripts on one vm and one thread, a slice at a time
+//
+// Each script has its own registers, fibers and heap, see ScriptContext,
+// and is preempted after [quantum] instructions. Any point between two
+// instructions is a safe one, nothing is left half done there. Scripts
+// take turns round robin within their priority and the priorities take
+// turns in proportion to their weight, so a short script waits for a few
+// slices at most however long the scripts next to it run, and low
+// priority scripts still move while high priority ones keep coming.
+// A script whose fibers all wait on file descriptors is set aside until
+// one is ready, the scheduler only sleeps when every script waits.
+
+typedef enum {
+   PRIORITY_HIGH,
+   PRIORITY_NORMAL,
+   PRIORITY_LOW
+} Priority;
+
+#define PRIORITY_COUNT 3
+
+typedef struct sScheduledScript {
+   // the caller's, for reporting
+   const char *name;
+   Priority priority;
+   Chunk chunk;
+   ScriptContext context;
+   bool started;
+   // how the script ended, once it's in the scheduler's done list
+   InterpretResult result;
+   struct sScheduledScript *next;
+} ScheduledScript;
+
+typedef struct {
+   ScheduledScript *head;
+   ScheduledScript *tail;
+   // the queue with the lowest pass runs next and its pass grows by its
+   // priority's stride, the inverse of its weight
+   uint64_t pass;
+} RunQueue;
+
+typedef struct {
+   VM *vm;
+   uint64_t quantum;
+   RunQueue queues[PRIORITY_COUNT];
+   // pass of the queue that ran last, a queue that was empty starts
+   // from it rather than with the turns it missed
+   uint64_t pass;
+   // scripts whose fibers are all parked
+   ScheduledScript *waiting;
+   int waiting_count;
+   struct pollfd *poll_fds;
+   int poll_capacity;
+   // scripts that ended, in the order they did
+   ScheduledScript *done_head;
+   ScheduledScript *done_tail;
+} Scheduler;
+
+// the scripts run on [vm] with its limits, its memory limit covers all
+// of them together
+void init_scheduler(Scheduler *scheduler, VM *vm, uint64_t quantum);
+// frees every script, ended or not
+void free_scheduler(Scheduler *scheduler);
+// compiles [length] bytes of [source] and queues it to run
+// a script that doesn't compile goes straight to the done list with
+// INTERPRET_COMPILE_ERROR
+ScheduledScript* schedule_script(Scheduler *scheduler, const char *name,
+   const char *source, size_t length, Priority priority);
+// runs until every queued script ended
+void run_scheduler(Scheduler *scheduler);
+
+#endif
\ No newline at end of file
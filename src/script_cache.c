@@ -0,0 +1,203 @@
+#include <string.h>
+
+#include "compiler.h"
+#include "memory.h"
+#include "object.h"
+#include "script_cache.h"
+
+static uint64_t hash_source(const char *source, size_t length);
+static CachedScript* find_script(ScriptCache *cache, uint64_t hash,
+   const char *source, size_t length);
+static CachedScript* export_chunk(Chunk *chunk, uint64_t hash,
+   const char *source, size_t length);
+static void insert_script(ScriptCache *cache, CachedScript *script);
+static void remove_script(ScriptCache *cache, CachedScript *script);
+static void free_cached_script(CachedScript *script);
+
+void init_script_cache(ScriptCache *cache, int capacity) {
+   pthread_mutex_init(&cache->lock, NULL);
+   cache->capacity = capacity;
+   // a power of two, at least twice the scripts
+   cache->bucket_count = 8;
+   while (cache->bucket_count < capacity * 2) cache->bucket_count *= 2;
+   cache->buckets = ALLOCATE(CachedScript *, cache->bucket_count);
+   memset(cache->buckets, 0, sizeof(CachedScript *) * cache->bucket_count);
+   cache->order = ALLOCATE(CachedScript *, capacity);
+   cache->oldest = 0;
+   cache->count = 0;
+   cache->lookups = 0;
+   cache->misses = 0;
+}
+
+void free_script_cache(ScriptCache *cache) {
+   for (int i = 0; i < cache->count; ++i) {
+      release_cached_script(cache->order[(cache->oldest + i) % cache->capacity]);
+   }
+   FREE_ARRAY(cache->buckets, CachedScript *, cache->bucket_count);
+   FREE_ARRAY(cache->order, CachedScript *, cache->capacity);
+   pthread_mutex_destroy(&cache->lock);
+}
+
+CachedScript* get_cached_script(ScriptCache *cache, VM *vm,
+   const char *source, size_t length)
+{
+   uint64_t hash = hash_source(source, length);
+
+   pthread_mutex_lock(&cache->lock);
+   ++cache->lookups;
+   CachedScript *script = find_script(cache, hash, source, length);
+   if (script != NULL) atomic_fetch_add(&script->refs, 1);
+   pthread_mutex_unlock(&cache->lock);
+   if (script != NULL) return script;
+
+   // compiled without the lock, the same source may be compiled twice
+   // at once but only cached once
+   Chunk chunk;
+   init_chunk(&chunk);
+   bool compiled = compile(source, length, vm, &chunk);
+   // the cached copy belongs to the process, not to [vm]
+   MemoryStats *stats = use_memory_stats(NULL);
+   if (compiled) script = export_chunk(&chunk, hash, source, length);
+   use_memory_stats(stats);
+   free_chunk(&chunk);
+   if (!compiled) return NULL;
+
+   pthread_mutex_lock(&cache->lock);
+   ++cache->misses;
+   CachedScript *cached = find_script(cache, hash, source, length);
+   if (cached == NULL) {
+      insert_script(cache, script);
+      cached = script;
+   }
+   atomic_fetch_add(&cached->refs, 1);
+   pthread_mutex_unlock(&cache->lock);
+
+   if (cached != script) release_cached_script(script);
+   return cached;
+}
+
+void release_cached_script(CachedScript *script) {
+   if (atomic_fetch_sub(&script->refs, 1) == 1) {
+      MemoryStats *stats = use_memory_stats(NULL);
+      free_cached_script(script);
+      use_memory_stats(stats);
+   }
+}
+
+void link_cached_script(CachedScript *script, VM *vm, Chunk *chunk) {
+   chunk->count = script->count;
+   chunk->capacity = script->count;
+   chunk->code = script->code;
+   chunk->lines = script->lines;
+   init_value_array(&chunk->constants);
+   for (int i = 0; i < script->constant_count; ++i) {
+      CachedConstant *constant = &script->constants[i];
+      Value value = constant->value;
+      if (constant->chars != NULL) {
+         value = OBJ_VAL(copy_string(vm, constant->chars, constant->length));
+      }
+      write_value_array(&chunk->constants, value);
+   }
+}
+
+void unlink_cached_script(Chunk *chunk) {
+   free_value_array(&chunk->constants);
+   chunk->code = NULL;
+   chunk->lines = NULL;
+   chunk->count = 0;
+   chunk->capacity = 0;
+}
+
+// FNV-1a, 64 bits
+static uint64_t hash_source(const char *source, size_t length) {
+   uint64_t hash = 14695981039346656037ull;
+   for (size_t i = 0; i < length; ++i) {
+      hash ^= (uint8_t)source[i];
+      hash *= 1099511628211ull;
+   }
+   return hash;
+}
+
+static CachedScript* find_script(ScriptCache *cache, uint64_t hash,
+   const char *source, size_t length)
+{
+   CachedScript *script = cache->buckets[hash & (cache->bucket_count - 1)];
+   for (; script != NULL; script = script->next) {
+      if (script->hash == hash && script->length == length
+         && memcmp(script->source, source, length) == 0)
+      {
+         return script;
+      }
+   }
+   return NULL;
+}
+
+// copies [chunk] out of the vm that compiled it
+static CachedScript* export_chunk(Chunk *chunk, uint64_t hash,
+   const char *source, size_t length)
+{
+   CachedScript *script = ALLOCATE(CachedScript, 1);
+   script->hash = hash;
+   script->source = ALLOCATE(char, length + 1);
+   memcpy(script->source, source, length);
+   script->length = length;
+   script->count = chunk->count;
+   script->code = ALLOCATE(uint8_t, chunk->count);
+   memcpy(script->code, chunk->code, chunk->count);
+   script->lines = ALLOCATE(int, chunk->count);
+   memcpy(script->lines, chunk->lines, sizeof(int) * chunk->count);
+
+   script->constant_count = chunk->constants.count;
+   script->constants = ALLOCATE(CachedConstant, chunk->constants.count);
+   for (int i = 0; i < chunk->constants.count; ++i) {
+      CachedConstant *constant = &script->constants[i];
+      Value value = chunk->constants.values[i];
+      constant->value = value;
+      constant->chars = NULL;
+      constant->length = 0;
+      if (IS_STRING(value)) {
+         ObjString *string = AS_STRING(value);
+         constant->chars = ALLOCATE(char, string->length + 1);
+         memcpy(constant->chars, string->chars, string->length);
+         constant->length = string->length;
+      }
+   }
+
+   atomic_init(&script->refs, 1);
+   script->next = NULL;
+   return script;
+}
+
+static void insert_script(ScriptCache *cache, CachedScript *script) {
+   if (cache->count == cache->capacity) {
+      CachedScript *oldest = cache->order[cache->oldest];
+      remove_script(cache, oldest);
+      cache->oldest = (cache->oldest + 1) % cache->capacity;
+      --cache->count;
+      release_cached_script(oldest);
+   }
+
+   CachedScript **bucket = &cache->buckets[script->hash & (cache->bucket_count - 1)];
+   script->next = *bucket;
+   *bucket = script;
+   cache->order[(cache->oldest + cache->count) % cache->capacity] = script;
+   ++cache->count;
+}
+
+static void remove_script(ScriptCache *cache, CachedScript *script) {
+   CachedScript **link = &cache->buckets[script->hash & (cache->bucket_count - 1)];
+   while (*link != script) link = &(*link)->next;
+   *link = script->next;
+}
+
+static void free_cached_script(CachedScript *script) {
+   for (int i = 0; i < script->constant_count; ++i) {
+      CachedConstant *constant = &script->constants[i];
+      if (constant->chars != NULL) FREE_ARRAY(constant->chars, char, constant->length + 1);
+   }
+   FREE_ARRAY(script->constants, CachedConstant, script->constant_count);
+   FREE_ARRAY(script->lines, int, script->count);
+   FREE_ARRAY(script->code, uint8_t, script->count);
+   FREE_ARRAY(script->source, char, script->length + 1);
+   FREE(CachedScript, script);
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#ifndef KI_SCRIPT_CACHE_H
+#define KI_SCRIPT_CACHE_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+#include "chunk.h"
+#include "vm.h"
+
+// A string constant is kept as its characters, [value] is unused
+typedef struct {
+   Value value;
+   char *chars;
+   int length;
+} CachedConstant;
+
+// A compiled script any vm can run
+// The string constants a compiler makes belong to its vm, so the cache
+// keeps their characters instead and link_cached_script() interns them
+// in the vm about to run the script. The bytecode is shared as is.
+typedef struct sCachedScript {
+   uint64_t hash;
+   char *source;
+   size_t length;
+   int count;
+   uint8_t *code;
+   int *lines;
+   CachedConstant *constants;
+   int constant_count;
+   // the cache holds one reference, each vm running the script another
+   atomic_int refs;
+   // next script in the same bucket
+   struct sCachedScript *next;
+} CachedScript;
+
+// Compiled scripts keyed by the hash of their source, shared by every
+// thread
+// Cached scripts never change. Once full the cache drops the oldest
+// script, which lives on until the vms running it release it.
+typedef struct {
+   pthread_mutex_t lock;
+   int capacity;
+   CachedScript **buckets;
+   int bucket_count;
+   // in the order they were cached, a ring of [capacity]
+   CachedScript **order;
+   int oldest;
+   int count;
+   // lookups, and the ones that had to compile
+   uint64_t lookups;
+   uint64_t misses;
+} ScriptCache;
+
+void init_script_cache(ScriptCache *cache, int capacity);
+void free_script_cache(ScriptCache *cache);
+// the script compiled from [source], compiled on [vm] and cached first
+// if it isn't yet, or NULL if it doesn't compile
+// [source] is [length] bytes and needn't be terminated, the script
+// must be released
+CachedScript* get_cached_script(ScriptCache *cache, VM *vm,
+   const char *source, size_t length);
+void release_cached_script(CachedScript *script);
+// fills [chunk] with [script] for [vm] to run, the chunk must be freed
+// with unlink_cached_script() rather than free_chunk()
+void link_cached_script(CachedScript *script, VM *vm, Chunk *chunk);
+void unlink_cached_script(Chunk *chunk);
+
+#endif
\ No newline at end of file
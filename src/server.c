@@ -0,0 +1,328 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "script_cache.h"
+#include "server.h"
+#include "source.h"
+#include "thread_pool.h"
+
+// compiled scripts kept at once
+#define CACHE_CAPACITY 256
+// larger requests are refused before anything is allocated for them
+#define MAX_SOURCE_LENGTH (64 * 1024 * 1024)
+// how long a client may go quiet while sending its request, or while the
+// server answers, before the connection is dropped
+#define IO_TIMEOUT_SECONDS 5
+
+typedef struct {
+   RunOptions *options;
+   // one per worker
+   VM *vms;
+   ScriptCache cache;
+} Server;
+
+typedef struct {
+   Server *server;
+   int fd;
+} Connection;
+
+static void serve_connection(int worker, void *arg);
+static char* read_request(int fd, uint32_t *length, int *out, int *err);
+static int run_request(Server *server, VM *vm, const char *source,
+   uint32_t length, int out, int err);
+static bool open_socket(const char *path, struct sockaddr_un *address, int *fd);
+static bool read_all(int fd, void *buffer, size_t length);
+static bool write_all(int fd, const void *buffer, size_t length);
+static void stop(int signal);
+
+static volatile sig_atomic_t stopping = 0;
+
+int serve(const char *socket_path, RunOptions *options) {
+   struct sockaddr_un address;
+   int listener;
+   if (!open_socket(socket_path, &address, &listener)) return 64;
+   // a socket left behind by a server that didn't stop cleanly
+   unlink(socket_path);
+   if (bind(listener, (struct sockaddr *)&address, sizeof(address)) < 0
+      || listen(listener, SOMAXCONN) < 0)
+   {
+      fprintf(stderr, "Can't listen on \"%s\": %s\n", socket_path, strerror(errno));
+      close(listener);
+      return 71;
+   }
+
+   // a client going away mid script mustn't take the server with it
+   signal(SIGPIPE, SIG_IGN);
+   // without SA_RESTART, so accept() returns when asked to stop
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = stop;
+   sigemptyset(&action.sa_mask);
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+
+   Server server;
+   server.options = options;
+   server.vms = ALLOCATE(VM, options->jobs);
+   for (int i = 0; i < options->jobs; ++i) {
+      init_vm(&server.vms[i]);
+      server.vms[i].batch_lexing = options->batch_lexing;
+      server.vms[i].limits = options->limits;
+   }
+   init_script_cache(&server.cache, CACHE_CAPACITY);
+   ThreadPool pool;
+   init_thread_pool(&pool, options->jobs);
+
+   while (!stopping) {
+      int fd = accept4(listener, NULL, NULL, SOCK_CLOEXEC);
+      if (fd < 0) {
+         if (errno == EINTR || errno == ECONNABORTED) continue;
+         fprintf(stderr, "Can't accept on \"%s\": %s\n", socket_path, strerror(errno));
+         break;
+      }
+      // a worker is given the connection before the request arrives, a
+      // client that never sends one mustn't keep it forever
+      struct timeval timeout = { IO_TIMEOUT_SECONDS, 0 };
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+      Connection *connection = ALLOCATE(Connection, 1);
+      connection->server = &server;
+      connection->fd = fd;
+      thread_pool_submit(&pool, serve_connection, connection);
+   }
+
+   // the requests already accepted are served first
+   free_thread_pool(&pool);
+   close(listener);
+   unlink(socket_path);
+
+   for (int i = 0; i < options->jobs; ++i) {
+      if (options->memory_stats) {
+         fprintf(stderr, "worker %d:\n", i);
+         write_vm_memory_stats(&server.vms[i], stderr);
+      }
+      free_vm(&server.vms[i]);
+   }
+   FREE_ARRAY(server.vms, VM, options->jobs);
+   if (options->memory_stats) {
+      fprintf(stderr, "script cache:     %llu lookups, %llu compiled\n",
+         (unsigned long long)server.cache.lookups,
+         (unsigned long long)server.cache.misses);
+   }
+   free_script_cache(&server.cache);
+   return 0;
+}
+
+int run_client(const char *socket_path, const char *path) {
+   Source source;
+   if (!read_source(path, &source)) return 74;
+   if (source.length > MAX_SOURCE_LENGTH) {
+      fprintf(stderr, "\"%s\" is too large to send\n", path);
+      free_source(&source);
+      return 74;
+   }
+
+   struct sockaddr_un address;
+   int fd;
+   if (!open_socket(socket_path, &address, &fd)) {
+      free_source(&source);
+      return 64;
+   }
+   if (connect(fd, (struct sockaddr *)&address, sizeof(address)) < 0) {
+      fprintf(stderr, "Can't connect to \"%s\": %s\n", socket_path, strerror(errno));
+      close(fd);
+      free_source(&source);
+      return 69;
+   }
+
+   uint32_t header = (uint32_t)source.length;
+   struct iovec part = { &header, sizeof(header) };
+   int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+   union {
+      struct cmsghdr align;
+      char buffer[CMSG_SPACE(sizeof(fds))];
+   } control;
+   memset(&control, 0, sizeof(control));
+   struct msghdr message;
+   memset(&message, 0, sizeof(message));
+   message.msg_iov = &part;
+   message.msg_iovlen = 1;
+   message.msg_control = control.buffer;
+   message.msg_controllen = sizeof(control.buffer);
+   struct cmsghdr *attached = CMSG_FIRSTHDR(&message);
+   attached->cmsg_level = SOL_SOCKET;
+   attached->cmsg_type = SCM_RIGHTS;
+   attached->cmsg_len = CMSG_LEN(sizeof(fds));
+   memcpy(CMSG_DATA(attached), fds, sizeof(fds));
+
+   int32_t status;
+   if (sendmsg(fd, &message, MSG_NOSIGNAL) != sizeof(header)
+      || !write_all(fd, source.chars, source.length)
+      || !read_all(fd, &status, sizeof(status)))
+   {
+      fprintf(stderr, "Lost the connection to \"%s\"\n", socket_path);
+      status = 69;
+   }
+
+   close(fd);
+   free_source(&source);
+   return status;
+}
+
+static void serve_connection(int worker, void *arg) {
+   Connection *connection = (Connection *)arg;
+   Server *server = connection->server;
+   int fd = connection->fd;
+   FREE(Connection, connection);
+
+   uint32_t length;
+   int out = -1;
+   int err = -1;
+   char *source = read_request(fd, &length, &out, &err);
+   if (source != NULL) {
+      int32_t status = run_request(server, &server->vms[worker], source,
+         length, out, err);
+      write_all(fd, &status, sizeof(status));
+      free(source);
+   }
+
+   if (out >= 0) close(out);
+   if (err >= 0) close(err);
+   close(fd);
+}
+
+// the source and the client's output and error
+// descriptors, or NULL if the request is malformed
+static char* read_request(int fd, uint32_t *length, int *out, int *err) {
+   struct iovec part = { length, sizeof(*length) };
+   union {
+      struct cmsghdr align;
+      char buffer[CMSG_SPACE(sizeof(int) * 2)];
+   } control;
+   struct msghdr message;
+   memset(&message, 0, sizeof(message));
+   message.msg_iov = &part;
+   message.msg_iovlen = 1;
+   message.msg_control = control.buffer;
+   message.msg_controllen = sizeof(control.buffer);
+
+   ssize_t received;
+   do {
+      received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+   } while (received < 0 && errno == EINTR);
+
+   struct cmsghdr *attached = CMSG_FIRSTHDR(&message);
+   if (attached != NULL && attached->cmsg_level == SOL_SOCKET
+      && attached->cmsg_type == SCM_RIGHTS)
+   {
+      int count = (int)((attached->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+      int fds[2];
+      memcpy(fds, CMSG_DATA(attached), sizeof(int) * (count < 2 ? count : 2));
+      if (count > 0) *out = fds[0];
+      if (count > 1) *err = fds[1];
+      if (count != 2) return NULL;
+   }
+   if (received != sizeof(*length) || *out < 0 || *err < 0
+      || *length > MAX_SOURCE_LENGTH)
+   {
+      return NULL;
+   }
+
+   // used by [length] alone, nothing terminates it, the spare byte only
+   // keeps malloc(0) from returning NULL for an empty script
+   char *source = (char *)malloc(*length + 1);
+   if (source == NULL) return NULL;
+   if (!read_all(fd, source, *length)) {
+      free(source);
+      return NULL;
+   }
+   return source;
+}
+
+static int run_request(Server *server, VM *vm, const char *source,
+   uint32_t length, int out, int err)
+{
+   FILE *errors = fdopen(dup(err), "w");
+   if (errors == NULL) return 71;
+   // unbuffered like stderr, so errors and output arrive in order
+   setvbuf(errors, NULL, _IONBF, 0);
+   vm->errors = errors;
+   output_to_fd(&vm->output, out);
+
+   MemoryStats *previous = use_memory_stats(&vm->memory);
+   InterpretResult result = INTERPRET_COMPILE_ERROR;
+   CachedScript *script = get_cached_script(&server->cache, vm, source, length);
+   if (script != NULL) {
+      Chunk chunk;
+      link_cached_script(script, vm, &chunk);
+      result = interpret_chunk(vm, &chunk);
+      unlink_cached_script(&chunk);
+      release_cached_script(script);
+   }
+   use_memory_stats(previous);
+
+   output_to_fd(&vm->output, STDOUT_FILENO);
+   vm->errors = stderr;
+   fclose(errors);
+   // the next request starts on a clean heap
+   reset_vm(vm);
+   return exit_status(result);
+}
+
+static bool open_socket(const char *path, struct sockaddr_un *address, int *fd) {
+   memset(address, 0, sizeof(*address));
+   address->sun_family = AF_UNIX;
+   if (strlen(path) >= sizeof(address->sun_path)) {
+      fprintf(stderr, "Socket path \"%s\" is too long\n", path);
+      return false;
+   }
+   strcpy(address->sun_path, path);
+
+   *fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (*fd < 0) {
+      fprintf(stderr, "Can't open a socket: %s\n", strerror(errno));
+      return false;
+   }
+   return true;
+}
+
+static bool read_all(int fd, void *buffer, size_t length) {
+   char *chars = (char *)buffer;
+   while (length > 0) {
+      ssize_t count = read(fd, chars, length);
+      if (count < 0 && errno == EINTR) continue;
+      if (count <= 0) return false;
+      chars += count;
+      length -= count;
+   }
+   return true;
+}
+
+static bool write_all(int fd, const void *buffer, size_t length) {
+   const char *chars = (const char *)buffer;
+   while (length > 0) {
+      ssize_t count = send(fd, chars, length, MSG_NOSIGNAL);
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) return false;
+      chars += count;
+      length -= count;
+   }
+   return true;
+}
+
+static void stop(int signal) {
+   (void)signal;
+   stopping = 1;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef KI_SERVER_H
+#define KI_SERVER_H
+
+#include "common.h"
+#include "runner.h"
+
+// A daemon running scripts for clients over a Unix domain socket
+//
+// Its vms stay up between scripts and compiled scripts are cached by the
+// hash of their source, so a request costs little more than the run
+// itself. A client passes its standard output and error along with the
+// source, as file descriptors, and the script prints straight to them
+// as it goes. The client then gets the status ki would have exited with.
+// Requests are served [options->jobs] at a time, one vm per worker.
+//
+// Both directions use native byte order:
+//   client: uint32 source length, the two descriptors attached to it,
+//           then the source
+//   server: int32 exit status, then it hangs up
+
+// serves until SIGINT or SIGTERM, returns the status to exit with
+int serve(const char *socket_path, RunOptions *options);
+// runs the script at [path] through the server at [socket_path] and
+// returns the status to exit with
+int run_client(const char *socket_path, const char *path);
+
+#endif
\ No newline at end of file
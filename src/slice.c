@@ -0,0 +1,77 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "slice.h"
+
+NativeResult substr_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   int start;
+   int length;
+   if (!IS_TEXT(args[0])) {
+      runtime_error(vm, "Can only take substrings of strings");
+      return NATIVE_ERROR;
+   }
+   if (!int_argument(vm, args[1], &start) || !int_argument(vm, args[2], &length)) {
+      return NATIVE_ERROR;
+   }
+
+   int text_end = text_length(args[0]);
+   if (start < 0 || length < 0 || start > text_end || length > text_end - start) {
+      runtime_error(vm, "Substring [%d, %d) out of bounds for length %d",
+         start, start + length, text_end);
+      return NATIVE_ERROR;
+   }
+
+   ObjSlice *slice = new_slice(vm, args[0], start, length);
+   if (slice == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   *result = OBJ_VAL(slice);
+   return NATIVE_OK;
+}
+
+NativeResult split_native(VM *vm, int arg_count, Value *args, Value *result) {
+   (void)arg_count;
+   if (!IS_TEXT(args[0]) || !IS_TEXT(args[1]) || text_length(args[1]) == 0) {
+      runtime_error(vm, "Expected a string and a non empty separator");
+      return NATIVE_ERROR;
+   }
+
+   const char *chars = text_chars(args[0]);
+   const char *end = chars + text_length(args[0]);
+   const char *separator = text_chars(args[1]);
+   int separator_length = text_length(args[1]);
+
+   ObjList *pieces = new_list(vm, 0);
+   if (pieces == NULL) {
+      allocation_failed(vm);
+      return NATIVE_ERROR;
+   }
+   const char *piece = chars;
+   for (;;) {
+      // a single character separator, the common case, is a memchr
+      const char *found = separator_length == 1
+         ? memchr(piece, *separator, end - piece)
+         : memmem(piece, end - piece, separator, separator_length);
+      const char *piece_end = found != NULL ? found : end;
+
+      ObjSlice *slice = new_slice(vm, args[0], (int)(piece - chars),
+         (int)(piece_end - piece));
+      if (slice == NULL || !try_write_value_array(&pieces->items, OBJ_VAL(slice))) {
+         allocation_failed(vm);
+         return NATIVE_ERROR;
+      }
+
+      if (found == NULL) break;
+      piece = found + separator_length;
+   }
+
+   *result = OBJ_VAL(pieces);
+   return NATIVE_OK;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef KI_SLICE_H
+#define KI_SLICE_H
+
+#include "native.h"
+
+// String natives that return slices rather than copies
+// Cutting up a string costs one small object per piece whatever its
+// length, the characters stay where they are
+
+// substr(string, start, length)
+NativeResult substr_native(VM *vm, int arg_count, Value *args, Value *result);
+// split(string, separator), a list of the pieces between separators
+NativeResult split_native(VM *vm, int arg_count, Value *args, Value *result);
+
+#endif
\ No newline at end of file
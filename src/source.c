@@ -0,0 +1,105 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.h"
+
+static bool read_all_of(int fd, const char *path, Source *source);
+static size_t read_fd(void *context, char *buffer, size_t capacity);
+
+bool read_source(const char *path, Source *source) {
+   int fd = open(path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      fprintf(stderr, "Could not open file \"%s\"\n", path);
+      return false;
+   }
+
+   // mapped files aren't copied, which matters for generated scripts of
+   // hundreds of megabytes; empty files can't be mapped
+   struct stat status;
+   if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+      void *chars = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (chars != MAP_FAILED) {
+         // the scanner reads it front to back, once
+         madvise(chars, (size_t)status.st_size, MADV_SEQUENTIAL);
+         close(fd);
+         source->chars = (const char *)chars;
+         source->length = (size_t)status.st_size;
+         source->mapped = true;
+         return true;
+      }
+   }
+
+   bool read = read_all_of(fd, path, source);
+   close(fd);
+   return read;
+}
+
+void free_source(Source *source) {
+   if (source->mapped) {
+      munmap((void *)source->chars, source->length);
+   } else {
+      free((void *)source->chars);
+   }
+   source->chars = NULL;
+   source->length = 0;
+}
+
+void init_fd_reader(FdReader *reader, int fd, const char *name) {
+   reader->reader.read = read_fd;
+   reader->reader.context = reader;
+   reader->fd = fd;
+   reader->name = name;
+   reader->failed = false;
+}
+
+static bool read_all_of(int fd, const char *path, Source *source) {
+   size_t capacity = 4096;
+   size_t length = 0;
+   char *chars = (char *)malloc(capacity);
+   for (;;) {
+      if (chars == NULL) {
+         fprintf(stderr, "Not enough memory to read \"%s\"\n", path);
+         return false;
+      }
+      if (length == capacity) {
+         capacity *= 2;
+         char *grown = (char *)realloc(chars, capacity);
+         if (grown == NULL) free(chars);
+         chars = grown;
+         continue;
+      }
+
+      ssize_t count = read(fd, chars + length, capacity - length);
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) {
+         fprintf(stderr, "Could not read file \"%s\"\n", path);
+         free(chars);
+         return false;
+      }
+      if (count == 0) break;
+      length += (size_t)count;
+   }
+
+   source->chars = chars;
+   source->length = length;
+   source->mapped = false;
+   return true;
+}
+
+static size_t read_fd(void *context, char *buffer, size_t capacity) {
+   FdReader *reader = (FdReader *)context;
+   for (;;) {
+      ssize_t count = read(reader->fd, buffer, capacity);
+      if (count >= 0) return (size_t)count;
+      if (errno == EINTR) continue;
+      fprintf(stderr, "Could not read \"%s\": %s\n", reader->name, strerror(errno));
+      reader->failed = true;
+      return 0;
+   }
+}
\ No newline at end of file
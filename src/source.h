@@ -0,0 +1,33 @@
+#ifndef KI_SOURCE_H
+#define KI_SOURCE_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "scanner.h"
+
+// a script's text, [length] bytes at [chars] with no NUL after them
+typedef struct {
+   const char *chars;
+   size_t length;
+   // whether [chars] maps the file rather than being a heap copy
+   bool mapped;
+} Source;
+
+// maps the file, or reads it whole if it can't be mapped (pipes, ttys)
+// returns false, after reporting why, if the file can't be read
+bool read_source(const char *path, Source *source);
+void free_source(Source *source);
+
+// streams a file descriptor to the scanner, for stdin and pipes
+typedef struct {
+   SourceReader reader;
+   int fd;
+   const char *name;
+   // set, after reporting why, when a read failed
+   bool failed;
+} FdReader;
+
+void init_fd_reader(FdReader *reader, int fd, const char *name);
+
+#endif
\ No newline at end of file
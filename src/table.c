@@ -63,6 +63,21 @@ bool table_delete(Table *table, ObjString *key) {
    return true;
 }
 
+void table_stats(Table *table, TableStats *stats) {
+   stats->capacity = table->capacity;
+   stats->live = 0;
+   stats->tombstones = 0;
+   for (int i = 0; i < table->capacity; ++i) {
+      Entry *entry = &table->entries[i];
+      if (entry->key != NULL) {
+         ++stats->live;
+      } else if (!IS_NIL(entry->value)) {
+         ++stats->tombstones;
+      }
+   }
+   stats->load_factor = table->capacity == 0 ? 0.0 : (double)table->count / table->capacity;
+}
+
 static void adjust_capacity(Table *table, int capacity) {
    Entry *entries = ALLOCATE(Entry, capacity);
    for (int i = 0; i < capacity; ++i) {
@@ -14,6 +14,15 @@ typedef struct {
    Entry *entries;
 } Table;
 
+typedef struct {
+   int capacity;
+   int live;
+   // deleted entries still taking a slot until the table grows
+   int tombstones;
+   // (live + tombstones) / capacity, what decides when the table grows
+   double load_factor;
+} TableStats;
+
 void init_table(Table *table);
 void free_table(Table *table);
 // [value] is the output parameter
@@ -21,5 +30,6 @@ bool table_get(Table *table, ObjString *key, Value *value);
 bool table_set(Table *table, ObjString *key, Value value);
 bool table_delete(Table *table, ObjString *key);
 ObjString* table_find_string(Table *table, const char *chars, int length, uint32_t hash);
+void table_stats(Table *table, TableStats *stats);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include <unistd.h>
+
+#include "memory.h"
+#include "thread_pool.h"
+
+typedef struct {
+   ThreadPool *pool;
+   int index;
+} Worker;
+
+static void* worker_main(void *arg);
+static bool take_task(ThreadPool *pool, int index, Task *task);
+static void init_task_queue(TaskQueue *queue);
+static void free_task_queue(TaskQueue *queue);
+static void push_task(TaskQueue *queue, Task task);
+static bool pop_head(TaskQueue *queue, Task *task);
+static bool pop_tail(TaskQueue *queue, Task *task);
+static void grow_tasks(TaskQueue *queue);
+
+void init_thread_pool(ThreadPool *pool, int worker_count) {
+   pool->worker_count = worker_count;
+   pool->next_queue = 0;
+   atomic_init(&pool->queued, 0);
+   atomic_init(&pool->pending, 0);
+   pool->shutting_down = false;
+   pthread_mutex_init(&pool->lock, NULL);
+   pthread_cond_init(&pool->has_tasks, NULL);
+   pthread_cond_init(&pool->all_done, NULL);
+
+   pool->queues = ALLOCATE(TaskQueue, worker_count);
+   for (int i = 0; i < worker_count; ++i) {
+      init_task_queue(&pool->queues[i]);
+   }
+
+   pool->workers = ALLOCATE(pthread_t, worker_count);
+   for (int i = 0; i < worker_count; ++i) {
+      Worker *worker = ALLOCATE(Worker, 1);
+      worker->pool = pool;
+      worker->index = i;
+      pthread_create(&pool->workers[i], NULL, worker_main, worker);
+   }
+}
+
+void free_thread_pool(ThreadPool *pool) {
+   thread_pool_wait(pool);
+
+   pthread_mutex_lock(&pool->lock);
+   pool->shutting_down = true;
+   pthread_cond_broadcast(&pool->has_tasks);
+   pthread_mutex_unlock(&pool->lock);
+
+   // every worker has to be gone before any queue is freed, a worker
+   // may still be looking for work to steal in the others
+   for (int i = 0; i < pool->worker_count; ++i) {
+      pthread_join(pool->workers[i], NULL);
+   }
+   for (int i = 0; i < pool->worker_count; ++i) {
+      free_task_queue(&pool->queues[i]);
+   }
+
+   FREE_ARRAY(pool->workers, pthread_t, pool->worker_count);
+   FREE_ARRAY(pool->queues, TaskQueue, pool->worker_count);
+   pthread_mutex_destroy(&pool->lock);
+   pthread_cond_destroy(&pool->has_tasks);
+   pthread_cond_destroy(&pool->all_done);
+}
+
+void thread_pool_submit(ThreadPool *pool, TaskFn fn, void *arg) {
+   atomic_fetch_add(&pool->pending, 1);
+   // counted before it is pushed so [queued] never goes negative, a worker
+   // seeing it early just looks again
+   atomic_fetch_add(&pool->queued, 1);
+   push_task(&pool->queues[pool->next_queue], (Task) { fn, arg });
+   pool->next_queue = (pool->next_queue + 1) % pool->worker_count;
+
+   // workers only go to sleep while holding the lock and seeing no queued
+   // tasks, so signalling under the lock can't lose a wakeup
+   pthread_mutex_lock(&pool->lock);
+   pthread_cond_signal(&pool->has_tasks);
+   pthread_mutex_unlock(&pool->lock);
+}
+
+void thread_pool_wait(ThreadPool *pool) {
+   pthread_mutex_lock(&pool->lock);
+   while (atomic_load(&pool->pending) > 0) {
+      pthread_cond_wait(&pool->all_done, &pool->lock);
+   }
+   pthread_mutex_unlock(&pool->lock);
+}
+
+int cpu_count() {
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return count < 1 ? 1 : (int)count;
+}
+
+static void* worker_main(void *arg) {
+   Worker *worker = (Worker *)arg;
+   ThreadPool *pool = worker->pool;
+   int index = worker->index;
+   FREE(Worker, worker);
+
+   for (;;) {
+      Task task;
+      if (take_task(pool, index, &task)) {
+         task.fn(index, task.arg);
+
+         if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+            pthread_mutex_lock(&pool->lock);
+            pthread_cond_broadcast(&pool->all_done);
+            pthread_mutex_unlock(&pool->lock);
+         }
+         continue;
+      }
+
+      pthread_mutex_lock(&pool->lock);
+      while (atomic_load(&pool->queued) == 0 && !pool->shutting_down) {
+         pthread_cond_wait(&pool->has_tasks, &pool->lock);
+      }
+      bool done = atomic_load(&pool->queued) == 0;
+      pthread_mutex_unlock(&pool->lock);
+      if (done) break;
+   }
+   return NULL;
+}
+
+// takes the next task of the worker's own queue, or steals one from the
+// back of another worker's queue
+static bool take_task(ThreadPool *pool, int index, Task *task) {
+   bool found = pop_head(&pool->queues[index], task);
+   for (int i = 1; !found && i < pool->worker_count; ++i) {
+      found = pop_tail(&pool->queues[(index + i) % pool->worker_count], task);
+   }
+
+   if (found) atomic_fetch_sub(&pool->queued, 1);
+   return found;
+}
+
+static void init_task_queue(TaskQueue *queue) {
+   pthread_mutex_init(&queue->lock, NULL);
+   queue->tasks = NULL;
+   queue->head = 0;
+   queue->count = 0;
+   queue->capacity = 0;
+}
+
+static void free_task_queue(TaskQueue *queue) {
+   FREE_ARRAY(queue->tasks, Task, queue->capacity);
+   pthread_mutex_destroy(&queue->lock);
+}
+
+static void push_task(TaskQueue *queue, Task task) {
+   pthread_mutex_lock(&queue->lock);
+   if (queue->capacity < queue->count + 1) {
+      grow_tasks(queue);
+   }
+
+   queue->tasks[(queue->head + queue->count) % queue->capacity] = task;
+   ++queue->count;
+   pthread_mutex_unlock(&queue->lock);
+}
+
+static bool pop_head(TaskQueue *queue, Task *task) {
+   pthread_mutex_lock(&queue->lock);
+   bool found = queue->count > 0;
+   if (found) {
+      *task = queue->tasks[queue->head];
+      queue->head = (queue->head + 1) % queue->capacity;
+      --queue->count;
+   }
+   pthread_mutex_unlock(&queue->lock);
+   return found;
+}
+
+static bool pop_tail(TaskQueue *queue, Task *task) {
+   pthread_mutex_lock(&queue->lock);
+   bool found = queue->count > 0;
+   if (found) {
+      --queue->count;
+      *task = queue->tasks[(queue->head + queue->count) % queue->capacity];
+   }
+   pthread_mutex_unlock(&queue->lock);
+   return found;
+}
+
+static void grow_tasks(TaskQueue *queue) {
+   int old_capacity = queue->capacity;
+   int capacity = GROW_CAPACITY(old_capacity);
+   Task *tasks = ALLOCATE(Task, capacity);
+
+   // unwrap the circular queue into the front of the new array
+   for (int i = 0; i < queue->count; ++i) {
+      tasks[i] = queue->tasks[(queue->head + i) % old_capacity];
+   }
+
+   FREE_ARRAY(queue->tasks, Task, old_capacity);
+   queue->tasks = tasks;
+   queue->head = 0;
+   queue->capacity = capacity;
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef KI_THREAD_POOL_H
+#define KI_THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "common.h"
+
+// [worker] is the index of the thread running the task, so tasks can use
+// per worker state (a vm for example) without locking
+typedef void (*TaskFn)(int worker, void *arg);
+
+typedef struct {
+   TaskFn fn;
+   void *arg;
+} Task;
+
+// A double ended queue of tasks
+// The owning worker takes tasks from the head, idle workers steal from
+// the tail
+typedef struct {
+   pthread_mutex_t lock;
+   Task *tasks;
+   int head;
+   int count;
+   int capacity;
+} TaskQueue;
+
+// A fixed set of threads with a task queue each
+// Submitted tasks are spread over the queues and a worker whose queue
+// runs dry steals from the others, so one slow task doesn't hold up the
+// tasks queued behind it while other workers are idle
+typedef struct {
+   int worker_count;
+   pthread_t *workers;
+   TaskQueue *queues;
+   // queue the next submitted task goes to
+   int next_queue;
+
+   // tasks waiting in any queue
+   atomic_int queued;
+   // tasks submitted but not finished yet
+   atomic_int pending;
+
+   // only used to put idle workers to sleep and wake them up
+   pthread_mutex_t lock;
+   pthread_cond_t has_tasks;
+   pthread_cond_t all_done;
+   bool shutting_down;
+} ThreadPool;
+
+void init_thread_pool(ThreadPool *pool, int worker_count);
+// waits for the submitted tasks, then stops the workers
+void free_thread_pool(ThreadPool *pool);
+// must be called from a single thread at a time
+void thread_pool_submit(ThreadPool *pool, TaskFn fn, void *arg);
+// blocks until every submitted task has finished
+void thread_pool_wait(ThreadPool *pool);
+// number of cpus available, at least 1
+int cpu_count();
+
+#endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "memory.h"
+#include "tokens.h"
+
+static void grow_token_buffer(TokenBuffer *buffer);
+static int add_error(TokenBuffer *buffer, const char *message);
+static int line_at(TokenBuffer *buffer, int offset);
+
+void init_token_buffer(TokenBuffer *buffer) {
+   buffer->count = 0;
+   buffer->capacity = 0;
+   buffer->types = NULL;
+   buffer->offsets = NULL;
+   buffer->lengths = NULL;
+   buffer->source = NULL;
+   buffer->error_count = 0;
+   buffer->error_capacity = 0;
+   buffer->errors = NULL;
+   buffer->line_cursor_offset = 0;
+   buffer->line_cursor_line = 1;
+}
+
+void free_token_buffer(TokenBuffer *buffer) {
+   FREE_ARRAY(buffer->types, uint8_t, buffer->capacity);
+   FREE_ARRAY(buffer->offsets, int, buffer->capacity);
+   FREE_ARRAY(buffer->lengths, int, buffer->capacity);
+   FREE_ARRAY(buffer->errors, const char *, buffer->error_capacity);
+   init_token_buffer(buffer);
+}
+
+void tokenize(TokenBuffer *buffer, const char *source, size_t length) {
+   buffer->source = source;
+   Scanner scanner;
+   init_scanner(&scanner, source, length);
+
+   for (;;) {
+      Token token = scan_token(&scanner);
+
+      if (buffer->capacity < buffer->count + 1) {
+         grow_token_buffer(buffer);
+      }
+
+      int index = buffer->count++;
+      buffer->types[index] = (uint8_t)token.type;
+      if (token.type == TOKEN_ERROR) {
+         // error tokens point to their message, not into the source,
+         // so remember where the scanner was to still get the line
+         buffer->offsets[index] = (int)(scanner_position(&scanner) - source);
+         buffer->lengths[index] = add_error(buffer, token.start);
+      } else {
+         buffer->offsets[index] = (int)(token.start - source);
+         buffer->lengths[index] = token.length;
+      }
+
+      if (token.type == TOKEN_EOF) break;
+   }
+}
+
+Token token_at(TokenBuffer *buffer, int index) {
+   Token token;
+   token.type = (TokenType)buffer->types[index];
+   token.line = token_line(buffer, index);
+   if (token.type == TOKEN_ERROR) {
+      token.start = buffer->errors[buffer->lengths[index]];
+      token.length = (int)strlen(token.start);
+   } else {
+      token.start = buffer->source + buffer->offsets[index];
+      token.length = buffer->lengths[index];
+   }
+   return token;
+}
+
+int token_line(TokenBuffer *buffer, int index) {
+   return line_at(buffer, buffer->offsets[index]);
+}
+
+size_t token_buffer_size(TokenBuffer *buffer) {
+   return (size_t)buffer->capacity * (sizeof(uint8_t) + 2 * sizeof(int))
+      + (size_t)buffer->error_capacity * sizeof(const char *);
+}
+
+static void grow_token_buffer(TokenBuffer *buffer) {
+   int old_capacity = buffer->capacity;
+   buffer->capacity = GROW_CAPACITY(old_capacity);
+   buffer->types = GROW_ARRAY(buffer->types, uint8_t, old_capacity, buffer->capacity);
+   buffer->offsets = GROW_ARRAY(buffer->offsets, int, old_capacity, buffer->capacity);
+   buffer->lengths = GROW_ARRAY(buffer->lengths, int, old_capacity, buffer->capacity);
+}
+
+static int add_error(TokenBuffer *buffer, const char *message) {
+   if (buffer->error_capacity < buffer->error_count + 1) {
+      int old_capacity = buffer->error_capacity;
+      buffer->error_capacity = GROW_CAPACITY(old_capacity);
+      buffer->errors = GROW_ARRAY(buffer->errors, const char *,
+         old_capacity, buffer->error_capacity);
+   }
+
+   buffer->errors[buffer->error_count] = message;
+   return buffer->error_count++;
+}
+
+static int line_at(TokenBuffer *buffer, int offset) {
+   const char *source = buffer->source;
+   int cursor = buffer->line_cursor_offset;
+   int line = buffer->line_cursor_line;
+
+   // walk from the cursor towards [offset] in either direction
+   if (offset >= cursor) {
+      const char *end = source + offset;
+      const char *c = source + cursor;
+      while ((c = memchr(c, '\n', end - c)) != NULL) {
+         ++line;
+         ++c;
+      }
+   } else {
+      for (int i = offset; i < cursor; ++i) {
+         if (source[i] == '\n') --line;
+      }
+   }
+
+   buffer->line_cursor_offset = offset;
+   buffer->line_cursor_line = line;
+   return line;
+}
\ No newline at end of file
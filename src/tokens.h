@@ -0,0 +1,43 @@
+#ifndef KI_TOKENS_H
+#define KI_TOKENS_H
+
+#include "common.h"
+#include "scanner.h"
+
+// The whole source lexed up front, stored as parallel arrays
+// Tokens are 9 bytes each instead of a full Token, and any token can be
+// looked at in O(1) which gives the parser arbitrary lookahead
+typedef struct {
+   int count;
+   int capacity;
+   uint8_t *types;
+   // offset of the token start from the beginning of the source
+   int *offsets;
+   // token length, or for TOKEN_ERROR tokens the index of its message
+   // in [errors]
+   int *lengths;
+
+   const char *source;
+
+   int error_count;
+   int error_capacity;
+   const char **errors;
+
+   // line numbers are computed on demand by counting newlines from the
+   // last offset that was asked for, which is cheap when the parser
+   // walks the buffer in order
+   int line_cursor_offset;
+   int line_cursor_line;
+} TokenBuffer;
+
+void init_token_buffer(TokenBuffer *buffer);
+void free_token_buffer(TokenBuffer *buffer);
+// lexes [length] bytes of [source] up to and including the TOKEN_EOF token
+void tokenize(TokenBuffer *buffer, const char *source, size_t length);
+// rebuilds the Token at [index], [index] must be less than [count]
+Token token_at(TokenBuffer *buffer, int index);
+int token_line(TokenBuffer *buffer, int index);
+// bytes allocated by the buffer
+size_t token_buffer_size(TokenBuffer *buffer);
+
+#endif
\ No newline at end of file
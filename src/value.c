@@ -1,17 +1,33 @@
-#include <stdio.h>
-
 #include "value.h"
 #include "object.h"
 #include "memory.h"
+#include "number.h"
 
 static void grow_value_array(ValueArray *array);
 
-void print_value(Value value) {
+void write_value(Output *output, Value value) {
    switch(value.type) {
-      case VAL_BOOL: printf(AS_BOOL(value) ? "true" : "false"); break;
-      case VAL_NIL: printf("nil"); break;
-      case VAL_NUMBER: printf("%g", AS_NUMBER(value)); break;
-      case VAL_OBJ: print_obj(value); break;
+      case VAL_BOOL:
+         if (AS_BOOL(value)) {
+            output_write(output, "true", 4);
+         } else {
+            output_write(output, "false", 5);
+         }
+         break;
+      case VAL_NIL: output_write(output, "nil", 3); break;
+      case VAL_NUMBER: {
+         char buffer[NUMBER_BUFFER_SIZE];
+         int length = format_number(AS_NUMBER(value), buffer);
+         output_write(output, buffer, length);
+         break;
+      }
+      case VAL_INT: {
+         char buffer[NUMBER_BUFFER_SIZE];
+         int length = format_integer(AS_INT(value), buffer);
+         output_write(output, buffer, length);
+         break;
+      }
+      case VAL_OBJ: write_obj(output, value); break;
    }
 }
 
@@ -35,6 +51,21 @@ void write_value_array(ValueArray *array, Value value) {
    ++array->count;
 }
 
+bool try_write_value_array(ValueArray *array, Value value) {
+   if (array->capacity < array->count + 1) {
+      if (array->capacity > INT32_MAX / 2) return false;
+      int capacity = GROW_CAPACITY(array->capacity);
+      Value *values = TRY_GROW_ARRAY(array->values, Value, array->capacity, capacity);
+      if (values == NULL) return false;
+      array->values = values;
+      array->capacity = capacity;
+   }
+
+   array->values[array->count] = value;
+   ++array->count;
+   return true;
+}
+
 static void grow_value_array(ValueArray *array) {
    int old_capacity = array->capacity;
    array->capacity = GROW_CAPACITY(array->capacity);
@@ -2,6 +2,7 @@
 #define KI_VALUE_H
 
 #include "common.h"
+#include "output.h"
 
 typedef struct sObj Obj;
 typedef struct sObjString ObjString;
@@ -10,6 +11,8 @@ typedef enum {
    VAL_BOOL,
    VAL_NIL,
    VAL_NUMBER,
+   // 64 bit integers, promoted to numbers when they overflow
+   VAL_INT,
    VAL_OBJ
 } ValueType;
 
@@ -18,6 +21,7 @@ typedef struct {
    union {
       bool boolean;
       double number;
+      int64_t integer;
       Obj *obj;
    } as;
 } Value;
@@ -26,20 +30,32 @@ typedef struct {
 #define BOOL_VAL(value) ((Value) { VAL_BOOL, { .boolean = value } })
 #define NIL_VAL         ((Value) { VAL_NIL, { .number = 0 } })
 #define NUMBER_VAL(value) ((Value) {VAL_NUMBER, { .number = value } }) 
+#define INT_VAL(value) ((Value) { VAL_INT, { .integer = value } })
 #define OBJ_VAL(object) ((Value) { VAL_OBJ, { .obj = (Obj *)object }})
 
 // unpacks the real value from Value struct
 #define AS_BOOL(value) ((value).as.boolean)
 #define AS_NUMBER(value) ((value).as.number)
+#define AS_INT(value) ((value).as.integer)
 #define AS_OBJ(value) ((value).as.obj)
+// the value of an int or a number as a double
+#define AS_DOUBLE(value) as_double(value)
 
 // type checkers
 #define IS_BOOL(value) ((value).type == VAL_BOOL)
 #define IS_NIL(value) ((value).type == VAL_NIL)
 #define IS_NUMBER(value) ((value).type == VAL_NUMBER)
+#define IS_INT(value) ((value).type == VAL_INT)
 #define IS_OBJ(value) ((value).type == VAL_OBJ)
+// an int or a number
+#define IS_NUMERIC(value) (IS_NUMBER(value) || IS_INT(value))
 
-void print_value(Value value);
+static inline double as_double(Value value) {
+   return IS_INT(value) ? (double)AS_INT(value) : AS_NUMBER(value);
+}
+
+// [value]'s text into [output], for the print statement
+void write_value(Output *output, Value value);
 
 typedef struct {
    int capacity;
@@ -50,5 +66,8 @@ typedef struct {
 void init_value_array(ValueArray *array);
 void free_value_array(ValueArray *array);
 void write_value_array(ValueArray *array, Value value);
+// like write_value_array(), for arrays a script grows, returns false and
+// leaves [array] as it was if it can't grow, see try_reallocate()
+bool try_write_value_array(ValueArray *array, Value value);
 
 #endif
\ No newline at end of file
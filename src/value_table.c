@@ -0,0 +1,211 @@
+#include <math.h>
+#include <string.h>
+
+#include "memory.h"
+#include "object.h"
+#include "value_table.h"
+
+#define SLOT_FREE -1
+#define SLOT_DELETED -2
+
+static int32_t* find_slot(ValueTable *table, Value key, uint32_t hash);
+static bool rebuild(ValueTable *table, int capacity);
+static bool keys_equal(Value a, Value b);
+static uint32_t hash_bits(uint64_t bits);
+
+void init_value_table(ValueTable *table) {
+   table->count = 0;
+   table->used = 0;
+   table->capacity = 0;
+   table->entries = NULL;
+   table->slots = NULL;
+   table->slot_capacity = 0;
+}
+
+void free_value_table(ValueTable *table) {
+   FREE_ARRAY(table->entries, ValueEntry, table->capacity);
+   FREE_ARRAY(table->slots, int32_t, table->slot_capacity);
+   init_value_table(table);
+}
+
+bool value_table_reserve(ValueTable *table, int count) {
+   if (count <= table->capacity) return true;
+   return rebuild(table, count);
+}
+
+bool value_table_get(ValueTable *table, Value key, Value *value) {
+   if (table->count == 0) return false;
+
+   int32_t *slot = find_slot(table, key, hash_value(key));
+   if (*slot < 0) return false;
+
+   *value = table->entries[*slot].value;
+   return true;
+}
+
+bool value_table_set(ValueTable *table, Value key, Value value) {
+   uint32_t hash = hash_value(key);
+   if (table->count > 0) {
+      int32_t *slot = find_slot(table, key, hash);
+      if (*slot >= 0) {
+         table->entries[*slot].value = value;
+         return true;
+      }
+   }
+
+   if (table->used == table->capacity) {
+      // mostly deleted entries are compacted away rather than grown past
+      int capacity = table->count < table->used / 2
+         ? table->capacity : GROW_CAPACITY(table->capacity);
+      if (capacity > VALUE_TABLE_MAX) capacity = VALUE_TABLE_MAX;
+      if (capacity == table->used && table->count == table->used) return false;
+      if (!rebuild(table, capacity)) return false;
+   }
+
+   // a new key goes into the first free or removed slot of its chain
+   uint32_t mask = (uint32_t)table->slot_capacity - 1;
+   uint32_t index = hash & mask;
+   while (table->slots[index] >= 0) index = (index + 1) & mask;
+
+   ValueEntry *entry = &table->entries[table->used];
+   entry->key = key;
+   entry->value = value;
+   entry->hash = hash;
+   entry->deleted = false;
+   table->slots[index] = table->used;
+   ++table->used;
+   ++table->count;
+   return true;
+}
+
+bool value_table_delete(ValueTable *table, Value key) {
+   if (table->count == 0) return false;
+
+   int32_t *slot = find_slot(table, key, hash_value(key));
+   if (*slot < 0) return false;
+
+   ValueEntry *entry = &table->entries[*slot];
+   entry->deleted = true;
+   entry->key = NIL_VAL;
+   entry->value = NIL_VAL;
+   *slot = SLOT_DELETED;
+   --table->count;
+   return true;
+}
+
+uint32_t hash_value(Value value) {
+   switch (value.type) {
+   case VAL_NIL: return 0x9e3779b9u;
+   case VAL_BOOL: return AS_BOOL(value) ? 0x7f4a7c15u : 0x85ebca6bu;
+   case VAL_INT: return hash_bits((uint64_t)AS_INT(value));
+   case VAL_NUMBER: {
+      double number = AS_NUMBER(value);
+      // every NaN is one key
+      if (isnan(number)) return 0x7ff80000u;
+      // integral numbers hash like the int they equal, -0 like 0
+      if (number >= -9223372036854775808.0 && number < 9223372036854775808.0
+      && number == (double)(int64_t)number)
+      {
+      return hash_bits((uint64_t)(int64_t)number);
+      }
+      uint64_t bits;
+      memcpy(&bits, &number, sizeof(bits));
+      return hash_bits(bits);
+   }
+   case VAL_OBJ:
+      if (IS_STRING(value)) return AS_STRING(value)->hash;
+      return hash_bits((uint64_t)(uintptr_t)AS_OBJ(value));
+   }
+   return 0;
+}
+
+// the slot holding [key]'s entry, or the free slot ending its chain
+static int32_t* find_slot(ValueTable *table, Value key, uint32_t hash) {
+   uint32_t mask = (uint32_t)table->slot_capacity - 1;
+   uint32_t index = hash & mask;
+   for (;;) {
+      int32_t *slot = &table->slots[index];
+      if (*slot == SLOT_FREE) return slot;
+      if (*slot >= 0) {
+         ValueEntry *entry = &table->entries[*slot];
+         if (entry->hash == hash && keys_equal(entry->key, key)) return slot;
+      }
+      index = (index + 1) & mask;
+   }
+}
+
+// resizes the entries to [capacity], never less than they are, dropping
+// deleted ones, and indexes them again
+// false, with the table as it was, if the memory can't be had
+static bool rebuild(ValueTable *table, int capacity) {
+   if (capacity > VALUE_TABLE_MAX) return false;
+   // at most two thirds of the slots are ever taken
+   int64_t wanted = (int64_t)capacity + capacity / 2;
+   int slot_capacity = 8;
+   while (slot_capacity < wanted) slot_capacity *= 2;
+   int32_t *slots = TRY_ALLOCATE(int32_t, slot_capacity);
+   if (slots == NULL) return false;
+   ValueEntry *entries = TRY_GROW_ARRAY(table->entries, ValueEntry, table->capacity, capacity);
+   if (entries == NULL) {
+      FREE_ARRAY(slots, int32_t, slot_capacity);
+      return false;
+   }
+
+   int live = 0;
+   for (int i = 0; i < table->used; ++i) {
+      if (!entries[i].deleted) entries[live++] = entries[i];
+   }
+   table->entries = entries;
+   table->capacity = capacity;
+   table->used = live;
+   table->count = live;
+
+   FREE_ARRAY(table->slots, int32_t, table->slot_capacity);
+   table->slots = slots;
+   table->slot_capacity = slot_capacity;
+   for (int i = 0; i < slot_capacity; ++i) table->slots[i] = SLOT_FREE;
+
+   uint32_t mask = (uint32_t)slot_capacity - 1;
+   for (int i = 0; i < live; ++i) {
+      uint32_t index = table->entries[i].hash & mask;
+      while (table->slots[index] != SLOT_FREE) index = (index + 1) & mask;
+      table->slots[index] = i;
+   }
+   return true;
+}
+
+static bool keys_equal(Value a, Value b) {
+   if (IS_NUMERIC(a) && IS_NUMERIC(b)) {
+      if (IS_INT(a) && IS_INT(b)) return AS_INT(a) == AS_INT(b);
+      double x = AS_DOUBLE(a);
+      double y = AS_DOUBLE(b);
+      if (isnan(x) && isnan(y)) return true;
+      // exact for an int and a number, only when the number is integral
+      if (IS_INT(a) || IS_INT(b)) {
+         int64_t integer = IS_INT(a) ? AS_INT(a) : AS_INT(b);
+         double number = IS_INT(a) ? y : x;
+         return number >= -9223372036854775808.0 && number < 9223372036854775808.0
+            && (int64_t)number == integer && (double)integer == number;
+      }
+      return x == y;
+   }
+   if (a.type != b.type) return false;
+
+   switch (a.type) {
+   case VAL_NIL: return true;
+   case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
+   // interned strings and identity for everything else
+   case VAL_OBJ: return AS_OBJ(a) == AS_OBJ(b);
+   default: return false;
+   }
+}
+
+// the 64 bit finalizer of MurmurHash3, folded to 32 bits
+static uint32_t hash_bits(uint64_t bits) {
+   bits ^= bits >> 33;
+   bits *= 0xff51afd7ed558ccdull;
+   bits ^= bits >> 33;
+   bits *= 0xc4ceb9fe1a85ec53ull;
+   bits ^= bits >> 33;
+   return (uint32_t)bits;
+}
\ No newline at end of file
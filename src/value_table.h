@@ -0,0 +1,47 @@
+#ifndef KI_VALUE_TABLE_H
+#define KI_VALUE_TABLE_H
+
+#include "value.h"
+
+// the most entries a table holds, so its slots still fit an int
+#define VALUE_TABLE_MAX (1 << 29)
+
+typedef struct {
+   Value key;
+   Value value;
+   uint32_t hash;
+   // removed, skipped until the entries are compacted
+   bool deleted;
+} ValueEntry;
+
+// A hash table keyed by any value, remembering insertion order
+// Entries are stored densely in the order they were added, a separate
+// open addressed array of indices finds them by hash
+// Numbers are keys by value, 1 and 1.0 are the same key, -0 is 0 and
+// every NaN is the same key, strings by their characters since they
+// are interned, other objects by identity
+typedef struct {
+   // live entries
+   int count;
+   // entries used, deleted ones included
+   int used;
+   int capacity;
+   ValueEntry *entries;
+   // power of two, -1 marks a free slot and -2 a removed one
+   int32_t *slots;
+   int slot_capacity;
+} ValueTable;
+
+void init_value_table(ValueTable *table);
+void free_value_table(ValueTable *table);
+// makes room for [count] entries without growing again
+// the table never grows past VALUE_TABLE_MAX entries, it grows through try_reallocate(), this and value_table_set()
+// return false, leaving it as it was, if it couldn't
+bool value_table_reserve(ValueTable *table, int count);
+// [value] is the output parameter
+bool value_table_get(ValueTable *table, Value key, Value *value);
+bool value_table_set(ValueTable *table, Value key, Value value);
+bool value_table_delete(ValueTable *table, Value key);
+uint32_t hash_value(Value value);
+
+#endif
\ No newline at end of file
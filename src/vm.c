@@ -1,35 +1,113 @@
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include "common.h"
 #include "memory.h"
 #include "debug.h"
 #include "compiler.h"
+#include "native.h"
 #include "vm.h"
 #include "value.h"
 #include "object.h"
 
 static void reset_stack(VM *vm);
+static InterpretResult compile_and_run(VM *vm, const char *source, size_t length,
+   SourceReader *reader);
 static InterpretResult run(VM *vm);
+static InterpretResult run_profiled(VM *vm);
+static InterpretResult run_traced(VM *vm);
+static InterpretResult run_limited(VM *vm);
+static void start_limits(VM *vm);
+static InterpretResult limit_exceeded(VM *vm);
+static InterpretResult out_of_memory(VM *vm);
+static void memory_limit_error(VM *vm);
+static InterpretResult time_exceeded(VM *vm);
+static bool past_deadline(VM *vm);
+static void trace_instruction(VM *vm);
 static bool is_falsy(Value value);
 static bool values_equal(Value a, Value b);
-static void concatenate(VM *vm);
-static void runtime_error(VM *vm, const char *format, ...);
+static bool int_equals_number(int64_t integer, double number);
+static bool concatenate(VM *vm);
+static bool check_index(VM *vm, Value index, int count, int *slot);
+static void schedule_fiber(VM *vm, Fiber *fiber);
+static void switch_fiber(VM *vm);
+static void load_next_fiber(VM *vm);
+static void suspend_fiber(VM *vm);
+static bool wake_fibers(VM *vm, int timeout);
 
 void init_vm(VM *vm) {
    vm->objects = NULL;
+   vm->batch_lexing = false;
+   vm->profile = NULL;
+   vm->disassembly = NULL;
+   vm->trace = NULL;
+   vm->sampler = NULL;
+   init_memory_stats(&vm->memory);
+   vm->limits = (Limits) { 0 };
+   vm->sliced = false;
    init_table(&vm->strings);
+   vm->fiber = &vm->main_fiber;
+   vm->ready_head = NULL;
+   init_event_loop(&vm->events);
+   init_output(&vm->output);
+   vm->errors = stderr;
    reset_stack(vm);
 }
 
 static void reset_stack(VM *vm) {
+   // fibers don't outlive the script that spawned them
+   if (vm->fiber != NULL && vm->fiber != &vm->main_fiber) {
+      free_fiber(vm->fiber);
+   }
+   while (vm->ready_head != NULL) {
+      Fiber *fiber = vm->ready_head;
+      vm->ready_head = fiber->next;
+      if (fiber != &vm->main_fiber) free_fiber(fiber);
+   }
+   vm->ready_tail = NULL;
+   Fiber *parked = event_loop_clear(&vm->events);
+   while (parked != NULL) {
+      Fiber *fiber = parked;
+      parked = fiber->next;
+      if (fiber != &vm->main_fiber) free_fiber(fiber);
+   }
+
+   vm->main_fiber.ip = NULL;
+   vm->main_fiber.stack = vm->stack;
+   vm->main_fiber.stack_top = vm->stack;
+   vm->main_fiber.stack_size = STACK_MAX;
+   vm->main_fiber.next = NULL;
+   vm->fiber = &vm->main_fiber;
    vm->stack_top = vm->stack;
 }
 
 void free_vm(VM *vm) {
+   MemoryStats *previous = use_memory_stats(&vm->memory);
+   reset_stack(vm);
+   free_event_loop(&vm->events);
+   free_output(&vm->output);
    free_table(&vm->strings);
    free_objects(vm->objects);
+   use_memory_stats(previous);
+}
+
+void write_vm_memory_stats(VM *vm, FILE *file) {
+   write_memory_stats(&vm->memory, file);
+
+   TableStats strings;
+   table_stats(&vm->strings, &strings);
+   fprintf(file, "intern table:     %d live, %d tombstones, capacity %d, load %.3f\n",
+      strings.live, strings.tombstones, strings.capacity, strings.load_factor);
+}
+
+void reset_vm(VM *vm) {
+   free_vm(vm);
+   vm->objects = NULL;
+   init_table(&vm->strings);
+   reset_stack(vm);
 }
 
 void push(VM *vm, Value value) {
@@ -48,58 +126,211 @@ Value peek(VM *vm, int distance) {
    return vm->stack_top[-1 - distance];
 }
 
-InterpretResult interpret(VM *vm, const char *source) {
+InterpretResult interpret(VM *vm, const char *source, size_t length) {
+   return compile_and_run(vm, source, length, NULL);
+}
+
+InterpretResult interpret_stream(VM *vm, SourceReader *reader) {
+   return compile_and_run(vm, NULL, 0, reader);
+}
+
+static InterpretResult compile_and_run(VM *vm, const char *source, size_t length,
+   SourceReader *reader)
+{
+   MemoryStats *previous = use_memory_stats(&vm->memory);
    Chunk chunk;
    init_chunk(&chunk);
 
-   if (!compile(source, vm, &chunk)) {
+   bool compiled = reader != NULL ? compile_stream(reader, vm, &chunk)
+      : compile(source, length, vm, &chunk);
+   if (vm->disassembly != NULL) flush_output(vm->disassembly);
+   InterpretResult result = INTERPRET_COMPILE_ERROR;
+   if (compiled) result = interpret_chunk(vm, &chunk);
+
    free_chunk(&chunk);
-   return INTERPRET_COMPILE_ERROR;
-   }
+   use_memory_stats(previous);
+   return result;
+}
 
-   vm->chunk = &chunk;
+InterpretResult interpret_chunk(VM *vm, Chunk *chunk) {
+   vm->chunk = chunk;
    vm->ip = vm->chunk->code;
+   start_limits(vm);
+   // the sampler is signal driven, the run loop doesn't know about it
+   if (vm->sampler != NULL) sampler_enter(vm->sampler, chunk);
 
-   InterpretResult result = run(vm);
-   
-   free_chunk(&chunk);
+   InterpretResult result;
+   if (vm->trace != NULL) {
+      result = run_traced(vm);
+      flush_output(vm->trace);
+   } else if (vm->limits.memory > 0 || vm->limits.steps > 0
+      || vm->limits.milliseconds > 0)
+   {
+      result = run_limited(vm);
+   } else if (vm->profile != NULL) {
+      result = run_profiled(vm);
+   } else {
+      result = run(vm);
+   }
+   if (vm->sampler != NULL) sampler_leave(vm->sampler, chunk);
+   flush_output(&vm->output);
    return result;
 }
 
-static InterpretResult run(VM *vm) {
+void init_script_context(VM *vm, ScriptContext *context) {
+   context->stack = ALLOCATE(Value, STACK_MAX);
+   context->chunk = NULL;
+   context->ip = NULL;
+   context->stack_top = context->stack;
+   context->fiber = &vm->main_fiber;
+   context->main_fiber = (Fiber) {
+      .ip = NULL,
+      .stack = context->stack,
+      .stack_top = context->stack,
+      .stack_size = STACK_MAX,
+      .next = NULL
+   };
+   context->ready_head = NULL;
+   context->ready_tail = NULL;
+   init_event_loop(&context->events);
+   init_table(&context->strings);
+   context->objects = NULL;
+   context->steps = 0;
+   context->deadline = INT64_MAX;
+}
+
+void free_script_context(VM *vm, ScriptContext *context) {
+   swap_script_context(vm, context);
+   reset_stack(vm);
+   free_event_loop(&vm->events);
+   free_table(&vm->strings);
+   free_objects(vm->objects);
+   vm->objects = NULL;
+   swap_script_context(vm, context);
+   FREE_ARRAY(context->stack, Value, STACK_MAX);
+}
+
+void swap_script_context(VM *vm, ScriptContext *context) {
+   #define SWAP(type, field) \
+   do { \
+      type swapped = vm->field; \
+      vm->field = context->field; \
+      context->field = swapped; \
+   } while (false)
+
+   SWAP(Chunk *, chunk);
+   SWAP(uint8_t *, ip);
+   SWAP(Value *, stack_top);
+   SWAP(Fiber *, fiber);
+   SWAP(Fiber, main_fiber);
+   SWAP(Fiber *, ready_head);
+   SWAP(Fiber *, ready_tail);
+   SWAP(EventLoop, events);
+   SWAP(Table, strings);
+   SWAP(Obj *, objects);
+   SWAP(uint64_t, steps);
+   SWAP(int64_t, deadline);
+
+   #undef SWAP
+}
+
+void start_script(VM *vm, Chunk *chunk) {
+   vm->chunk = chunk;
+   vm->ip = chunk->code;
+   start_limits(vm);
+}
+
+InterpretResult run_slice(VM *vm, uint64_t quantum) {
+   if (vm->fiber == NULL) {
+      wake_fibers(vm, 0);
+      if (vm->ready_head == NULL) {
+         if (past_deadline(vm)) return time_exceeded(vm);
+         return INTERPRET_WAITING;
+      }
+      load_next_fiber(vm);
+   }
+
+   // the slice ends in the same check as the step limit
+   uint64_t limit = vm->limits.steps > 0 ? vm->limits.steps : UINT64_MAX;
+   vm->step_limit = limit - vm->steps > quantum ? vm->steps + quantum : limit;
+   vm->sliced = true;
+   InterpretResult result = run_limited(vm);
+   vm->sliced = false;
+   return result;
+}
+
+// the run loop is instantiated once per mode, [profiling] and [tracing]
+// fold away in each so the plain one pays nothing for either
+static inline __attribute__((always_inline)) InterpretResult run_loop(VM *vm,
+   bool profiling, bool tracing, bool limited)
+{
    #define READ_BYTE() (*vm->ip++)
    #define READ_CONSTANT() (vm->chunk->constants.values[READ_BYTE()])
+   #define READ_SHORT() (vm->ip += 2, (uint16_t)(vm->ip[-2] << 8 | vm->ip[-1]))
    
    #define BINARY_OP(result_type, op) \
    do { \
-      if (!IS_NUMBER(peek(vm, 0)) || !IS_NUMBER(peek(vm, 1))) { \
+      if (!IS_NUMERIC(peek(vm, 0)) || !IS_NUMERIC(peek(vm, 1))) { \
          runtime_error(vm, "Operands must be numbers"); \
          return INTERPRET_RUNTIME_ERROR; \
       } \
-      double b = AS_NUMBER(pop(vm)); \
-      double a = AS_NUMBER(pop(vm)); \
+      double b = AS_DOUBLE(pop(vm)); \
+      double a = AS_DOUBLE(pop(vm)); \
       push(vm, result_type(a op b)); \
    } while (false)
 
+   // two ints compare as ints, exactly
+   #define COMPARISON_OP(op) \
+   do { \
+      if (IS_INT(peek(vm, 0)) && IS_INT(peek(vm, 1))) { \
+         int64_t b = AS_INT(pop(vm)); \
+         int64_t a = AS_INT(pop(vm)); \
+         push(vm, BOOL_VAL(a op b)); \
+      } else { \
+         BINARY_OP(BOOL_VAL, op); \
+      } \
+   } while (false)
+
+   // two ints give an int, unless the result doesn't fit one and is
+   // promoted to a number
+   #define ARITHMETIC_OP(overflows, op) \
+   do { \
+      if (IS_INT(peek(vm, 0)) && IS_INT(peek(vm, 1))) { \
+         int64_t b = AS_INT(pop(vm)); \
+         int64_t a = AS_INT(pop(vm)); \
+         int64_t result; \
+         if (overflows(a, b, &result)) { \
+            push(vm, NUMBER_VAL((double)a op (double)b)); \
+         } else { \
+            push(vm, INT_VAL(result)); \
+         } \
+      } else { \
+         BINARY_OP(NUMBER_VAL, op); \
+      } \
+   } while (false)
+
    for (;;) {
 
-#ifdef DEBUG_TRACE_EXECUTION
-   printf("         ");
-   for (Value *slot = vm->stack; slot < vm->stack_top; ++slot) {
-      printf("[ ");
-      print_value(*slot);
-      printf(" ]");
+   // the clock is only read every 1024 instructions, a script overruns
+   // its time by that many at most
+   if (limited && (++vm->steps > vm->step_limit
+      || vm->memory.bytes > vm->memory.limit
+      || ((vm->steps & 1023) == 0 && now_milliseconds() > vm->deadline)))
+   {
+      return limit_exceeded(vm);
    }
-   printf("\n");
-   disassemble_instruction(vm->chunk, (int)(vm->ip - vm->chunk->code));
-#endif
+
+   if (profiling) {
+      profile_instruction(vm->profile, *vm->ip, vm->chunk->lines[vm->ip - vm->chunk->code]);
+   }
+
+   if (tracing) trace_instruction(vm);
 
    uint8_t instruction;
    switch(instruction = READ_BYTE()) {
       case OP_CONSTANT: {
       Value constant = READ_CONSTANT();
       push(vm, constant);
-      printf("\n");
       break;
       }
       case OP_NIL: push(vm, NIL_VAL); break;
@@ -111,92 +342,491 @@ static InterpretResult run(VM *vm) {
       push(vm, BOOL_VAL(values_equal(a, b)));
       break;
       }
-      case OP_GREATER: BINARY_OP(BOOL_VAL, >); break;
-      case OP_LESS: BINARY_OP(BOOL_VAL, <); break;
+      case OP_GREATER: COMPARISON_OP(>); break;
+      case OP_LESS: COMPARISON_OP(<); break;
       case OP_ADD: {
-      if (IS_STRING(peek(vm, 0)) && IS_STRING(peek(vm, 1))) {
-         concatenate(vm);
-      } else if (IS_NUMBER(peek(vm, 0)) && IS_NUMBER(peek(vm, 1))) {
-         double b = AS_NUMBER(pop(vm));
-         double a = AS_NUMBER(pop(vm));
-         push(vm, NUMBER_VAL(a + b));
+      if (IS_TEXT(peek(vm, 0)) && IS_TEXT(peek(vm, 1))) {
+         if (!concatenate(vm)) return out_of_memory(vm);
+      } else if (IS_NUMERIC(peek(vm, 0)) && IS_NUMERIC(peek(vm, 1))) {
+         ARITHMETIC_OP(__builtin_add_overflow, +);
       } else {
          runtime_error(vm, "Operands must be two numbers or two strings");
          return INTERPRET_RUNTIME_ERROR;
       }
       break;
       }
-      case OP_SUBTRACT: BINARY_OP(NUMBER_VAL, -); break;
-      case OP_MULTIPLY: BINARY_OP(NUMBER_VAL, *); break;
+      case OP_SUBTRACT: ARITHMETIC_OP(__builtin_sub_overflow, -); break;
+      case OP_MULTIPLY: ARITHMETIC_OP(__builtin_mul_overflow, *); break;
+      // always a number, 1 / 2 is 0.5
       case OP_DIVIDE: BINARY_OP(NUMBER_VAL, /); break;
       case OP_NOT:
          push(vm, BOOL_VAL(is_falsy(pop(vm)))); break;
       case OP_NEGATE:
-      if (!IS_NUMBER(peek(vm, 0))) {
+      if (IS_INT(peek(vm, 0)) && AS_INT(peek(vm, 0)) != INT64_MIN) {
+         push(vm, INT_VAL(-AS_INT(pop(vm))));
+         break;
+      }
+      if (!IS_NUMERIC(peek(vm, 0))) {
          runtime_error(vm, "Operand must be a number");
          return INTERPRET_RUNTIME_ERROR;
       }
 
-      push(vm, NUMBER_VAL(-AS_NUMBER(pop(vm))));
+      push(vm, NUMBER_VAL(-AS_DOUBLE(pop(vm))));
       break;
       case OP_POP: pop(vm); break;
+      case OP_BUILD_LIST: {
+      int count = READ_BYTE();
+      ObjList *list = new_list(vm, count);
+      if (list == NULL) return out_of_memory(vm);
+      if (count > 0) {
+         memcpy(list->items.values, vm->stack_top - count, count * sizeof(Value));
+      }
+      list->items.count = count;
+      vm->stack_top -= count;
+      push(vm, OBJ_VAL(list));
+      break;
+      }
+      case OP_BUILD_MAP: {
+      int count = READ_BYTE();
+      ObjMap *map = new_map(vm);
+      if (!value_table_reserve(&map->table, count)) return out_of_memory(vm);
+      // later keys win, like assigning them in order
+      for (Value *pair = vm->stack_top - 2 * count; pair < vm->stack_top; pair += 2) {
+         value_table_set(&map->table, map_key(vm, pair[0]), pair[1]);
+      }
+      vm->stack_top -= 2 * count;
+      push(vm, OBJ_VAL(map));
+      break;
+      }
+      case OP_GET_INDEX: {
+      int slot;
+      if (IS_MAP(peek(vm, 1))) {
+         // a missing key reads as nil
+         Value value;
+         Value key = map_key(vm, peek(vm, 0));
+         if (!value_table_get(&AS_MAP(peek(vm, 1))->table, key, &value)) value = NIL_VAL;
+         vm->stack_top -= 2;
+         push(vm, value);
+      } else if (IS_LIST(peek(vm, 1))) {
+         ValueArray *items = &AS_LIST(peek(vm, 1))->items;
+         if (!check_index(vm, peek(vm, 0), items->count, &slot)) {
+            return INTERPRET_RUNTIME_ERROR;
+         }
+         vm->stack_top -= 2;
+         push(vm, items->values[slot]);
+      } else if (IS_TEXT(peek(vm, 1))) {
+         Value text = peek(vm, 1);
+         if (!check_index(vm, peek(vm, 0), text_length(text), &slot)) {
+            return INTERPRET_RUNTIME_ERROR;
+         }
+         vm->stack_top -= 2;
+         push(vm, OBJ_VAL(copy_string(vm, text_chars(text) + slot, 1)));
+      } else {
+         runtime_error(vm, "Can only index lists, maps and strings");
+         return INTERPRET_RUNTIME_ERROR;
+      }
+      break;
+      }
+      case OP_SET_INDEX: {
+      if (IS_MAP(peek(vm, 2))) {
+         Value value = pop(vm);
+         Value key = map_key(vm, pop(vm));
+         if (!value_table_set(&AS_MAP(peek(vm, 0))->table, key, value)) {
+            return out_of_memory(vm);
+         }
+         pop(vm);
+         push(vm, value);
+         break;
+      }
+      if (!IS_LIST(peek(vm, 2))) {
+         runtime_error(vm, "Can only assign to list and map elements");
+         return INTERPRET_RUNTIME_ERROR;
+      }
+      ValueArray *items = &AS_LIST(peek(vm, 2))->items;
+      int slot;
+      if (!check_index(vm, peek(vm, 1), items->count, &slot)) {
+         return INTERPRET_RUNTIME_ERROR;
+      }
+      // the assignment's value is the value assigned
+      Value value = pop(vm);
+      items->values[slot] = value;
+      vm->stack_top -= 2;
+      push(vm, value);
+      break;
+      }
+      case OP_CALL_NATIVE: {
+      const Native *native = &natives[READ_BYTE()];
+      int arg_count = READ_BYTE();
+      Value result;
+      NativeResult status = native->function(vm, arg_count, vm->stack_top - arg_count, &result);
+      if (status == NATIVE_ERROR) {
+         if (vm->memory.over_limit) return INTERPRET_MEMORY_LIMIT;
+         // natives that wait give up when the script runs out of time
+         if (limited && past_deadline(vm)) {
+            return INTERPRET_BUDGET_EXCEEDED;
+         }
+         return INTERPRET_RUNTIME_ERROR;
+      }
+      if (status == NATIVE_BLOCK) {
+         // the arguments stay on the stack and the call runs again once
+         // the fiber is woken up
+         vm->ip -= 3;
+         if (limited && vm->sliced && vm->ready_head == NULL) {
+            // the scheduler runs the other scripts meanwhile
+            suspend_fiber(vm);
+            return INTERPRET_WAITING;
+         }
+         while (vm->ready_head == NULL) {
+            if (!wake_fibers(vm, -1)) {
+               // the fiber is parked, the event loop frees it
+               vm->fiber = &vm->main_fiber;
+               return time_exceeded(vm);
+            }
+         }
+         switch_fiber(vm);
+         break;
+      }
+      vm->stack_top -= arg_count;
+      push(vm, result);
+      break;
+      }
       case OP_PRINT:
-      print_value(pop(vm));
-      printf("\n");
+      write_value(&vm->output, pop(vm));
+      output_char(&vm->output, '\n');
+      break;
+      case OP_SPAWN: {
+      int stack_size = READ_BYTE();
+      uint16_t body_length = READ_SHORT();
+      schedule_fiber(vm, new_fiber(vm->ip, stack_size));
+      vm->ip += body_length;
       break;
+      }
+      case OP_YIELD:
+      if (vm->events.waiting > 0) wake_fibers(vm, 0);
+      if (vm->ready_head != NULL) {
+         schedule_fiber(vm, vm->fiber);
+         switch_fiber(vm);
+      }
+      break;
+      case OP_END_FIBER: {
+      Fiber *finished = vm->fiber;
+      if (limited && vm->sliced && vm->ready_head == NULL
+         && vm->events.waiting > 0)
+      {
+         free_fiber(finished);
+         vm->fiber = NULL;
+         return INTERPRET_WAITING;
+      }
+      while (vm->ready_head == NULL && vm->events.waiting > 0) {
+         if (!wake_fibers(vm, -1)) return time_exceeded(vm);
+      }
+      if (vm->ready_head == NULL) {
+         // the script returned earlier and this was its last fiber, the
+         // stack goes back to the main fiber's for the next script
+         reset_stack(vm);
+         return INTERPRET_OK;
+      }
+      switch_fiber(vm);
+      free_fiber(finished);
+      break;
+      }
       case OP_RETURN:
-      return INTERPRET_OK;
+      // the script is done but the fibers it spawned may not be
+      if (limited && vm->sliced && vm->ready_head == NULL
+         && vm->events.waiting > 0)
+      {
+         suspend_fiber(vm);
+         return INTERPRET_WAITING;
+      }
+      while (vm->ready_head == NULL && vm->events.waiting > 0) {
+         if (!wake_fibers(vm, -1)) return time_exceeded(vm);
+      }
+      if (vm->ready_head == NULL) return INTERPRET_OK;
+      switch_fiber(vm);
+      break;
    }
    }
 
    #undef READ_BYTE
    #undef READ_CONSTANT
+   #undef READ_SHORT
    #undef BINARY_OP
+   #undef COMPARISON_OP
+   #undef ARITHMETIC_OP
+}
+
+static InterpretResult run(VM *vm) {
+   return run_loop(vm, false, false, false);
+}
+
+static InterpretResult run_profiled(VM *vm) {
+   profile_start(vm->profile);
+   InterpretResult result = run_loop(vm, true, false, false);
+   profile_stop(vm->profile);
+   return result;
+}
+
+// tracing is slow anyway, the profiler is checked as it goes
+static InterpretResult run_traced(VM *vm) {
+   bool profiling = vm->profile != NULL;
+   if (profiling) profile_start(vm->profile);
+   bool limited = vm->limits.memory > 0 || vm->limits.steps > 0
+      || vm->limits.milliseconds > 0;
+   InterpretResult result = run_loop(vm, profiling, true, limited);
+   if (profiling) profile_stop(vm->profile);
+   return result;
+}
+
+// the plain loop never looks at the limits, scripts with any run this one
+static InterpretResult run_limited(VM *vm) {
+   bool profiling = vm->profile != NULL;
+   if (profiling) profile_start(vm->profile);
+   InterpretResult result = run_loop(vm, profiling, false, true);
+   if (profiling) profile_stop(vm->profile);
+   return result;
+}
+
+static void start_limits(VM *vm) {
+   Limits *limits = &vm->limits;
+   vm->steps = 0;
+   vm->step_limit = limits->steps > 0 ? limits->steps : UINT64_MAX;
+   vm->memory.limit = limits->memory > 0 ? limits->memory : INT64_MAX;
+   vm->memory.over_limit = false;
+   vm->deadline = INT64_MAX;
+   if (limits->milliseconds > 0) {
+      vm->deadline = now_milliseconds() + limits->milliseconds;
+   }
+}
+
+// the limits are checked before the instruction is read, [ip] is at the
+// one that would have gone over
+// under a scheduler [step_limit] may only be the end of the slice
+static InterpretResult limit_exceeded(VM *vm) {
+   if (vm->memory.bytes > vm->memory.limit) {
+      memory_limit_error(vm);
+      return INTERPRET_MEMORY_LIMIT;
+   }
+   if (vm->limits.steps > 0 && vm->steps > vm->limits.steps) {
+      runtime_error(vm, "Step limit of %llu instructions exceeded",
+         (unsigned long long)vm->limits.steps);
+      return INTERPRET_BUDGET_EXCEEDED;
+   }
+   if (past_deadline(vm)) return time_exceeded(vm);
+
+   // the instruction runs in the next slice
+   --vm->steps;
+   return INTERPRET_PREEMPTED;
+}
+
+// an instruction's allocation was refused, see try_reallocate()
+static InterpretResult out_of_memory(VM *vm) {
+   allocation_failed(vm);
+   return vm->memory.over_limit ? INTERPRET_MEMORY_LIMIT : INTERPRET_RUNTIME_ERROR;
+}
+
+void allocation_failed(VM *vm) {
+   if (vm->memory.over_limit) {
+      memory_limit_error(vm);
+   } else {
+      runtime_error(vm, "Out of memory");
+   }
+}
+
+static void memory_limit_error(VM *vm) {
+   runtime_error(vm, "Memory limit of %lld bytes exceeded", (long long)vm->memory.limit);
+}
+
+static InterpretResult time_exceeded(VM *vm) {
+   runtime_error(vm, "Time limit of %lld ms exceeded",
+      (long long)vm->limits.milliseconds);
+   return INTERPRET_BUDGET_EXCEEDED;
+}
+
+static bool past_deadline(VM *vm) {
+   return vm->deadline != INT64_MAX && now_milliseconds() > vm->deadline;
+}
+
+int64_t now_milliseconds() {
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+bool out_of_time(VM *vm) {
+   if (!past_deadline(vm)) return false;
+
+   time_exceeded(vm);
+   return true;
+}
+
+static void trace_instruction(VM *vm) {
+   output_write(vm->trace, "         ", 9);
+   for (Value *slot = vm->fiber->stack; slot < vm->stack_top; ++slot) {
+      output_write(vm->trace, "[ ", 2);
+      write_value(vm->trace, *slot);
+      output_write(vm->trace, " ]", 2);
+   }
+   output_char(vm->trace, '\n');
+   disassemble_instruction(vm->trace, vm->chunk, (int)(vm->ip - vm->chunk->code));
 }
 
 static bool is_falsy(Value value) {
    if (IS_BOOL(value) && AS_BOOL(value) == false) return true;
    if (IS_NIL(value)) return true;
    if (IS_NUMBER(value) && AS_NUMBER(value) == 0) return true;
+   if (IS_INT(value) && AS_INT(value) == 0) return true;
 
    return false;
 }
 
 static bool values_equal(Value a, Value b) {
+   // 1 == 1.0, but only if the number is exactly that int
+   if (IS_INT(a) && IS_NUMBER(b)) return int_equals_number(AS_INT(a), AS_NUMBER(b));
+   if (IS_NUMBER(a) && IS_INT(b)) return int_equals_number(AS_INT(b), AS_NUMBER(a));
    if (a.type != b.type) return false;
 
    switch(a.type) {
    case VAL_BOOL: return AS_BOOL(a) == AS_BOOL(b);
    case VAL_NIL: return true;
    case VAL_NUMBER: return AS_NUMBER(a) == AS_NUMBER(b);
+   case VAL_INT: return AS_INT(a) == AS_INT(b);
    case VAL_OBJ:
+      // slices compare by their characters, with strings too
+      if (IS_TEXT(a) && IS_TEXT(b)) return texts_equal(a, b);
       return AS_OBJ(a) == AS_OBJ(b);
    }
+   return false;
 }
 
-static void concatenate(VM *vm) {
-   ObjString *b = AS_STRING(pop(vm));
-   ObjString *a = AS_STRING(pop(vm));
+static bool int_equals_number(int64_t integer, double number) {
+   // the range where converting to int64_t is defined, 2^63 excluded
+   if (!(number >= -9223372036854775808.0 && number < 9223372036854775808.0)) {
+      return false;
+   }
+   return (int64_t)number == integer && (double)integer == number;
+}
+
+// false, leaving the operands on the stack, if the result can't be
+// allocated
+static bool concatenate(VM *vm) {
+   Value b = peek(vm, 0);
+   Value a = peek(vm, 1);
 
-   int length = a->length + b->length;
-   char *chars = ALLOCATE(char, length + 1);
-   memcpy(chars, a->chars, a->length);
-   memcpy(chars + a->length, b->chars, b->length);
+   int64_t length = (int64_t)text_length(a) + text_length(b);
+   char *chars = length < INT32_MAX ? TRY_ALLOCATE(char, length + 1) : NULL;
+   if (chars == NULL) return false;
+   vm->stack_top -= 2;
+   memcpy(chars, text_chars(a), text_length(a));
+   memcpy(chars + text_length(a), text_chars(b), text_length(b));
    chars[length] = '\0';
 
-   ObjString *result = take_string(vm, chars, length);
+   ObjString *result = take_string(vm, chars, (int)length);
    push(vm, OBJ_VAL(result));
+   return true;
+}
+
+// checks that [index] is an int within [0, count) and stores it in [slot]
+static bool check_index(VM *vm, Value index, int count, int *slot) {
+   if (!IS_INT(index)) {
+      runtime_error(vm, "Index must be an integer");
+      return false;
+   }
+   if (AS_INT(index) < 0 || AS_INT(index) >= count) {
+      runtime_error(vm, "Index %lld out of bounds for length %d",
+         (long long)AS_INT(index), count);
+      return false;
+   }
+
+   *slot = (int)AS_INT(index);
+   return true;
+}
+
+// puts [fiber] at the back of the ready queue
+static void schedule_fiber(VM *vm, Fiber *fiber) {
+   fiber->next = NULL;
+   if (vm->ready_tail == NULL) {
+      vm->ready_head = fiber;
+   } else {
+      vm->ready_tail->next = fiber;
+   }
+   vm->ready_tail = fiber;
 }
 
-static void runtime_error(VM *vm, const char *format, ...) {
+// saves the running fiber's registers and loads those of the fiber at
+// the front of the ready queue, which must not be empty
+static void switch_fiber(VM *vm) {
+   vm->fiber->ip = vm->ip;
+   vm->fiber->stack_top = vm->stack_top;
+   load_next_fiber(vm);
+}
+
+static void load_next_fiber(VM *vm) {
+   Fiber *next = vm->ready_head;
+   vm->ready_head = next->next;
+   if (vm->ready_head == NULL) vm->ready_tail = NULL;
+
+   vm->fiber = next;
+   vm->ip = next->ip;
+   vm->stack_top = next->stack_top;
+}
+
+// saves the running fiber's registers and leaves the vm without one,
+// run_slice() loads the next once a parked fiber wakes up
+static void suspend_fiber(VM *vm) {
+   vm->fiber->ip = vm->ip;
+   vm->fiber->stack_top = vm->stack_top;
+   vm->fiber = NULL;
+}
+
+void reschedule_fiber(VM *vm) {
+   schedule_fiber(vm, vm->fiber);
+   if (vm->sliced) vm->step_limit = vm->steps;
+}
+
+bool poll_fibers(VM *vm, int timeout) {
+   wake_fibers(vm, timeout);
+   return vm->ready_head != NULL;
+}
+
+// moves the fibers whose file descriptors became ready to the ready
+// queue, waiting up to [timeout] milliseconds for one, -1 for as long as
+// the script has time left
+// returns false if none woke up and the script has no time left
+static bool wake_fibers(VM *vm, int timeout) {
+   // whatever was printed shows up before the vm goes to sleep
+   if (timeout != 0) flush_output(&vm->output);
+   if (timeout < 0 && vm->deadline != INT64_MAX) {
+      int64_t left = vm->deadline - now_milliseconds();
+      if (left < 0) left = 0;
+      timeout = left < INT32_MAX ? (int)left + 1 : INT32_MAX;
+   }
+   Fiber *ready = event_loop_poll(&vm->events, timeout);
+   while (ready != NULL) {
+      Fiber *fiber = ready;
+      ready = fiber->next;
+      schedule_fiber(vm, fiber);
+   }
+   return vm->ready_head != NULL || !past_deadline(vm);
+}
+
+bool wait_for_fd(VM *vm, int fd, bool writing) {
+   if (event_loop_wait(&vm->events, fd, writing, vm->fiber)) return true;
+
+   runtime_error(vm, "Can't wait on %d, another fiber may already be", fd);
+   return false;
+}
+
+void runtime_error(VM *vm, const char *format, ...) {
+   flush_output(&vm->output);
+
    va_list args;
    va_start(args, format);
-   vfprintf(stderr, format, args);
+   vfprintf(vm->errors, format, args);
    va_end(args);
-   fputs("\n", stderr);
+   fputs("\n", vm->errors);
 
    size_t instruction = vm->ip - vm->chunk->code;
-   fprintf(stderr, "[line %d] in script\n",
+   fprintf(vm->errors, "[line %d] in script\n",
       vm->chunk->lines[instruction]);
 
    reset_stack(vm);
@@ -2,31 +2,163 @@
 #define KI_VM_H
 
 #include "chunk.h"
+#include "event_loop.h"
+#include "memory_stats.h"
+#include "fiber.h"
+#include "output.h"
+#include "profile.h"
+#include "sampler.h"
+#include "scanner.h"
 #include "value.h"
 #include "table.h"
 
 #define STACK_MAX 256
 
+// What one script may use, 0 for no limit
+// A script over a limit stops with its own result code, the vm can run
+// the next script after it
 typedef struct {
+   // bytes the vm may have allocated at once
+   int64_t memory;
+   // instructions executed
+   uint64_t steps;
+   // wall clock time
+   int64_t milliseconds;
+} Limits;
+
+typedef struct sVM {
    Chunk *chunk;
    // instruction pointer
    uint8_t *ip;
    Value stack[STACK_MAX];
    Value *stack_top;
+   // [ip] and [stack_top] belong to the running fiber, the others keep
+   // theirs until they run again
+   Fiber *fiber;
+   // the script itself, running on [stack]
+   Fiber main_fiber;
+   // fibers waiting for their turn, round robin
+   Fiber *ready_head;
+   Fiber *ready_tail;
+   // fibers waiting on file descriptors
+   EventLoop events;
    Table strings;
    Obj *objects;
+   // lex the whole source before parsing it
+   bool batch_lexing;
+   // where print writes to
+   Output output;
+   // where compile and runtime errors are written to
+   FILE *errors;
+   // counts what runs when set, the caller owns it
+   Profile *profile;
+   // where compiled chunks are disassembled to, NULL when off
+   Output *disassembly;
+   // where the stack and every instruction are written before it runs,
+   // NULL when off
+   Output *trace;
+   // samples where the vm is when set, see start_sampler()
+   Sampler *sampler;
+   // what the vm allocated, see memory_stats.h
+   MemoryStats memory;
+   Limits limits;
+   // [limits] for the running script, the ones not set are the largest
+   // value so the run loop compares without checking
+   // the memory limit is [memory.limit]
+   uint64_t steps;
+   uint64_t step_limit;
+   // CLOCK_MONOTONIC milliseconds
+   int64_t deadline;
+   // running a slice for a scheduler, see run_slice()
+   bool sliced;
 } VM;
 
+// What the vm runs one script with: its registers, fibers and heap
+// A scheduler keeps one per script and swaps it with the vm's own to
+// move the vm between scripts. The main fiber's stack is the context's
+// rather than the vm's [stack].
+typedef struct {
+   Chunk *chunk;
+   uint8_t *ip;
+   Value *stack_top;
+   // NULL while every fiber of the script is parked
+   Fiber *fiber;
+   Fiber main_fiber;
+   Fiber *ready_head;
+   Fiber *ready_tail;
+   EventLoop events;
+   Table strings;
+   Obj *objects;
+   uint64_t steps;
+   int64_t deadline;
+   Value *stack;
+} ScriptContext;
+
 typedef enum {
    INTERPRET_OK,
    INTERPRET_COMPILE_ERROR,
-   INTERPRET_RUNTIME_ERROR
+   INTERPRET_RUNTIME_ERROR,
+   // the script went over limits.memory
+   INTERPRET_MEMORY_LIMIT,
+   // the script ran out of limits.steps or limits.milliseconds
+   INTERPRET_BUDGET_EXCEEDED,
+   // only from run_slice(), the slice ended before the script did
+   INTERPRET_PREEMPTED,
+   // only from run_slice(), every fiber of the script is parked on a file
+   // descriptor
+   INTERPRET_WAITING
 } InterpretResult;
 
 void init_vm(VM *vm);
 void free_vm(VM *vm);
+// frees every object and interned string but keeps the vm's settings
+void reset_vm(VM *vm);
+// reports an error at the current instruction and clears the stack
+void runtime_error(VM *vm, const char *format, ...);
+// reports an allocation try_reallocate() gave up on, as going over the
+// memory limit if it did, which the run loop ends the script for with
+// INTERPRET_MEMORY_LIMIT once the native returns NATIVE_ERROR
+void allocation_failed(VM *vm);
+// parks the running fiber until [fd] is ready, to be followed by
+// returning NATIVE_BLOCK from the native that called it
+// reports a runtime error and returns false if it can't wait
+bool wait_for_fd(VM *vm, int fd, bool writing);
+// reports a runtime error and returns true if the script is past its
+// time limit, for natives that wait without returning to the run loop
+bool out_of_time(VM *vm);
+// the CLOCK_MONOTONIC time that deadlines are measured in
+int64_t now_milliseconds();
+// puts the running fiber at the back of the ready queue and ends the
+// slice, to be followed by returning NATIVE_BLOCK from the native that
+// called it, which runs again on the fiber's next turn
+void reschedule_fiber(VM *vm);
+// moves the fibers whose file descriptors became ready to the ready
+// queue, waiting up to [timeout] milliseconds for one, and returns
+// whether any fiber is ready to run
+bool poll_fibers(VM *vm, int timeout);
 void push(VM *vm, Value value);
 Value pop(VM *vm);
-InterpretResult interpret(VM *vm, const char *source);
+// compiles and runs [length] bytes of [source]
+InterpretResult interpret(VM *vm, const char *source, size_t length);
+// compiles what [reader] returns as it arrives, then runs it
+InterpretResult interpret_stream(VM *vm, SourceReader *reader);
+// runs an already compiled chunk, which must not need more than STACK_MAX
+// slots, the chunk stays the caller's
+InterpretResult interpret_chunk(VM *vm, Chunk *chunk);
+// the vm's memory stats followed by its intern table's
+void write_vm_memory_stats(VM *vm, FILE *file);
+
+void init_script_context(VM *vm, ScriptContext *context);
+// frees the script's fibers and heap, but not its chunk
+void free_script_context(VM *vm, ScriptContext *context);
+// exchanges the vm's script with [context]'s, swapping twice restores
+// the vm
+void swap_script_context(VM *vm, ScriptContext *context);
+// makes [chunk] the script of the context swapped in and starts its
+// limits
+void start_script(VM *vm, Chunk *chunk);
+// runs the script swapped in for up to [quantum] instructions, always
+// under its limits, picking up where the last slice left off
+InterpretResult run_slice(VM *vm, uint64_t quantum);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+# Generates src/number_tables.h: the powers of ten used to format and
+# parse numbers in src/number.c.
+#
+# Cached powers, for the Grisu2 formatter: entry [i] is 10^k for
+# k = CACHED_POWER_MIN + i * CACHED_POWER_STEP as a normalized 64 bit
+# significand [f] and binary exponent [e], rounded to nearest, so that
+# 10^k ~ f * 2^e with the top bit of [f] set.
+#
+# Wide powers, for the Eisel-Lemire parser: entry [i] is the normalized
+# 128 bit significand of 10^q for q = WIDE_POWER_MIN + i, truncated, as a
+# high and a low half.
+
+import os
+from fractions import Fraction
+
+CACHED_POWER_MIN = -348
+CACHED_POWER_STEP = 8
+CACHED_POWER_COUNT = 87
+WIDE_POWER_MIN = -348
+WIDE_POWER_MAX = 347
+
+
+def normalized_power(k):
+   value = Fraction(10) ** k
+   e = value.numerator.bit_length() - value.denominator.bit_length() - 64
+   while value / Fraction(2) ** e >= 2 ** 64:
+      e += 1
+   while value / Fraction(2) ** e < 2 ** 63:
+      e -= 1
+   scaled = value / Fraction(2) ** e
+   f = scaled.numerator // scaled.denominator
+   if scaled - f >= Fraction(1, 2):
+      f += 1
+   if f == 2 ** 64:
+      f //= 2
+      e += 1
+   return f, e
+
+
+def wide_power(q):
+   value = Fraction(10) ** q
+   e = value.numerator.bit_length() - value.denominator.bit_length() - 128
+   while value / Fraction(2) ** e >= 2 ** 128:
+      e += 1
+   while value / Fraction(2) ** e < 2 ** 127:
+      e -= 1
+   scaled = value / Fraction(2) ** e
+   f = scaled.numerator // scaled.denominator
+   return f >> 64, f & (2 ** 64 - 1)
+
+
+def main():
+   out = [
+      "// Generated by tools/gen_number_tables.py, do not edit by hand.",
+      "#ifndef KI_NUMBER_TABLES_H",
+      "#define KI_NUMBER_TABLES_H",
+      "",
+      "#include \"common.h\"",
+      "",
+      "#define CACHED_POWER_MIN %d" % CACHED_POWER_MIN,
+      "#define CACHED_POWER_STEP %d" % CACHED_POWER_STEP,
+      "#define CACHED_POWER_COUNT %d" % CACHED_POWER_COUNT,
+      "",
+      "// 10^k ~ f * 2^e for k = CACHED_POWER_MIN + i * CACHED_POWER_STEP",
+      "static const uint64_t cached_power_f[CACHED_POWER_COUNT] = {",
+   ]
+   powers = [normalized_power(CACHED_POWER_MIN + i * CACHED_POWER_STEP)
+      for i in range(CACHED_POWER_COUNT)]
+   for row in range(0, CACHED_POWER_COUNT, 3):
+      cells = ", ".join("0x%016xull" % f for f, _ in powers[row:row + 3])
+      out.append("   %s," % cells)
+   out += [
+      "};",
+      "",
+      "static const int16_t cached_power_e[CACHED_POWER_COUNT] = {",
+   ]
+   for row in range(0, CACHED_POWER_COUNT, 10):
+      cells = ", ".join(str(e) for _, e in powers[row:row + 10])
+      out.append("   %s," % cells)
+   out += [
+      "};",
+      "",
+      "#define WIDE_POWER_MIN %d" % WIDE_POWER_MIN,
+      "#define WIDE_POWER_MAX %d" % WIDE_POWER_MAX,
+      "",
+      "// 128 bit significands of 10^q for q = WIDE_POWER_MIN + i, high half first",
+      "static const uint64_t wide_powers[WIDE_POWER_MAX - WIDE_POWER_MIN + 1][2] = {",
+   ]
+   for q in range(WIDE_POWER_MIN, WIDE_POWER_MAX + 1):
+      out.append("   { 0x%016xull, 0x%016xull }," % wide_power(q))
+   out += [
+      "};",
+      "",
+      "#endif",
+   ]
+
+   path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+      "..", "src", "number_tables.h")
+   with open(path, "w") as f:
+      f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+   main()
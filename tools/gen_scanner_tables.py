@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+# Generates src/scanner_tables.h: the character class table used by the
+# scanner and a minimal perfect hash for keyword recognition.
+#
+# The hash of an identifier [s] of length [n] is
+#    (n + asso[s[0]] + asso[s[1]] + asso[s[n - 1]]) % KEYWORD_COUNT
+# where [asso] is searched for so that every keyword lands in its own slot.
+# Rerun this script after adding a keyword to the list below.
+
+import os
+import random
+import sys
+
+KEYWORDS = [
+   ("and", "TOKEN_AND"),
+   ("class", "TOKEN_CLASS"),
+   ("else", "TOKEN_ELSE"),
+   ("false", "TOKEN_FALSE"),
+   ("for", "TOKEN_FOR"),
+   ("fun", "TOKEN_FUN"),
+   ("if", "TOKEN_IF"),
+   ("nil", "TOKEN_NIL"),
+   ("or", "TOKEN_OR"),
+   ("print", "TOKEN_PRINT"),
+   ("return", "TOKEN_RETURN"),
+   ("spawn", "TOKEN_SPAWN"),
+   ("super", "TOKEN_SUPER"),
+   ("this", "TOKEN_THIS"),
+   ("true", "TOKEN_TRUE"),
+   ("var", "TOKEN_VAR"),
+   ("while", "TOKEN_WHILE"),
+   ("yield", "TOKEN_YIELD"),
+]
+
+CHAR_ALPHA = 1
+CHAR_DIGIT = 2
+CHAR_SPACE = 4
+CHAR_NEWLINE = 8
+
+
+def keyword_hash(word, asso, size):
+   return (len(word) + asso[word[0]] + asso[word[1]] + asso[word[-1]]) % size
+
+
+def count_collisions(words, asso, size):
+   slots = {}
+   for word in words:
+      slots.setdefault(keyword_hash(word, asso, size), []).append(word)
+   colliding = [w for ws in slots.values() if len(ws) > 1 for w in ws]
+   return len(words) - len(slots), colliding
+
+
+# local search: keep moving one letter of a colliding keyword to another
+# value, undoing moves that make things worse most of the time
+def search_asso(words):
+   size = len(words)
+   letters = sorted({c for w in words for c in (w[0], w[1], w[-1])})
+   rng = random.Random(0)
+   asso = {c: rng.randrange(size) for c in letters}
+   collisions, colliding = count_collisions(words, asso, size)
+
+   for _ in range(1000000):
+      if collisions == 0:
+         return asso
+
+      word = rng.choice(colliding)
+      letter = rng.choice((word[0], word[1], word[-1]))
+      previous = asso[letter]
+      asso[letter] = rng.randrange(size)
+
+      moved, moved_colliding = count_collisions(words, asso, size)
+      if moved <= collisions or rng.random() < 0.05:
+         collisions, colliding = moved, moved_colliding
+      else:
+         asso[letter] = previous
+   sys.exit("no perfect hash found, widen the search")
+
+
+def char_class(c):
+   ch = chr(c)
+   if ch.isascii() and (ch.isalpha() or ch == "_"):
+      return "CHAR_ALPHA"
+   if ch.isascii() and ch.isdigit():
+      return "CHAR_DIGIT"
+   if ch in " \t\r":
+      return "CHAR_SPACE"
+   if ch == "\n":
+      return "CHAR_NEWLINE"
+   return "0"
+
+
+def emit_byte_table(name, ctype, values):
+   lines = ["static const %s %s[256] = {" % (ctype, name)]
+   for row in range(0, 256, 8):
+      cells = ", ".join(str(v) for v in values[row:row + 8])
+      lines.append("   %s," % cells)
+   lines.append("};")
+   return lines
+
+
+def main():
+   words = [w for w, _ in KEYWORDS]
+   size = len(words)
+   asso = search_asso(words)
+
+   slots = [None] * size
+   for word, token in KEYWORDS:
+      slots[keyword_hash(word, asso, size)] = (word, token)
+
+   out = [
+      "// Generated by tools/gen_scanner_tables.py, do not edit by hand.",
+      "#ifndef KI_SCANNER_TABLES_H",
+      "#define KI_SCANNER_TABLES_H",
+      "",
+      "#include \"common.h\"",
+      "#include \"scanner.h\"",
+      "",
+      "#define CHAR_ALPHA %d" % CHAR_ALPHA,
+      "#define CHAR_DIGIT %d" % CHAR_DIGIT,
+      "#define CHAR_SPACE %d" % CHAR_SPACE,
+      "#define CHAR_NEWLINE %d" % CHAR_NEWLINE,
+      "",
+      "// classification of every byte the scanner may see",
+   ]
+   out += emit_byte_table("char_class", "uint8_t", [char_class(c) for c in range(256)])
+   out += [
+      "",
+      "#define KEYWORD_COUNT %d" % size,
+      "#define KEYWORD_MIN_LENGTH %d" % min(len(w) for w in words),
+      "#define KEYWORD_MAX_LENGTH %d" % max(len(w) for w in words),
+      "",
+      "// association values of the keyword hash, indexed by character",
+   ]
+   out += emit_byte_table("keyword_asso", "uint8_t",
+      [asso.get(chr(c), 0) for c in range(256)])
+   out += [
+      "",
+      "typedef struct {",
+      "   const char *name;",
+      "   int length;",
+      "   TokenType type;",
+      "} Keyword;",
+      "",
+      "// keywords indexed by their hash",
+      "static const Keyword keywords[KEYWORD_COUNT] = {",
+   ]
+   for word, token in slots:
+      out.append("   { \"%s\", %d, %s }," % (word, len(word), token))
+   out += [
+      "};",
+      "",
+      "static inline unsigned keyword_hash(const char *start, int length) {",
+      "   return (length",
+      "      + keyword_asso[(unsigned char)start[0]]",
+      "      + keyword_asso[(unsigned char)start[1]]",
+      "      + keyword_asso[(unsigned char)start[length - 1]]) % KEYWORD_COUNT;",
+      "}",
+      "",
+      "#endif",
+   ]
+
+   path = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+      "..", "src", "scanner_tables.h")
+   with open(path, "w") as f:
+      f.write("\n".join(out))
+
+
+if __name__ == "__main__":
+   main()